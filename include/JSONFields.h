@@ -18,6 +18,7 @@
  * @typedef int
  * 
  * @note 0 - Reading Message Type
+ * @note 1 - Bus Health Message Type
  */
 #define JSON_TYPE "type"
 
@@ -51,6 +52,13 @@
 #define JSON_READING_COUNT "sample_count"
 #define JSON_TIMESTAMP "timestamp"
 #define JSON_KWH_USAGE "kwh_usage"
+#define JSON_KWH_TODAY "kwh_today"
+#define JSON_KWH_TOTAL "kwh_total"
+
+/**
+ * @brief Seconds of the period which could not be integrated into `kwh_usage` due to gaps in the readings. Omitted when zero.
+ */
+#define JSON_KWH_GAP "kwh_gap"
 
 #define JSON_STATUS_OBJ "state_changes"
 #define JSON_STATUS "state"
@@ -68,6 +76,60 @@
 #define JSON_PERIOD_END "period_end"
 
 #define JSON_READING_OBJECT "readings"
+
+/**
+ * @brief Whether a reading message is a keyframe, holding every module, or a delta frame, holding only the modules which changed beyond
+ * their deadbands since they were last sent. The server keeps the last values received for the modules a delta frame leaves out.
+ * @typedef bool
+ */
+#define JSON_KEYFRAME "keyframe"
+
+/**
+ * @brief Periods a module was left out of delta frames before this one. Its `kwh_usage` and `kwh_gap` span these periods too. Omitted
+ * when zero.
+ */
+#define JSON_SKIPPED_PERIODS "skipped"
+
+/**
+ * @brief Unit parameters for delta frames: reading messages per keyframe, and the deadbands of the module features.
+ */
+#define JSON_KEYFRAME_INTERVAL "keyframe_interval"
+#define JSON_DEADBAND "deadband"
+
+// Bus Health
+
+/**
+ * @brief Array of the modules' bus statistics for the period, omitting modules with no traffic.
+ */
+#define JSON_BUS_HEALTH "bus_health"
+#define JSON_BUS "bus"
+#define JSON_ADDRESS "addr"
+
+/**
+ * @brief Smoothed round trip time in microseconds.
+ */
+#define JSON_SRTT "srtt"
+
+/**
+ * @brief Counters for the period: [frames sent, frames received, checksum failures, size mismatches, timeouts, retries].
+ */
+#define JSON_LINK_COUNTERS "cnt"
+
+/**
+ * @brief Round trip counts in log2 buckets: under 256us, then 256us to 512us and so on, the last bucket being open ended.
+ */
+#define JSON_LATENCY_HISTOGRAM "lat"
 #define JSON_NEW_READINGS "nr"
 
+/**
+ * @brief Array of the outgoing message statistics for the period, per compression level used: the level as carried in the codec header,
+ * messages, serialized bytes, payload bytes and microseconds spent serializing and compressing.
+ */
+#define JSON_COMPRESSION "compression"
+#define JSON_COMPRESSION_LEVEL "lvl"
+#define JSON_COMPRESSION_MESSAGES "n"
+#define JSON_COMPRESSION_INPUT "in"
+#define JSON_COMPRESSION_OUTPUT "out"
+#define JSON_COMPRESSION_TIME "us"
+
 #endif
\ No newline at end of file
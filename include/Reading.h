@@ -22,7 +22,9 @@ class Reading {
         }
 
         const double reactive_power() const {
-            return sqrt(pow(apparent_power, 2) - pow(active_power(), 2));
+            const double active = active_power();
+            const double q_squared = apparent_power * apparent_power - active * active;
+            return (q_squared > 0) ? sqrt(q_squared) : 0;
         }
 
         const double phase_angle() const {
@@ -37,7 +39,7 @@ class Reading {
             kwh_usage = data.energy_usage;
             current = data.current;
             Reading::timestamp = timestamp;
-            ESP_LOGI("Reading", "New Reading: %fV %fHz %fVA PF:%f TS:%d", voltage, frequency, apparent_power, power_factor, kwh_usage, timestamp);
+            ESP_LOGV("Reading", "New Reading: %fV %fHz %fVA PF:%f %fkWh TS:%llu", voltage, frequency, apparent_power, power_factor, kwh_usage, timestamp);
         }
 
         Reading(ps::queue<double>& var, uint64_t ts) {
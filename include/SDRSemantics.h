@@ -16,6 +16,8 @@
 #define UNIT_TAG_LIST "unit_tags"
 #define MODULE_COUNT "module_count"
 #define KWH_PRICE "kwh_price"
+#define NEXT_PRICE_CHANGE "next_price_change" // Epoch time at which kwh_price next changes, 0 if unknown.
+#define TOTAL_KWH_TODAY "tot_kwh_today"
 
 /* Module Variables */
 #define MODULE_CLASS "module"
@@ -36,6 +38,9 @@
 #define READING_COUNT "num_readings"
 #define NEW_READING_COUNT "num_new_readings"
 
+#define KWH_TODAY "kwh_today"
+#define KWH_TOTAL "kwh_total"
+
 /* Module Commands */
 #define SET_MODULE_STATE "setState" // (state)
 
@@ -14,8 +14,20 @@
 
 #define DEFAULT_SAMPLE_PERIOD 1
 #define DEFAULT_SERIALIZATION_PERIOD 60
+#define BUS_HEALTH_PERIOD (15 * 60) // Seconds between bus health messages.
 #define DEFAULT_MODE 0 // Default mode rule engine
+#define DEFAULT_ENCODING 0 // Reading message encoding, 0: JSON, 1: MessagePack.
 #define DEFAULT_KWH_PRICE 0.6746
+#define STORE_KEY_UNIT "unit" // Variable store record of the unit's parameters and rule engine.
+#define STORE_KEY_MODULE "mod/" // Prefix of the variable store record of each module, followed by its ID.
+#define STORE_KEY_SCHEDULE "sched/" // Prefix of the variable store record of each scheduler entry, followed by its index.
+#define SAVE_MIN_INTERVAL_MS (30 * 1000) // Shortest time between saves of changed variables, so a burst of commands is written once.
+#define DEFAULT_KEYFRAME_INTERVAL 1 // Reading messages per full keyframe, the others being delta frames. 1 sends only keyframes.
+#define DEFAULT_DEADBAND_VOLTAGE 2.0 // V
+#define DEFAULT_DEADBAND_FREQUENCY 0.05 // Hz
+#define DEFAULT_DEADBAND_APPARENT_POWER 10.0 // VA
+#define DEFAULT_DEADBAND_POWER_FACTOR 0.02
+#define DEFAULT_DEADBAND_ENERGY 0.005 // kWh
 /**
  * ==============================================
  * |                                            |
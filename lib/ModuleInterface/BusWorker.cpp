@@ -0,0 +1,342 @@
+#include "BusWorker.h"
+
+void busWorkerTask(void* parent);
+
+/**
+ * @brief Construct a new Bus Worker.
+ * 
+ * @param bus The bus number, which selects the bit used in the cycle event group.
+ * @param bus_interface The interface to the bus, shared with the modules for relay operations.
+ * @param readings Shared queue of `BusReading` which the readings are placed on.
+ * @param cycle_events Event group in which the worker signals that it has completed a cycle.
+ * @param discoveries Shared queue of `BusDiscovery` which newly connected modules are placed on.
+ */
+BusWorker::BusWorker(uint8_t bus, std::shared_ptr<ModuleInterface> bus_interface, QueueHandle_t readings, EventGroupHandle_t cycle_events, QueueHandle_t discoveries) :
+    bus_id(bus),
+    interface(bus_interface),
+    reading_queue(readings),
+    discovery_queue(discoveries),
+    cycle_group(cycle_events)
+{
+    for (auto& queue : request_queues) queue = xQueueCreate(BUS_REQUEST_QUEUE_LENGTH, sizeof(BusRequest*));
+    pending = xSemaphoreCreateCounting(BUS_REQUEST_QUEUE_LENGTH * BUS_PRIORITY_CLASSES, 0);
+}
+
+BusWorker::~BusWorker() {
+    if (task_handle != NULL) vTaskDelete(task_handle);
+
+    BusRequest* request;
+    for (auto& queue : request_queues) {
+        while (xQueueReceive(queue, &request, 0) == pdTRUE) delete request;
+        vQueueDelete(queue);
+    }
+    vSemaphoreDelete(pending);
+}
+
+/**
+ * @brief Start the worker task.
+ * 
+ * @param module_addresses The addresses of the modules on this bus to poll every cycle.
+ * @return true - If the task was created.
+ */
+bool BusWorker::begin(const ps::vector<uint8_t>& module_addresses) {
+    addresses = module_addresses;
+
+    for (auto address : addresses) {
+        if (interface -> supportsLatch(address) && !interface -> supportsBatch(address)) any_latch_read = true;
+        if (address >= next_address) next_address = address + 1;
+    }
+    last_discovery = millis();
+
+    char name[16];
+    snprintf(name, sizeof(name), "Bus %u Task", bus_id);
+
+    return xTaskCreate(
+        busWorkerTask,
+        name,
+        6 * 1024,
+        this,
+        3,
+        &task_handle
+    ) == pdTRUE;
+}
+
+/**
+ * @brief Signal the worker to poll all of its modules. Returns immediately.
+ * 
+ * @param sequence Number of the cycle, recorded once it completes.
+ * @return true - If the cycle was queued. Otherwise the worker will never complete it.
+ */
+bool BusWorker::startCycle(uint32_t sequence) {
+    auto request = new BusRequest{BusRequest::BUS_CYCLE, 0, 0, 0, nullptr};
+    request -> cycle = sequence;
+    return submit(request, BUS_PRIORITY_POLL);
+}
+
+/**
+ * @brief Read a single module asynchronously. Returns immediately.
+ * 
+ * @param address 
+ * @param callback Run from the worker task with the reading once complete.
+ * @return true - If the request was queued.
+ */
+bool BusWorker::requestReading(uint8_t address, BusCallback callback) {
+    return submit(new BusRequest{BusRequest::BUS_READ, address, OPERATION_READ_METER, 0, callback}, BUS_PRIORITY_POLL);
+}
+
+/**
+ * @brief Send an operation to a single module asynchronously. Returns immediately.
+ * 
+ * @param address 
+ * @param operation 
+ * @param callback Run from the worker task once the operation has been ACKed or has failed.
+ * @param priority Actuation operations preempt pending polls.
+ * @return true - If the request was queued.
+ */
+bool BusWorker::requestOperation(uint8_t address, uint16_t operation, BusCallback callback, BusPriority priority) {
+    return submit(new BusRequest{BusRequest::BUS_OPERATION, address, operation, 0, callback}, priority);
+}
+
+/**
+ * @brief Check for newly connected modules as soon as higher priority requests allow, rather than waiting for the bus to idle.
+ * 
+ * @return true - If the request was queued.
+ */
+bool BusWorker::requestDiscovery() {
+    return submit(new BusRequest{BusRequest::BUS_DISCOVER, 0, 0, 0, nullptr}, BUS_PRIORITY_DISCOVERY);
+}
+
+/**
+ * @brief Send an actuation operation to a module, and block until the worker has performed it or `BUS_OPERATION_TIMEOUT_MS` elapses.
+ * An operation still queued at the timeout is cancelled, so it is never performed after the caller has been told it failed. If the worker
+ * has already started it, its outcome is waited for.
+ * 
+ * @param address 
+ * @param operation 
+ * @return true - If the module ACKed the operation.
+ */
+bool BusWorker::operate(uint8_t address, uint16_t operation) {
+    struct Result {
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+        bool success = false;
+        ~Result() { vSemaphoreDelete(done); }
+    };
+
+    // Shared with the queued request, which outlives this call when it times out.
+    auto result = std::make_shared<Result>();
+    auto claim = std::make_shared<std::atomic<bool>>(false);
+
+    auto request = new BusRequest{BusRequest::BUS_OPERATION, address, operation, 0, [result](bool success, const ReadingDataPacket&) {
+        result -> success = success;
+        xSemaphoreGive(result -> done);
+    }};
+    request -> claim = claim;
+
+    if (!submit(request, BUS_PRIORITY_ACTUATION)) return false;
+
+    if (xSemaphoreTake(result -> done, BUS_OPERATION_TIMEOUT_MS / portTICK_PERIOD_MS) != pdTRUE) {
+        if (!claim -> exchange(true)) {
+            ESP_LOGE("BusWorker", "Bus %u operation 0x%04x on module %u timed out, cancelled.", bus_id, operation, address);
+            return false;
+        }
+
+        // The worker is already sending it, so the relay may switch. Wait for the outcome, bounded by the interface's own retries.
+        ESP_LOGW("BusWorker", "Bus %u operation 0x%04x on module %u started late.", bus_id, operation, address);
+        xSemaphoreTake(result -> done, portMAX_DELAY);
+    }
+
+    return result -> success;
+}
+
+/**
+ * @brief Place a request on the queue of its priority class. Ownership of the request passes to the worker.
+ * 
+ * @param request 
+ * @param priority 
+ * @return true - If queued.
+ */
+bool BusWorker::submit(BusRequest* request, BusPriority priority) {
+    request -> enqueued_us = esp_timer_get_time();
+
+    if (xQueueSendToBack(request_queues[priority], &request, 250 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGE("BusWorker", "Bus %u request queue %u full.", bus_id, priority);
+        delete request;
+        return false;
+    }
+
+    xSemaphoreGive(pending);
+    return true;
+}
+
+/**
+ * @brief Take the highest priority pending request, down to the lowest priority class given, and record how long it waited. The caller
+ * is responsible for taking the request from the pending count.
+ * 
+ * @param lowest_priority 
+ * @return BusRequest* - The request, or nullptr if none are pending.
+ */
+BusRequest* BusWorker::take_request(BusPriority lowest_priority) {
+    BusRequest* request;
+
+    for (uint8_t priority = 0; priority <= lowest_priority; priority++) {
+        if (xQueueReceive(request_queues[priority], &request, 0) != pdTRUE) continue;
+
+        uint32_t wait_us = esp_timer_get_time() - request -> enqueued_us;
+        auto& stats = queue_stats[priority];
+        stats.requests++;
+        stats.total_wait_us += wait_us;
+        if (wait_us > stats.max_wait_us) stats.max_wait_us = wait_us;
+
+        if (priority == BUS_PRIORITY_ACTUATION) ESP_LOGD("BusWorker", "Bus %u actuation waited %uus.", bus_id, wait_us);
+        return request;
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Perform a request on the bus, then free it. A request cancelled by its requester is freed without being performed.
+ * 
+ * @param request 
+ */
+void BusWorker::perform(BusRequest* request) {
+    if (request -> claim && request -> claim -> exchange(true)) {
+        ESP_LOGD("BusWorker", "Bus %u dropped a cancelled request for module %u.", bus_id, request -> address);
+        delete request;
+        return;
+    }
+
+    switch (request -> type) {
+        case BusRequest::BUS_CYCLE:
+            run_cycle(request -> cycle);
+            break;
+
+        case BusRequest::BUS_READ: {
+            auto data = interface -> getReading(request -> address);
+            if (request -> callback) request -> callback(data.voltage != -1, data);
+            break;
+        }
+
+        case BusRequest::BUS_OPERATION: {
+            bool success = interface -> sendOperation(request -> address, request -> operation);
+            if (request -> callback) request -> callback(success, ReadingDataPacket());
+            break;
+        }
+
+        case BusRequest::BUS_DISCOVER:
+            run_discovery();
+            break;
+    }
+
+    delete request;
+}
+
+/**
+ * @brief Poll every module on the bus, placing the readings on the reading queue, then signal completion. Modules which buffer their
+ * readings return them all in batches, stamped with the time each was taken. Actuation requests queued during the cycle are performed
+ * between the module reads.
+ * 
+ * @param sequence 
+ */
+void BusWorker::run_cycle(uint32_t sequence) {
+    BusReading reading;
+    reading.bus = bus_id;
+
+    bool latched = any_latch_read && interface -> latchReadings();
+    uint64_t latched_us = esp_timer_get_time(); // When the modules sampled, which may be well after the cycle was requested.
+
+    for (auto address : addresses) {
+        while (BusRequest* urgent = take_request(BUS_PRIORITY_ACTUATION)) {
+            xSemaphoreTake(pending, 0);
+            perform(urgent);
+        }
+
+        reading.address = address;
+
+        if (interface -> supportsBatch(address)) {
+            if (!interface -> getBatch(address, batch)) continue;
+            uint64_t received_us = esp_timer_get_time();
+
+            for (auto& entry : batch) {
+                reading.data = entry.reading;
+                reading.monotonic_us = received_us - (uint64_t) entry.age_ms * 1000;
+                xQueueSendToBack(reading_queue, &reading, portMAX_DELAY);
+            }
+            continue;
+        }
+
+        if (latched && interface -> supportsLatch(address)) {
+            reading.data = interface -> getLatchedReading(address);
+            reading.monotonic_us = latched_us;
+        } else {
+            reading.data = interface -> getReading(address);
+            reading.monotonic_us = esp_timer_get_time();
+        }
+
+        if (reading.data.voltage == -1) continue; // Read failed.
+
+        xQueueSendToBack(reading_queue, &reading, portMAX_DELAY);
+    }
+
+    completed_cycle = sequence;
+    xEventGroupSetBits(cycle_group, cycleBit());
+}
+
+/**
+ * @brief Address any newly connected modules, add them to the poll list, and place them on the discovery queue.
+ * 
+ */
+void BusWorker::run_discovery() {
+    last_discovery = millis();
+    if (next_address >= EASYTRANSFER_BROADCAST_ID) return; // Bus full.
+
+    auto found_modules = interface -> discover(next_address);
+
+    for (auto& found : found_modules) {
+        BusDiscovery discovery;
+        discovery.bus = bus_id;
+        discovery.address = found.second;
+        discovery.announce = found.first;
+
+        addresses.push_back(found.second);
+        if (interface -> supportsLatch(found.second) && !interface -> supportsBatch(found.second)) any_latch_read = true;
+        next_address = found.second + 1;
+
+        ESP_LOGI("BusWorker", "Bus %u: new module %s at address %u.", bus_id, found.first.id, found.second);
+        if (xQueueSendToBack(discovery_queue, &discovery, 0) != pdTRUE) ESP_LOGE("BusWorker", "Bus %u discovery queue full.", bus_id);
+    }
+}
+
+/**
+ * @brief Time until the next idle discovery is due.
+ * 
+ * @return uint32_t Milliseconds, 0 if due.
+ */
+uint32_t BusWorker::discovery_wait_ms() {
+    uint32_t elapsed = millis() - last_discovery;
+    return (elapsed >= BUS_DISCOVERY_INTERVAL_MS) ? 0 : BUS_DISCOVERY_INTERVAL_MS - elapsed;
+}
+
+/**
+ * @brief RTOS task for a BusWorker. Sleeps until a request is queued, then performs the highest priority pending request on the bus. Once
+ * the discovery interval has elapsed, new modules are looked for the next time no request is pending.
+ * 
+ * @param parent 
+ */
+void busWorkerTask(void* parent) {
+    BusWorker* worker = (BusWorker*) parent;
+    ESP_LOGI("RTOS", "Bus %u worker started.", worker -> bus_id);
+
+    while (1) {
+        if (xSemaphoreTake(worker -> pending, worker -> discovery_wait_ms() / portTICK_PERIOD_MS) != pdTRUE) {
+            worker -> run_discovery(); // Bus idle.
+            continue;
+        }
+
+        BusRequest* request = worker -> take_request(BUS_PRIORITY_POLL);
+        if (request != nullptr) worker -> perform(request);
+    }
+
+    ESP_LOGE("RTOS", "Bus worker escaped loop.");
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#ifndef BUS_WORKER_H
+#define BUS_WORKER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <ps_stl.h>
+#include "ModuleInterface.h"
+
+#define BUS_REQUEST_QUEUE_LENGTH 16 // Length of each priority class queue.
+#define BUS_OPERATION_TIMEOUT_MS 2000 // Longest a blocking operation waits for the worker to complete it.
+#define BUS_DISCOVERY_INTERVAL_MS 10000 // How often the worker checks for newly connected modules while the bus is idle.
+
+/**
+ * @brief A reading taken by a bus worker, placed on the shared reading queue.
+ */
+struct BusReading {
+    uint8_t bus;
+    uint8_t address;
+    uint64_t monotonic_us; // esp_timer_get_time() when the reading was received.
+    ReadingDataPacket data;
+};
+
+/**
+ * @brief A module connected after boot and addressed by a bus worker, placed on the shared discovery queue.
+ */
+struct BusDiscovery {
+    uint8_t bus;
+    uint8_t address;
+    AnnouncePacket announce;
+};
+
+/**
+ * @brief Called from the bus worker task when an asynchronous request completes. The reading is only valid for read requests.
+ */
+typedef std::function<void(bool success, const ReadingDataPacket& reading)> BusCallback;
+
+/**
+ * @brief A request for a bus worker to perform, placed on its request queue.
+ */
+struct BusRequest {
+    enum Type : uint8_t {
+        BUS_CYCLE, // Poll every module on the bus.
+        BUS_READ, // Read a single module.
+        BUS_OPERATION, // Send an operation to a single module.
+        BUS_DISCOVER // Address any newly connected modules.
+    } type;
+    uint8_t address;
+    uint16_t operation;
+    uint64_t timestamp;
+    BusCallback callback;
+    uint64_t enqueued_us = 0; // esp_timer_get_time() when the request was queued.
+    std::shared_ptr<std::atomic<bool>> claim = nullptr; // Optional. Set by the worker as it performs the request, or by the requester to cancel it.
+    uint32_t cycle = 0; // Sequence number of a BUS_CYCLE request.
+};
+
+/**
+ * @brief Priority classes of bus requests, highest first. Pending requests of a higher class are always performed first, and actuation
+ * requests are also performed between the module reads of a running poll cycle.
+ */
+enum BusPriority : uint8_t {
+    BUS_PRIORITY_ACTUATION, // Relay commands.
+    BUS_PRIORITY_DISCOVERY, // Addressing of new modules.
+    BUS_PRIORITY_POLL, // Meter reads.
+    BUS_PRIORITY_CLASSES
+};
+
+/**
+ * @brief Time spent by the requests of one priority class waiting in the queue before being performed.
+ */
+struct BusQueueStats {
+    uint32_t requests = 0;
+    uint64_t total_wait_us = 0;
+    uint32_t max_wait_us = 0;
+
+    uint32_t meanWait() const { return requests ? total_wait_us / requests : 0; }
+};
+
+/**
+ * @brief Owns the polling of a single RS-485 bus. Each worker runs in its own RTOS task so that both buses are sampled in parallel. On every
+ * `startCycle()` the worker reads all of its modules, places the readings on the shared reading queue, records the cycle's sequence number as
+ * completed, and then sets its bit in the cycle event group. A cycle the unit has given up waiting for also sets the bit once it finishes, so
+ * the sequence number tells the current cycle's completion apart.
+ * 
+ * Modules which support latching are sampled simultaneously with a broadcast latch at the start of the cycle, and their readings are stamped
+ * with the time the latch was sent, so that readings across both buses form a time aligned snapshot. The broadcast is skipped when every
+ * latch capable module is read in batches instead.
+ * 
+ * Single reads and operations can also be requested asynchronously, with a callback run from the worker task on completion. Requests are
+ * queued by priority class, so that relay commands are not held up behind meter reads.
+ * 
+ * While the bus is idle the worker periodically checks for newly connected modules. These are addressed, polled from the next cycle on,
+ * and placed on the discovery queue for the unit to adopt.
+ */
+class BusWorker {
+    private:
+        friend void busWorkerTask(void* parent);
+
+        uint8_t bus_id;
+        std::shared_ptr<ModuleInterface> interface;
+        ps::vector<uint8_t> addresses;
+        bool any_latch_read = false; // Whether any module is read through the latch, rather than in batches.
+
+        QueueHandle_t reading_queue;
+        QueueHandle_t discovery_queue;
+        uint8_t next_address = 1;
+        uint32_t last_discovery = 0;
+        QueueHandle_t request_queues[BUS_PRIORITY_CLASSES]; // Queues of BusRequest*, owned by the worker once queued.
+        SemaphoreHandle_t pending; // Counts the requests across all the queues.
+        EventGroupHandle_t cycle_group;
+        TaskHandle_t task_handle = NULL;
+        std::atomic<uint32_t> completed_cycle{0};
+
+        BusQueueStats queue_stats[BUS_PRIORITY_CLASSES];
+        ps::vector<BatchEntry> batch; // Reused between reads, so batches do not allocate once grown.
+
+        bool submit(BusRequest* request, BusPriority priority);
+        BusRequest* take_request(BusPriority lowest_priority);
+        void perform(BusRequest* request);
+        void run_cycle(uint32_t sequence);
+        void run_discovery();
+        uint32_t discovery_wait_ms();
+
+    public:
+        BusWorker(uint8_t bus, std::shared_ptr<ModuleInterface> bus_interface, QueueHandle_t readings, EventGroupHandle_t cycle_events, QueueHandle_t discoveries);
+        ~BusWorker();
+
+        bool begin(const ps::vector<uint8_t>& module_addresses);
+        bool startCycle(uint32_t sequence);
+
+        bool requestReading(uint8_t address, BusCallback callback);
+        bool requestOperation(uint8_t address, uint16_t operation, BusCallback callback, BusPriority priority = BUS_PRIORITY_ACTUATION);
+        bool operate(uint8_t address, uint16_t operation);
+        bool requestDiscovery();
+
+        const BusQueueStats& queueStats(BusPriority priority) { return queue_stats[priority]; }
+
+        /**
+         * @brief The bit set in the cycle event group once this worker has finished a cycle.
+         */
+        EventBits_t cycleBit() { return (EventBits_t) 1 << bus_id; }
+
+        /**
+         * @brief Whether the cycle with the given sequence number is the last one this worker completed.
+         */
+        bool cycleComplete(uint32_t sequence) { return completed_cycle == sequence; }
+        uint8_t bus() { return bus_id; }
+        std::shared_ptr<ModuleInterface> getInterface() { return interface; }
+};
+
+#endif
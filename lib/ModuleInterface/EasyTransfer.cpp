@@ -2,9 +2,11 @@
 
 
 //Captures address and size of struct
-void EasyTransfer::begin(uint8_t * ptr, uint8_t length, Stream *theStream, uint8_t id, uint8_t dir_pin){
+//With variable_length set, frames of up to length bytes are accepted, e.g. a count followed by that many entries.
+void EasyTransfer::begin(uint8_t * ptr, uint8_t length, Stream *theStream, uint8_t id, uint8_t dir_pin, bool variable_length){
 	address = ptr;
 	size = length;
+  variable = variable_length;
 	_stream = theStream;
 
   device_id = id;
@@ -13,166 +15,158 @@ void EasyTransfer::begin(uint8_t * ptr, uint8_t length, Stream *theStream, uint8
 	//dynamic creation of rx parsing buffer in RAM
   heap_caps_free(rx_buffer);
 	rx_buffer = (uint8_t*) heap_caps_malloc(size+1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  //the outgoing frame is assembled here, kept in internal RAM as it is handed straight to the UART driver.
+  heap_caps_free(tx_buffer);
+  tx_buffer = (uint8_t*) heap_caps_malloc(EASYTRANSFER_HEADER_SIZE + size + 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  rx_state = RX_WAIT_HEADER;
 }
 
-//Sends out struct in binary, with header, length info and checksum
-bool EasyTransfer::sendData(uint8_t target_id){
-  uint8_t CS = size;
-  ESP_LOGI("EasyTransfer", "Sending Packet to address %d", target_id);
-  digitalWrite(_pin, HIGH);
-  delayMicroseconds(10);
-  _stream->write(0x06);
-  _stream->write(target_id);
-  _stream->write(size);
-  _stream->write(0x85);
-
-  for(int i = 0; i<size; i++){
-    CS^=*(address+i);
-    _stream->write(*(address+i));
+//Sends out struct in binary, with header, length info and checksum, or a CRC-16 if use_crc is set.
+//The frame is assembled in the preallocated buffer and written in one go.
+//Broadcasts, and requests whose reply acknowledges them, do not wait for an ACK.
+bool EasyTransfer::sendData(uint8_t target_id, bool wait_for_ack, bool use_crc){
+  uint8_t* frame = tx_buffer;
+  *frame++ = 0x06;
+  *frame++ = target_id;
+  *frame++ = size;
+  *frame++ = use_crc ? EASYTRANSFER_MARKER_CRC : EASYTRANSFER_MARKER_XOR;
+  memcpy(frame, address, size);
+  frame += size;
+
+  if (use_crc) {
+    uint16_t crc = easytransfer_crc16(easytransfer_crc16(0xFFFF, target_id), size);
+    for(int i = 0; i<size; i++) crc = easytransfer_crc16(crc, address[i]);
+    *frame++ = crc & 0xFF;
+    *frame++ = crc >> 8;
+  } else {
+    uint8_t CS = size;
+    for(int i = 0; i<size; i++) CS ^= address[i];
+    *frame++ = CS;
   }
-  _stream->write(CS);
 
+  digitalWrite(_pin, HIGH);
+  delayMicroseconds(EASYTRANSFER_DE_SETUP_US);
+  _stream->write(tx_buffer, frame - tx_buffer);
   _stream->flush();
   digitalWrite(_pin, LOW);
 
+  if (!wait_for_ack || target_id == EASYTRANSFER_BROADCAST_ID) return true;
+
+  //yield to other tasks while waiting, rather than spinning on the stream.
   uint32_t start_tm = micros();
-  while(_stream -> read() != 0xFE && micros() - start_tm < EASYTRANSFER_TIMEOUT_US) {}
+  while(micros() - start_tm < EASYTRANSFER_TIMEOUT_US) {
+    if (receiveAck()) return true;
+    vTaskDelay(1);
+  }
 
-  if (micros() - start_tm < EASYTRANSFER_TIMEOUT_US) return true;
   ESP_LOGE("EasyTransfer", "ACK Timeout.");
   return false;
 }
 
+//Feeds whatever is waiting in the stream through the framing state machine. Never blocks, so it can be called
+//whenever the UART signals that data has arrived. Partial frames are kept between calls.
+//Returns true once a whole frame for this device has passed its checksum, been copied into the struct and been ACKed.
 bool EasyTransfer::receiveData() {
-  //start off by looking for the header bytes. If they were already found in a previous call, skip it.
-  if(rx_len == 0){
-  //this size check may be redundant due to the size check below, but for now I'll leave it the way it is.
-    if(_stream->available() >= 3){
-      //this will block until a 0x06 is found or buffer size becomes less then 3.
-      while(_stream->read() != 0x06) {
-      //This will trash any preamble junk in the serial buffer
-      //but we need to make sure there is enough in the buffer to process while we trash the rest
-      //if the buffer becomes too empty, we will escape and try again on the next call
-        if(_stream->available() < 3) {
-          ESP_LOGI("EasyTransfer", "Buffer Empty.");
-          return false;
-        } 
-		  }
-      if (_stream -> read() == device_id) {
-        ESP_LOGI("EasyTransfer", "ID matched.");
-        rx_len = _stream->read();
-        if (_stream->read() == 0x85){
-        //make sure the binary structs on both Arduinos are the same size.
-          if(rx_len != size){
-            ESP_LOGE("EasyTransfer", "Size Mismatch %x:%x.", rx_len, size);
-            rx_len = 0;
-            return false;
-          }
-        } else return false;   
-      } else return false;    
-    } else return false;
-  }
-  
-  //we get here if we already found the header bytes, the struct size matched what we know, and now we are byte aligned.
-  if(rx_len != 0){
-    while(_stream->available() && rx_array_inx <= rx_len){
-      rx_buffer[rx_array_inx++] = _stream->read();
-    }
-    
-    if(rx_len == (rx_array_inx-1)){
-      //seem to have got whole message
-      //last uint8_t is CS
-      calc_CS = rx_len;
-      for (int i = 0; i<rx_len; i++){
-        calc_CS^=rx_buffer[i];
-      } 
-      
-      if(calc_CS == rx_buffer[rx_array_inx-1]){//CS good
-        memcpy(address,rx_buffer,size);
-        digitalWrite(_pin, HIGH);
-        delayMicroseconds(10);
-        _stream->write(0xFE); // Write ACK.
-        _stream->flush();
-        digitalWrite(_pin, LOW);
-        rx_len = 0;
+  while(_stream->available()){
+    uint8_t data = _stream->read();
+
+    switch(rx_state){
+      case RX_WAIT_HEADER:
+        //trash any preamble junk until the start of a frame.
+        if(data == 0x06) rx_state = RX_WAIT_ID;
+        break;
+
+      case RX_WAIT_ID:
+        rx_state = (data == device_id) ? RX_WAIT_LENGTH : RX_WAIT_HEADER;
+        calc_crc = easytransfer_crc16(0xFFFF, data);
+        break;
+
+      case RX_WAIT_LENGTH:
+        //make sure the binary structs on both ends are the same size.
+        if(variable ? data > size : data != size){
+          ESP_LOGW("EasyTransfer", "Size Mismatch %x:%x.", data, size);
+          size_mismatches++;
+          rx_state = RX_WAIT_HEADER;
+          break;
+        }
+        rx_len = data;
+        calc_crc = easytransfer_crc16(calc_crc, data);
+        rx_state = RX_WAIT_MARKER;
+        break;
+
+      case RX_WAIT_MARKER:
+        //the marker selects the frame check, so replies may use either.
+        if(data != EASYTRANSFER_MARKER_XOR && data != EASYTRANSFER_MARKER_CRC){
+          rx_state = RX_WAIT_HEADER;
+          break;
+        }
+        rx_crc = (data == EASYTRANSFER_MARKER_CRC);
         rx_array_inx = 0;
+        calc_CS = rx_len;
+        rx_state = (rx_len > 0) ? RX_PAYLOAD : RX_CHECKSUM;
+        break;
+
+      case RX_PAYLOAD:
+        rx_buffer[rx_array_inx++] = data;
+        calc_CS ^= data;
+        calc_crc = easytransfer_crc16(calc_crc, data);
+        if(rx_array_inx == rx_len) rx_state = RX_CHECKSUM;
+        break;
+
+      case RX_CHECKSUM:
+        if(rx_crc){
+          rx_crc_low = data;
+          rx_state = RX_CRC_HIGH;
+          break;
+        }
+        rx_state = RX_WAIT_HEADER;
+        if(calc_CS != data){
+          //failed checksum, drop the frame and look for the next one.
+          ESP_LOGW("EasyTransfer", "CS Fail.");
+          check_failures++;
+          break;
+        }
+        memcpy(address,rx_buffer,rx_len);
+        received_length = rx_len;
+        sendAck();
+        return true;
+
+      case RX_CRC_HIGH:
+        rx_state = RX_WAIT_HEADER;
+        if(calc_crc != (uint16_t)(rx_crc_low | (data << 8))){
+          ESP_LOGW("EasyTransfer", "CRC Fail.");
+          check_failures++;
+          break;
+        }
+        memcpy(address,rx_buffer,rx_len);
+        received_length = rx_len;
+        sendAck();
         return true;
-		}
-		
-	  else{
-	  //failed checksum, need to clear this out anyway
-		rx_len = 0;
-		rx_array_inx = 0;
-    ESP_LOGE("EasyTransfer", "CS Fail.");
-		return false;
-	  }
-        
     }
   }
-  
+
   return false;
+}
+
+//Drops any partly received frame, e.g. a reply cut off by a timeout, so that it cannot swallow the start of the next reply.
+void EasyTransfer::resetReceive() {
+  rx_state = RX_WAIT_HEADER;
+  rx_array_inx = 0;
+}
 
-//   uint8_t buffer[128] = {0};
-
-//   if (_stream->available() < 3) {
-//     return false;
-//   }
-//   delay(5);
-  
-//   uint8_t len = 0;
-//   while(_stream -> available() && len < 127) {
-//     buffer[len] = _stream -> read();
-//     ESP_LOGI("EasyTransfer", "Got: %x", buffer[len]);
-//     len++;
-//   }
-//   ESP_LOGI("EasyTransfer", "Searching start.");
-//   uint8_t start_index = 0;
-//   for (uint8_t i = 0; i < len; i++) {
-//     if (buffer[i] == 0x06) {
-//       start_index = i;
-//       break;
-//     }
-
-//     if (i == len) return false;
-//   }
-//   ESP_LOGI("EasyTransfer", "Found start.");
-//   if (buffer[start_index + 1] != device_id) return false;
-
-//   if (buffer[start_index + 3] != 0x85) {
-//     return false;
-//   }
-
-//   rx_len = buffer[start_index + 2];
-
-// // l  1  2  3  4  5  6  7  8
-//   // 06 04 85 01 00 01 00 04
-
-//   //make sure the binary structs on both Arduinos are the same size.
-//   if(rx_len != size){
-//     rx_len = 0;
-//     return false;
-//   }
-
-//   calc_CS = rx_len;
-//   for (int i = start_index; i < rx_len; i++){
-//     calc_CS^=buffer[i + start_index + 4];
-//   } 
-  
-//   ESP_LOGI("EasyTransfer", "Verifying Checksum.");
-//   if(calc_CS == buffer[start_index + rx_len + 4]){//CS good
-//     ESP_LOGI("EasyTransfer", "CS good.");
-//     memcpy(address,&buffer[start_index + 4], size);
-//     rx_len = 0;
-//     digitalWrite(_pin, HIGH);
-//     delayMicroseconds(10);
-//     _stream->write(0xFE); // Write ACK.
-//     _stream->flush();
-//     digitalWrite(_pin, LOW);
-//     return true;
-//   }
-
-//   //failed checksum, need to clear this out anyway
-//   rx_len = 0;
-//   return false;
+//Consumes bytes from the stream up to and including an ACK. Never blocks.
+//Returns true if an ACK was found, leaving any following bytes (e.g. a reply frame) in the stream.
+bool EasyTransfer::receiveAck() {
+  while(_stream->available()){
+    if(_stream->read() == 0xFE) return true;
+  }
+  return false;
 }
 
+void EasyTransfer::sendAck() {
+  digitalWrite(_pin, HIGH);
+  delayMicroseconds(EASYTRANSFER_DE_SETUP_US);
+  _stream->write(0xFE); // Write ACK.
+  _stream->flush();
+  digitalWrite(_pin, LOW);
+}
@@ -30,6 +30,16 @@ GNU General Public License for more details.
 
 #define EASYTRANSFER_TIMEOUT_US 100000
 
+// Frames sent to this id are acted on by every module, and are never acknowledged.
+#define EASYTRANSFER_BROADCAST_ID 0xFF
+
+// Marker byte after the length. Selects the frame check: an 8-bit XOR checksum, or a CRC-16/MODBUS over id, length and payload.
+#define EASYTRANSFER_MARKER_XOR 0x85
+#define EASYTRANSFER_MARKER_CRC 0x86
+
+#define EASYTRANSFER_HEADER_SIZE 4 // Start byte, id, length and marker.
+#define EASYTRANSFER_DE_SETUP_US 10 // Time for the transceiver driver to enable before the first byte.
+
 //Not neccessary, but just in case. 
 #if ARDUINO > 22
 #include "Arduino.h"
@@ -46,25 +56,57 @@ GNU General Public License for more details.
 
 class EasyTransfer {
 public:
-EasyTransfer() : rx_buffer(NULL) {}
-~EasyTransfer() {free(rx_buffer);}
-void begin(uint8_t * ptr, uint8_t length, Stream *theStream, uint8_t id, uint8_t dir_pin);
+EasyTransfer() : rx_buffer(NULL), tx_buffer(NULL) {}
+~EasyTransfer() {free(rx_buffer); free(tx_buffer);}
+void begin(uint8_t * ptr, uint8_t length, Stream *theStream, uint8_t id, uint8_t dir_pin, bool variable_length = false);
 //void begin(uint8_t *, uint8_t, NewSoftSerial *theSerial);
-bool sendData(uint8_t target_id);
+bool sendData(uint8_t target_id, bool wait_for_ack = true, bool use_crc = false);
 boolean receiveData();
+bool receiveAck();
+uint8_t receivedLength() {return received_length;}
+bool receiving() {return rx_state != RX_WAIT_HEADER;} //part way through a frame
+void resetReceive(); //drop any partial frame, so the next byte is read as the start of one
+uint32_t checkFailures() {return check_failures;}
+uint32_t sizeMismatches() {return size_mismatches;}
 private:
+enum RxState : uint8_t {
+  RX_WAIT_HEADER,
+  RX_WAIT_ID,
+  RX_WAIT_LENGTH,
+  RX_WAIT_MARKER,
+  RX_PAYLOAD,
+  RX_CHECKSUM,
+  RX_CRC_HIGH
+};
+
 Stream *_stream;
 //NewSoftSerial *_serial;
 uint8_t _pin = 0;
 uint8_t device_id = 0; // id of device.
 uint8_t * address;  //address of struct
 uint8_t size = 0;       //size of struct
+bool variable = false;  //accept frames up to size long, rather than exactly size
+uint8_t received_length = 0; //payload length of the last frame received
 uint8_t * rx_buffer = NULL; //address for temporary storage and parsing buffer
 uint8_t rx_array_inx = 0;  //index for RX parsing buffer
 uint8_t rx_len = 0;		//RX packet length according to the packet
 uint8_t calc_CS = 0;	   //calculated Chacksum
+uint16_t calc_crc = 0;  //calculated CRC-16, for CRC frames
+uint8_t rx_crc_low = 0; //first received CRC byte
+bool rx_crc = false;    //whether the frame being received uses a CRC
+RxState rx_state = RX_WAIT_HEADER; //framing state machine position, kept between calls
+uint8_t * tx_buffer = NULL; //preallocated frame, so that each frame is a single write
+uint32_t check_failures = 0; //frames dropped for a bad checksum or CRC
+uint32_t size_mismatches = 0; //frames dropped for an unexpected length
+void sendAck();
 };
 
 
 
+static inline uint16_t easytransfer_crc16(uint16_t crc, uint8_t data) {
+  crc ^= data;
+  for (uint8_t i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  return crc;
+}
+
 #endif
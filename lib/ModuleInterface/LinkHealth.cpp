@@ -0,0 +1,83 @@
+#include "LinkHealth.h"
+
+/**
+ * @brief Get the retransmission timeout for this address.
+ * 
+ * @return uint32_t Timeout in milliseconds.
+ */
+uint32_t LinkHealth::timeout_ms() const {
+    if (!has_sample) return RTO_INITIAL_MS;
+
+    uint32_t rto = (srtt_us + 4 * rttvar_us + 999) / 1000;
+    if (rto < RTO_MIN_MS) return RTO_MIN_MS;
+    if (rto > RTO_MAX_MS) return RTO_MAX_MS;
+    return rto;
+}
+
+/**
+ * @brief Check whether the module may be sent a transaction. Always true unless the module is quarantined and its backoff has not elapsed.
+ * 
+ * @param now_ms millis()
+ * @return true 
+ * @return false 
+ */
+bool LinkHealth::probeDue(uint32_t now_ms) const {
+    if (!quarantined()) return true;
+    return (int32_t)(now_ms - probe_at_ms) >= 0;
+}
+
+/**
+ * @brief Update the round trip estimate with a successful transaction, and release the module from quarantine.
+ * 
+ * @param rtt_us Measured round trip time in microseconds.
+ */
+void LinkHealth::onSuccess(uint32_t rtt_us) {
+    if (!has_sample) {
+        srtt_us = rtt_us;
+        rttvar_us = rtt_us / 2;
+        has_sample = true;
+    } else {
+        uint32_t deviation = (srtt_us > rtt_us) ? srtt_us - rtt_us : rtt_us - srtt_us;
+        rttvar_us = (3 * rttvar_us + deviation) / 4;
+        srtt_us = (7 * srtt_us + rtt_us) / 8;
+    }
+
+    consecutive_failures = 0;
+    backoff_ms = 0;
+}
+
+/**
+ * @brief Record a failed transaction. Once quarantined, the time until the next probe doubles with every failure.
+ * 
+ * @param now_ms millis()
+ */
+void LinkHealth::onFailure(uint32_t now_ms) {
+    if (consecutive_failures < 255) consecutive_failures++;
+    if (!quarantined()) return;
+
+    backoff_ms = (backoff_ms == 0) ? QUARANTINE_BASE_MS : backoff_ms * 2;
+    if (backoff_ms > QUARANTINE_MAX_MS) backoff_ms = QUARANTINE_MAX_MS;
+    probe_at_ms = now_ms + backoff_ms;
+}
+
+/**
+ * @brief Count a round trip in its latency bucket.
+ * 
+ * @param rtt_us Measured round trip time in microseconds.
+ */
+void LinkStats::recordLatency(uint32_t rtt_us) {
+    uint32_t scaled = rtt_us >> 8;
+    uint8_t bucket = (scaled == 0) ? 0 : 32 - __builtin_clz(scaled);
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    latency[bucket]++;
+}
+
+/**
+ * @brief Get the lower bound of a latency bucket.
+ * 
+ * @param bucket 
+ * @return uint32_t Microseconds.
+ */
+uint32_t LinkStats::bucketFloor(uint8_t bucket) {
+    return (bucket == 0) ? 0 : 128 << bucket;
+}
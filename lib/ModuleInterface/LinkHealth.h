@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef LINK_HEALTH_H
+#define LINK_HEALTH_H
+
+#include <stdint.h>
+
+#define RTO_INITIAL_MS 250 // Timeout used until the first round trip has been measured.
+#define RTO_MIN_MS 10
+#define RTO_MAX_MS 1000
+
+#define QUARANTINE_FAILURES 3 // Consecutive failed transactions before a module is quarantined.
+#define QUARANTINE_BASE_MS 2000 // Time until the first probe of a quarantined module.
+#define QUARANTINE_MAX_MS 60000 // Longest time between probes of a quarantined module.
+
+#define LATENCY_BUCKETS 12 // Bucket 0 counts round trips under 256us, each following bucket doubles, the last is open ended.
+
+/**
+ * @brief Tracks the round trip time and responsiveness of a single module address. The retransmission timeout is estimated as in TCP
+ * (RFC 6298), from an EWMA of the round trip time plus four times its mean deviation, so healthy modules get tight timeouts.
+ * 
+ * After `QUARANTINE_FAILURES` consecutive failures the module is quarantined. It is then only probed once the backoff has elapsed, with the
+ * backoff doubling after each failed probe, so an unresponsive module no longer blocks every sample cycle.
+ */
+class LinkHealth {
+    private:
+        uint32_t srtt_us = 0;
+        uint32_t rttvar_us = 0;
+        bool has_sample = false;
+
+        uint8_t consecutive_failures = 0;
+        uint32_t backoff_ms = 0;
+        uint32_t probe_at_ms = 0;
+
+    public:
+        uint32_t timeout_ms() const;
+        uint32_t srtt() const { return srtt_us; }
+        bool quarantined() const { return consecutive_failures >= QUARANTINE_FAILURES; }
+        bool probeDue(uint32_t now_ms) const;
+
+        void onSuccess(uint32_t rtt_us);
+        void onFailure(uint32_t now_ms);
+};
+
+/**
+ * @brief Transaction counters and a log bucketed round trip histogram of a single module address. Fixed size, so recording never allocates.
+ */
+struct LinkStats {
+    uint32_t frames_sent = 0; // Including retries.
+    uint32_t frames_received = 0; // Reply frames.
+    uint32_t check_failures = 0; // Frames dropped for a bad checksum or CRC.
+    uint32_t size_mismatches = 0; // Frames dropped for an unexpected length.
+    uint32_t timeouts = 0; // Attempts with no ACK or reply in time.
+    uint32_t retries = 0;
+    uint32_t latency[LATENCY_BUCKETS] = {};
+
+    void recordLatency(uint32_t rtt_us);
+    static uint32_t bucketFloor(uint8_t bucket);
+};
+
+#endif
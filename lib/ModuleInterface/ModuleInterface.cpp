@@ -1,21 +1,87 @@
 #include "ModuleInterface.h"
 
-ModuleInterface::ModuleInterface(Stream* serial, uint8_t control_line_1, uint8_t control_line_2, uint8_t dir_pin){
+/**
+ * @brief Takes the bus mutex for the lifetime of the class.
+ */
+class BusLock {
+    private:
+        SemaphoreHandle_t& mutex;
+    public:
+        BusLock(SemaphoreHandle_t& bus_mutex) : mutex(bus_mutex) { xSemaphoreTake(mutex, portMAX_DELAY); }
+        ~BusLock() { xSemaphoreGive(mutex); }
+};
+
+/**
+ * @brief Construct a new interface to a single RS-485 bus. Each bus has its own daisy-chained control line used for addressing.
+ * 
+ * @param serial The stream of the bus.
+ * @param control_line The addressing control line of the bus.
+ * @param dir_pin The RS-485 transceiver direction pin.
+ */
+ModuleInterface::ModuleInterface(Stream* serial, uint8_t control_line, uint8_t dir_pin){
     stream = serial;
-    ctrl_1 = control_line_1;
-    ctrl_2 = control_line_2;
+    ctrl = control_line;
     dir = dir_pin;
+    bus_mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief Construct a new interface to a single RS-485 bus on a UART. Received data wakes the waiting task through a task notification,
+ * so bus transactions complete as soon as the frame is on the wire instead of at the next poll.
+ * 
+ * @param serial The UART of the bus.
+ * @param control_line The addressing control line of the bus.
+ * @param dir_pin The RS-485 transceiver direction pin.
+ */
+ModuleInterface::ModuleInterface(HardwareSerial* serial, uint8_t control_line, uint8_t dir_pin) : ModuleInterface((Stream*) serial, control_line, dir_pin) {
+    serial -> onReceive([this]() {
+        TaskHandle_t task = waiting_task;
+        if (task != NULL) xTaskNotifyGive(task);
+    });
+    rx_events = true;
 }
 
+ModuleInterface::~ModuleInterface() {
+    vSemaphoreDelete(bus_mutex);
+}
+
+/**
+ * @brief Address all the modules on the control line daisy chain, starting at address 1.
+ * 
+ * @return ps::vector<std::pair<AnnouncePacket, uint8_t>> The announce packet and assigned address of each module found.
+ */
 ps::vector<std::pair<AnnouncePacket, uint8_t>> ModuleInterface::begin(){
+    BusLock lock(bus_mutex);
+
     pinMode(dir, OUTPUT);
-    pinMode(ctrl_1, OUTPUT);
-    pinMode(ctrl_2, OUTPUT);
+    pinMode(ctrl, OUTPUT);
     digitalWrite(dir, LOW); // RX dir
-    digitalWrite(ctrl_1, HIGH); // Not addressing yet.
-    digitalWrite(ctrl_2, HIGH); // Not addressing yet.
+    digitalWrite(ctrl, HIGH); // Not addressing yet.
+
+    return address_chain(1, BUS_REPLY_TIMEOUT_MS); // Start addresses at 1.
+}
 
-    ESP_LOGI("Addressing", "Creating Packets.");
+/**
+ * @brief Address any modules which have been connected since the last addressing, without disturbing the modules already on the bus.
+ * Addressed modules pass the control line through, so only new modules announce themselves. Returns quickly if there are none.
+ * 
+ * @param first_address The next free address on the bus.
+ * @return ps::vector<std::pair<AnnouncePacket, uint8_t>> The announce packet and assigned address of each new module.
+ */
+ps::vector<std::pair<AnnouncePacket, uint8_t>> ModuleInterface::discover(uint8_t first_address) {
+    BusLock lock(bus_mutex);
+    return address_chain(first_address, BUS_DISCOVERY_LISTEN_MS);
+}
+
+/**
+ * @brief Pull the control line low, and address each module that announces itself in turn. Expects the bus mutex to be held.
+ * 
+ * @param first_address Address given to the first module to announce.
+ * @param listen_ms Time to wait for each announcement.
+ * @return ps::vector<std::pair<AnnouncePacket, uint8_t>> 
+ */
+ps::vector<std::pair<AnnouncePacket, uint8_t>> ModuleInterface::address_chain(uint8_t first_address, uint32_t listen_ms) {
+    ESP_LOGD("Addressing", "Creating Packets.");
     AddressPacket* address_packet = (AddressPacket*) calloc(1, sizeof(AddressPacket));
     transfer_out.begin((uint8_t*)address_packet, sizeof(AddressPacket), stream, 0, dir);
     
@@ -24,32 +90,28 @@ ps::vector<std::pair<AnnouncePacket, uint8_t>> ModuleInterface::begin(){
 
     clearStreamBuffer();
 
-    ESP_LOGI("Addressing", "Starting.");
+    ESP_LOGD("Addressing", "Starting.");
     ps::vector<std::pair<AnnouncePacket, uint8_t>> ret;
-    address_packet -> address = 1; // Start addresses at 1.
-    digitalWrite(ctrl_1, LOW); // Start Addressing.
+    address_packet -> address = first_address;
+    digitalWrite(ctrl, LOW); // Start Addressing.
     vTaskDelay(10 / portTICK_PERIOD_MS);
-    while(receive()) {
-        if (transmit(0)) { // Send address to module.
-            ESP_LOGI("Addressing", "Found Module: %s", &(announce_packet -> id[0]));
-            ret.push_back( 
-                std::make_pair(
-                    *announce_packet, address_packet->address
-                )
-            );
-            address_packet->address ++;
-        } else ESP_LOGE("TX", "Failed to send address.");
-    }
-
-    clearStreamBuffer();
 
-    digitalWrite(ctrl_1, HIGH); // End Addressing on Line 1.
-    digitalWrite(ctrl_2, LOW); // Start Addressing on Line 2.
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+    while(address_packet -> address < EASYTRANSFER_BROADCAST_ID && receive(transfer_in, listen_ms)) {
+        bool addressed = false;
+        for (uint8_t attempt = 0; attempt < BUS_MAX_ATTEMPTS && !addressed; attempt++) {
+            addressed = transmit(0, true, BUS_ACK_TIMEOUT_MS); // Send address to module.
+        }
 
-    while(receive()) {
-        if (transmit(0)) { // Send address to module.
+        if (addressed) {
             ESP_LOGI("Addressing", "Found Module: %s", &(announce_packet -> id[0]));
+            latch_capable[address_packet -> address] = announce_packet -> firmware_version >= LATCH_MIN_FIRMWARE_VERSION;
+            bool batched = announce_packet -> firmware_version >= BATCH_MIN_FIRMWARE_VERSION;
+            if (batched && batch_capable.count() >= BATCH_MAX_MODULES) { // The bus can't keep up, read the rest once per cycle.
+                ESP_LOGW("Addressing", "Over %u batch read modules, module %u read once per cycle.", BATCH_MAX_MODULES, address_packet -> address);
+                batched = false;
+            }
+            batch_capable[address_packet -> address] = batched;
+            links[address_packet -> address] = LinkHealth();
             ret.push_back( 
                 std::make_pair(
                     *announce_packet, address_packet->address
@@ -59,26 +121,52 @@ ps::vector<std::pair<AnnouncePacket, uint8_t>> ModuleInterface::begin(){
         } else ESP_LOGE("TX", "Failed to send address.");
     }
 
-    ESP_LOGI("Addressing", "Finished.");
+    ESP_LOGD("Addressing", "Finished.");
     free(announce_packet);
     free(address_packet);
-    digitalWrite(ctrl_2, HIGH); // End Addressing on line 2.
+    digitalWrite(ctrl, HIGH); // End Addressing.
 
-    transfer_in = EasyTransfer();
-    transfer_out = EasyTransfer();
     transfer_in.begin(details(reading_packet), stream, 0, dir); // Switch to receiving readings.
+    transfer_batch.begin(details(batch_packet), stream, 0, dir, true);
     transfer_out.begin(details(operation_packet), stream, 0, dir); // Switch to sending operations.
     
     clearStreamBuffer();
 
+    for (auto& found : ret) negotiate_frames(found.second, found.first.firmware_version);
+
     return ret;
 }
 
+/**
+ * @brief Switch a module to CRC-16 frames if its firmware supports them. The request is sent with the XOR checksum, and only once it is
+ * ACKed are further frames to the module sent with a CRC. Expects the bus mutex to be held.
+ * 
+ * @param address 
+ * @param firmware_version From the module's announcement.
+ */
+void ModuleInterface::negotiate_frames(uint8_t address, uint16_t firmware_version) {
+    crc_frames[address] = false;
+    if (firmware_version < CRC_MIN_FIRMWARE_VERSION) return;
+
+    operation_packet.operation = OPERATION_ENABLE_CRC;
+    crc_frames[address] = transact(address, true, false);
+
+    if (!crc_frames[address]) ESP_LOGW("ModuleInterface", "Module %u did not accept CRC frames.", address);
+}
+
 
+/**
+ * @brief Send an operation to the module, and wait for it to be ACKed.
+ * 
+ * @param address 
+ * @param operation 
+ * @return true - If the module ACKed the operation.
+ */
 bool ModuleInterface::sendOperation(uint8_t address, uint16_t operation){
+    BusLock lock(bus_mutex);
     operation_packet.operation = operation;
 
-    return transmit(address);
+    return transact(address, true, false);
 }
 
 /**
@@ -87,41 +175,232 @@ bool ModuleInterface::sendOperation(uint8_t address, uint16_t operation){
  * @return The reading data packet.
 */
 ReadingDataPacket ModuleInterface::getReading(uint8_t address){
-    reading_packet = ReadingDataPacket();
+    BusLock lock(bus_mutex);
+    return request_reading(address, OPERATION_READ_METER, true);
+}
+
+/**
+ * @brief Broadcast a latch operation, so that every module on the bus snapshots its meter at the same instant. The latched readings can then
+ * be fetched with `getLatchedReading()`. Modules which do not support latching ignore the operation.
+ * 
+ * @return true - The broadcast was sent.
+ */
+bool ModuleInterface::latchReadings() {
+    BusLock lock(bus_mutex);
+    operation_packet.operation = OPERATION_LATCH_READING;
 
     clearStreamBuffer();
-    if (!sendOperation(address, OPERATION_READ_METER)) {
+    if (!transfer_out.sendData(EASYTRANSFER_BROADCAST_ID)) return false;
+
+    vTaskDelay(LATCH_SETTLE_MS / portTICK_PERIOD_MS);
+    return true;
+}
+
+/**
+ * @brief Fetch the reading latched by the last `latchReadings()` broadcast. The reply acknowledges the request, saving one bus turnaround
+ * compared to `getReading()`.
+ * @note voltage will be set to -1 of the reading fails.
+ * @return The latched reading data packet.
+ */
+ReadingDataPacket ModuleInterface::getLatchedReading(uint8_t address) {
+    BusLock lock(bus_mutex);
+    return request_reading(address, OPERATION_READ_LATCHED, false);
+}
+
+/**
+ * @brief Fetch the readings a module has buffered since it was last read. Batches are fetched until the module has none pending, up to
+ * `BATCH_MAX_FRAMES`, enough to empty its whole buffer, so a module sampling faster than it is polled only costs one bus transaction per
+ * batch of readings, and none are left to overflow before the next read.
+ * 
+ * @param address 
+ * @param batch Filled with the readings, oldest first. Ages are relative to the last batch, so to the time this returns within a frame time.
+ * @return true - If at least the first batch was received.
+ */
+bool ModuleInterface::getBatch(uint8_t address, ps::vector<BatchEntry>& batch) {
+    BusLock lock(bus_mutex);
+    batch.clear();
+    uint32_t last_request_us = 0;
+
+    for (uint8_t frame = 0; frame < BATCH_MAX_FRAMES; frame++) {
+        operation_packet.operation = OPERATION_READ_BATCH;
+        batch_packet.count = 0;
+        batch_packet.pending = 0;
+
+        // Modules age their entries when they reply, so the request is the common reference, whatever each frame's wire time.
+        uint32_t request_us = micros();
+        if (!transact(address, false, true, &transfer_batch)) return frame > 0;
+
+        uint8_t count = batch_packet.count;
+        if (transfer_batch.receivedLength() < BATCH_HEADER_SIZE + count * sizeof(BatchEntry)) {
+            ESP_LOGW("ModuleInterface", "Module %u sent a short batch.", address);
+            return frame > 0;
+        }
+
+        for (auto& entry : batch) { // Age the earlier batches to this one.
+            uint32_t age_ms = entry.age_ms + (request_us - last_request_us) / 1000;
+            entry.age_ms = (age_ms > UINT16_MAX) ? UINT16_MAX : age_ms;
+        }
+        last_request_us = request_us;
+
+        batch.insert(batch.end(), batch_packet.entries, batch_packet.entries + count);
+        if (batch_packet.pending == 0) break;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Send a reading operation to the address and wait for the reading. Expects the bus mutex to be held.
+ * 
+ * @param address 
+ * @param operation 
+ * @param wait_for_ack Whether the module ACKs the operation before replying.
+ * @return ReadingDataPacket 
+ */
+ReadingDataPacket ModuleInterface::request_reading(uint8_t address, uint16_t operation, bool wait_for_ack) {
+    reading_packet = ReadingDataPacket();
+    operation_packet.operation = operation;
+
+    if (!transact(address, wait_for_ack, true)) {
         reading_packet.voltage = -1;
         return reading_packet;
     }
 
-    receive();
-
     return reading_packet;
 }
 
+/**
+ * @brief Perform a transaction with a module using its adaptive timeout. Failed attempts are retried with the timeout doubled, up to
+ * `BUS_MAX_ATTEMPTS`. Quarantined modules fail immediately until their next probe is due, and are then probed with a single attempt.
+ * Expects the bus mutex to be held, and the operation packet to be loaded.
+ * 
+ * @param address 
+ * @param wait_for_ack Whether the module ACKs the operation.
+ * @param wait_for_reply Whether the module replies with a frame.
+ * @param reply Receiver for the reply frame, if not the reading packet.
+ * @return true - If the transaction completed.
+ */
+bool ModuleInterface::transact(uint8_t address, bool wait_for_ack, bool wait_for_reply, EasyTransfer* reply) {
+    EasyTransfer& transfer = (reply != nullptr) ? *reply : transfer_in;
+    LinkHealth& link = links[address];
+    if (!link.probeDue(millis())) return false;
+
+    uint32_t timeout = link.timeout_ms();
+    uint8_t attempts = link.quarantined() ? 1 : BUS_MAX_ATTEMPTS;
+
+    LinkStats& link_stats = stats[address];
+    uint32_t check_failures = transfer.checkFailures();
+    uint32_t size_mismatches = transfer.sizeMismatches();
+    bool success = false;
+
+    for (uint8_t attempt = 0; attempt < attempts && !success; attempt++) {
+        clearStreamBuffer();
+        transfer.resetReceive(); // A reply cut off by the last timeout would otherwise take in the start of this one.
+        uint32_t start_us = micros();
+
+        link_stats.frames_sent++;
+        if (attempt > 0) link_stats.retries++;
+
+        success = transmit(address, wait_for_ack, timeout) && (!wait_for_reply || receive(transfer, timeout));
+        if (!success) {
+            link_stats.timeouts++;
+        } else {
+            uint32_t rtt_us = micros() - start_us;
+            if (wait_for_reply) link_stats.frames_received++;
+            link_stats.recordLatency(rtt_us);
+            link.onSuccess(rtt_us);
+        }
+
+        timeout = (timeout * 2 < RTO_MAX_MS) ? timeout * 2 : RTO_MAX_MS;
+    }
+
+    // Framing errors seen while waiting for this module are attributed to it.
+    link_stats.check_failures += transfer.checkFailures() - check_failures;
+    link_stats.size_mismatches += transfer.sizeMismatches() - size_mismatches;
+    if (success) return true;
+
+    link.onFailure(millis());
+    if (link.quarantined()) ESP_LOGW("ModuleInterface", "Module %u unresponsive, quarantined.", address);
+    return false;
+}
+
+/**
+ * @brief Get the bus statistics of a module since the last call, then reset them.
+ * 
+ * @param address 
+ * @return LinkStats 
+ */
+LinkStats ModuleInterface::takeLinkStats(uint8_t address) {
+    BusLock lock(bus_mutex);
+    LinkStats ret = stats[address];
+    stats[address] = LinkStats();
+    return ret;
+}
+
 void ModuleInterface::clearStreamBuffer() {
     while(stream -> available() ) {
         stream -> read();
     }
 }
 
-bool ModuleInterface::transmit(uint8_t address) {
-    uint32_t start_tm = millis();
-    while((millis() - start_tm) < 1000) {
-        if (transfer_out.sendData(address)) return true;
-        vTaskDelay(250 / portTICK_PERIOD_MS);
-    };
+/**
+ * @brief Send the operation packet to the address once.
+ * 
+ * @param address 
+ * @param wait_for_ack False if the module does not ACK this operation, e.g. because its reply acknowledges it.
+ * @param timeout_ms Time to wait for the ACK.
+ * @return true - If sent (and ACKed).
+ */
+bool ModuleInterface::transmit(uint8_t address, bool wait_for_ack, uint32_t timeout_ms) {
+    transfer_out.sendData(address, false, crc_frames[address]);
+    if (!wait_for_ack) return true;
 
-    return false;
+    return wait_until([this]() { return transfer_out.receiveAck(); }, timeout_ms);
 }
 
-bool ModuleInterface::receive() {
+/**
+ * @brief Wait for a frame to be received by the transfer. The timeout is learnt from short frames, so a long frame (e.g. a batch) that is
+ * still arriving when it elapses is given its wire time to finish.
+ * 
+ * @param transfer 
+ * @param timeout_ms 
+ * @return true - If a frame was received.
+ */
+bool ModuleInterface::receive(EasyTransfer& transfer, uint32_t timeout_ms) {
+    auto received = [&transfer]() { return transfer.receiveData(); };
+    if (wait_until(received, timeout_ms)) return true;
+
+    return transfer.receiving() && wait_until(received, BUS_FRAME_MAX_MS);
+}
+
+/**
+ * @brief Block the calling task until the condition is met or the timeout elapses. The condition is checked whenever the UART signals that
+ * data has arrived, or every tick if the stream does not support receive events.
+ * 
+ * @param condition Non-blocking check, e.g. feeding the received bytes through the framing state machine.
+ * @param timeout_ms 
+ * @return true - If the condition was met.
+ */
+bool ModuleInterface::wait_until(std::function<bool()> condition, uint32_t timeout_ms) {
+    ulTaskNotifyTake(pdTRUE, 0); // Discard any stale notification.
+    waiting_task = xTaskGetCurrentTaskHandle();
+
     uint32_t start_tm = millis();
-    while((millis() - start_tm) < 1000) {
-        if (transfer_in.receiveData()) return true;
-        vTaskDelay(25 / portTICK_PERIOD_MS);
-    };
+    bool ret = false;
 
-    return false;
+    while (1) {
+        if (condition()) {
+            ret = true;
+            break;
+        }
+
+        uint32_t elapsed_tm = millis() - start_tm;
+        if (elapsed_tm >= timeout_ms) break;
+
+        TickType_t wait_ticks = rx_events ? (timeout_ms - elapsed_tm) / portTICK_PERIOD_MS : 1;
+        ulTaskNotifyTake(pdTRUE, (wait_ticks > 0) ? wait_ticks : 1);
+    }
+
+    waiting_task = NULL;
+    return ret;
 }
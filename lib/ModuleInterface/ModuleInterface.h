@@ -3,8 +3,10 @@
 #ifndef EASY_INTERFACE_H
 #define EASY_INTERFACE_H
 #include <Arduino.h>
+#include <bitset>
 #include <ps_stl.h>
 #include "EasyTransfer.h"
+#include "LinkHealth.h"
 
 struct AnnouncePacket {
     char id[38];
@@ -30,36 +32,106 @@ struct ReadingDataPacket {
   float energy_usage;
 } __attribute__ ((packed));
 
+/**
+ * @brief A reading buffered by a module, with its age when the batch was sent.
+ */
+struct BatchEntry {
+    uint16_t age_ms;
+    ReadingDataPacket reading;
+} __attribute__ ((packed));
+
+#define BATCH_HEADER_SIZE 2
+#define BATCH_MAX_READINGS ((255 - BATCH_HEADER_SIZE) / sizeof(BatchEntry)) // As many as fit the 255 byte frame length limit.
+
+/**
+ * @brief A variable length frame of buffered readings, oldest first. Only `count` entries are sent.
+ */
+struct BatchReadingPacket {
+    uint8_t count;
+    uint8_t pending; // Readings still buffered on the module, to be fetched with another batch.
+    BatchEntry entries[BATCH_MAX_READINGS];
+} __attribute__ ((packed));
+
 
 #define OPERATION_RELAY_SET 0x0001
 #define OPERATION_RELAY_RESET 0x0002
 #define OPERATION_READ_METER 0x0004
+#define OPERATION_LATCH_READING 0x0008 // Broadcast. Each module snapshots its meter into its latch register.
+#define OPERATION_READ_LATCHED 0x0010 // Not ACKed, the module replies with its latched reading.
+#define OPERATION_ENABLE_CRC 0x0020 // ACKed, the module then replies with CRC-16 frames.
+#define OPERATION_READ_BATCH 0x0040 // Not ACKed, the module replies with a BatchReadingPacket of its buffered readings.
+
+#define LATCH_MIN_FIRMWARE_VERSION 2 // Oldest module firmware which supports latched readings.
+#define LATCH_SETTLE_MS 2 // Time for the modules to snapshot their meters after a latch broadcast.
+
+#define CRC_MIN_FIRMWARE_VERSION 3 // Oldest module firmware which supports CRC-16 frames.
+#define BATCH_MIN_FIRMWARE_VERSION 4 // Oldest module firmware which buffers readings for OPERATION_READ_BATCH.
+#define BATCH_BUFFER_READINGS 64 // Readings module firmware buffers between batch reads, dropping the oldest beyond.
+#define BATCH_MAX_FRAMES ((BATCH_BUFFER_READINGS + BATCH_MAX_READINGS - 1) / BATCH_MAX_READINGS) // Enough to empty a full buffer in one read.
+#define BATCH_SAMPLE_HZ 10 // Rate module firmware buffers readings at.
+#define BATCH_MAX_MODULES 16 // Modules batch read per bus, the rest read once per cycle. Modules are polled once a second, so a cycle must
+                             // finish within it. Draining BATCH_SAMPLE_HZ readings from each takes ~720ms for 16 in the bus benchmark, ~1.8s for 32.
+
+#define BUS_ACK_TIMEOUT_MS 100 // Time to wait for an ACK during addressing.
+#define BUS_REPLY_TIMEOUT_MS 1000 // Time to wait for an announcement during addressing.
+#define BUS_MAX_ATTEMPTS 3 // Attempts per transaction before it fails.
+#define BUS_FRAME_MAX_MS 25 // Wire time of the longest frame at 115200 baud, allowed for a frame still arriving at the timeout.
+#define BUS_DISCOVERY_LISTEN_MS 50 // Time to wait for an announcement when checking for newly connected modules.
 
 class ModuleInterface {
     public:
-    ModuleInterface(Stream* serial, uint8_t control_line_1, uint8_t control_line_2, uint8_t dir_pin);
+    ModuleInterface(Stream* serial, uint8_t control_line, uint8_t dir_pin);
+    ModuleInterface(HardwareSerial* serial, uint8_t control_line, uint8_t dir_pin);
+    ~ModuleInterface();
     
     ps::vector<std::pair<AnnouncePacket, uint8_t>> begin();
+    ps::vector<std::pair<AnnouncePacket, uint8_t>> discover(uint8_t first_address);
 
     bool sendOperation(uint8_t address, uint16_t operation);
     ReadingDataPacket getReading(uint8_t address);
 
+    bool latchReadings();
+    ReadingDataPacket getLatchedReading(uint8_t address);
+    bool supportsLatch(uint8_t address) { return latch_capable[address]; }
+    const LinkHealth& linkHealth(uint8_t address) { return links[address]; }
+    LinkStats takeLinkStats(uint8_t address);
+    bool usesCRC(uint8_t address) { return crc_frames[address]; }
+
+    bool getBatch(uint8_t address, ps::vector<BatchEntry>& batch);
+    bool supportsBatch(uint8_t address) { return batch_capable[address]; }
+
     private:
     Stream* stream;
-    uint8_t ctrl_1;
-    uint8_t ctrl_2;
+    uint8_t ctrl;
     uint8_t dir;
 
+    SemaphoreHandle_t bus_mutex; // Held for the duration of each bus transaction.
+    std::bitset<256> latch_capable; // Addresses whose firmware supports OPERATION_LATCH_READING.
+    std::bitset<256> crc_frames; // Addresses which have switched to CRC-16 frames.
+    std::bitset<256> batch_capable; // Addresses whose firmware supports OPERATION_READ_BATCH.
+    LinkHealth links[256]; // Round trip estimate and quarantine state of each address.
+    LinkStats stats[256]; // Transaction counters of each address, since they were last taken.
+
+    bool rx_events = false; // Whether the UART notifies us of received data, else the stream is polled.
+    volatile TaskHandle_t waiting_task = NULL; // Task to notify when data is received.
+    bool wait_until(std::function<bool()> condition, uint32_t timeout_ms);
+
     friend class EasyTransfer;
     EasyTransfer transfer_in;
     EasyTransfer transfer_out;
+    EasyTransfer transfer_batch; // Receives variable length batch frames.
 
     OperationPacket operation_packet;
     ReadingDataPacket reading_packet;
+    BatchReadingPacket batch_packet;
 
     void clearStreamBuffer();
-    bool transmit(uint8_t address);
-    bool receive();
+    ps::vector<std::pair<AnnouncePacket, uint8_t>> address_chain(uint8_t first_address, uint32_t listen_ms);
+    void negotiate_frames(uint8_t address, uint16_t firmware_version);
+    bool transmit(uint8_t address, bool wait_for_ack, uint32_t timeout_ms);
+    bool receive(EasyTransfer& transfer, uint32_t timeout_ms);
+    bool transact(uint8_t address, bool wait_for_ack, bool wait_for_reply, EasyTransfer* reply = nullptr);
+    ReadingDataPacket request_reading(uint8_t address, uint16_t operation, bool wait_for_ack);
 
 };
 
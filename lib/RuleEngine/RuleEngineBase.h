@@ -17,6 +17,8 @@ class RuleEngineBase : public RuleEngine {
     private:
     ps::vector<ps::string> class_tags;
     ps::vector<std::tuple<int, ps::string, ps::string>> rules;
+    uint32_t state_version = 0; // Bumped by every change to the rules or tags.
+    uint32_t saved_version = 0; // The state version as of the last save. Equal at construction, so only a real change needs saving.
 
     public:
     RuleEngineBase(const ps::string& tag_array_name, std::shared_ptr<FunctionStorage>& function_store) : RuleEngine(function_store) {
@@ -38,6 +40,7 @@ class RuleEngineBase : public RuleEngine {
     void clear_rules() override {
         RuleEngine::clear_rules();
         rules.clear();
+        changed();
     }
 
     void add_rule(int priority, ps::string& expression, ps::string& command) {
@@ -47,6 +50,7 @@ class RuleEngineBase : public RuleEngine {
     void add_rule(std::tuple<int, ps::string, ps::string> new_rule){
         rules.push_back(new_rule);
         RuleEngine::add_rule(new_rule);
+        changed();
     }
 
     void add_rule(ps::vector<std::tuple<int, ps::string, ps::string>> new_rules) {
@@ -54,6 +58,7 @@ class RuleEngineBase : public RuleEngine {
             rules.push_back(rule);
             RuleEngine::add_rule(rule);
         } 
+        changed();
     }
 
     void replace_rules(std::tuple<int, ps::string, ps::string> new_rule) {
@@ -72,6 +77,7 @@ class RuleEngineBase : public RuleEngine {
      */
     void clear_tags() {
         class_tags.clear();
+        changed();
     }
     /**
      * @brief Get a read write reference to the class tags list.
@@ -100,6 +106,7 @@ class RuleEngineBase : public RuleEngine {
         for (auto& tag : tags) {
             class_tags.push_back(tag);
         }
+        changed();
     }
 
     /**
@@ -109,6 +116,7 @@ class RuleEngineBase : public RuleEngine {
      */
     void add_tag(ps::string tag) {
         class_tags.push_back(tag);
+        changed();
     }
 
 
@@ -119,6 +127,7 @@ class RuleEngineBase : public RuleEngine {
      */
     void replace_tag(ps::vector<ps::string> tags) {
         class_tags = tags;
+        changed();
     }
 
 
@@ -130,6 +139,7 @@ class RuleEngineBase : public RuleEngine {
     void replace_tag(ps::string tag) {
         class_tags.clear();
         class_tags.push_back(tag);
+        changed();
     }
 
     void load_rule_engine(JsonObject& obj) {
@@ -144,6 +154,43 @@ class RuleEngineBase : public RuleEngine {
         for (auto tag : tag_arr) {
             class_tags.push_back(tag.as<ps::string>());
         }
+        changed();
+    }
+
+    /**
+     * @brief Mark the saved state as changed. Called by every method changing the rules or tags, and by derived classes when other saved
+     * state of theirs changes.
+     * 
+     */
+    void changed() {
+        state_version++;
+    }
+
+    /**
+     * @brief Get the version of the saved state, which changes whenever the state does.
+     * 
+     * @return uint32_t 
+     */
+    uint32_t version() const {
+        return state_version;
+    }
+
+    /**
+     * @brief Check whether the saved state has changed since it was last saved.
+     * 
+     * @return true - If it has changed since it was last saved or loaded.
+     */
+    bool unsaved() const {
+        return state_version != saved_version;
+    }
+
+    /**
+     * @brief Record that the state was saved as of the given version. Changes made since that version keep the state unsaved.
+     * 
+     * @param version The version the state had when it was saved.
+     */
+    void markSaved(uint32_t version) {
+        saved_version = version;
     }
 
     void save_rule_engine(JsonObject& obj) {
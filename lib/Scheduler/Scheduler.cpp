@@ -50,6 +50,7 @@ void Scheduler::load(JsonArray& array) {
     for (JsonObject item : array) {
         items.push_back(SchedulerItem(item));
     }
+    state_version++;
 }
 
 /**
@@ -95,6 +96,7 @@ ps::vector<SchedulerItem> Scheduler::check() {
         }
     }
 
+    if (ret.size() > 0) state_version++; // Due items were rescheduled or removed.
     return ret;
 }
 
@@ -103,6 +105,7 @@ ps::vector<SchedulerItem> Scheduler::check() {
 */
 void Scheduler::clear() {
     items.clear();
+    state_version++;
 }
 
 /**
@@ -112,6 +115,7 @@ void Scheduler::clear() {
  */
 void Scheduler::add(SchedulerItem item) {
     items.push_back(item);
+    state_version++;
 }
 
 /**
@@ -124,10 +128,38 @@ void Scheduler::clearModule(ps::string module_id) {
         if (items[i].module_id == module_id) {
             items.erase(items.begin() + i);
             i--;
+            state_version++;
         }
     }
 }
 
+/**
+ * @brief Get the version of the items, which changes whenever they do.
+ * 
+ * @return uint32_t 
+ */
+uint32_t Scheduler::version() const {
+    return state_version;
+}
+
+/**
+ * @brief Check whether the items have changed since they were last saved.
+ * 
+ * @return true - If they have changed since they were last saved or loaded.
+ */
+bool Scheduler::unsaved() const {
+    return state_version != saved_version;
+}
+
+/**
+ * @brief Record that the items were saved as of the given version.
+ * 
+ * @param version The version the items had when they were saved.
+ */
+void Scheduler::markSaved(uint32_t version) {
+    saved_version = version;
+}
+
 // QueueHandle_t queue;
 // SemaphoreHandle_t scheduler_semaphore;
 
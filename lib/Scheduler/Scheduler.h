@@ -19,6 +19,8 @@ class SchedulerItem{
 class Scheduler {
     private:
     ps::vector<SchedulerItem> items;
+    uint32_t state_version = 0; // Bumped by every change to the items.
+    uint32_t saved_version = 0; // The state version as of the last save. Equal at construction, so only a real change needs saving.
     uint64_t getEpoch();
 
     public:
@@ -33,5 +35,9 @@ class Scheduler {
     void clear();
 
     ps::vector<SchedulerItem> check();
+
+    uint32_t version() const;
+    bool unsaved() const;
+    void markSaved(uint32_t version);
 };
 
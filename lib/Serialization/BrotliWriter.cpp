@@ -0,0 +1,263 @@
+#include "BrotliWriter.h"
+#include <esp_heap_caps.h>
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+uint8_t* BrotliWriter::arena = nullptr;
+size_t BrotliWriter::arena_used = 0;
+SemaphoreHandle_t BrotliWriter::arena_lock = NULL;
+
+/**
+ * @brief Reserve the encoder's arena in PSRAM, and prepare the shared dictionary, once at boot.
+ *
+ * @return true - If the arena was reserved. Otherwise encoders allocate from the heap.
+ */
+bool BrotliWriter::begin() {
+    if (arena != nullptr) return true;
+
+    if (codec::preparedDictionary(MESSAGE_DICTIONARY_VERSION) == nullptr) ESP_LOGW("BrotliWriter", "Compressing without the dictionary.");
+
+    arena_lock = xSemaphoreCreateMutex();
+    arena = (uint8_t*) heap_caps_malloc(BROTLI_WRITER_ARENA_SIZE, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    return arena != nullptr;
+}
+
+/**
+ * @brief Get the encoder memory a level needs, for choosing a level which fits the heap when no arena is reserved.
+ *
+ * @param level
+ * @return size_t
+ */
+size_t BrotliWriter::encoderSize(MessageCompression level) {
+    if (level == COMPRESSION_STORED) return 0;
+    return (level == COMPRESSION_FAST) ? BROTLI_WRITER_FAST_SIZE : BROTLI_WRITER_ARENA_SIZE;
+}
+
+/**
+ * @brief Allocate encoder memory from the arena. Memory is never reused within one message, as the encoder only grows its buffers.
+ *
+ * @return void* - nullptr once the arena is full, which fails the message.
+ */
+void* BrotliWriter::arena_alloc(void* opaque, size_t size) {
+    (void) opaque;
+    size = (size + 7) & ~((size_t) 7);
+    if (size > BROTLI_WRITER_ARENA_SIZE - arena_used) {
+        ESP_LOGE("BrotliWriter", "Encoder arena full, %u bytes requested.", size);
+        return nullptr;
+    }
+
+    void* ret = arena + arena_used;
+    arena_used += size;
+    return ret;
+}
+
+void BrotliWriter::arena_free(void* opaque, void* address) {
+    (void) opaque;
+    (void) address; // Emptied as a whole when the writer is destroyed.
+}
+
+/**
+ * @brief Construct a new Brotli Writer. The encoder's state is allocated from the arena, waiting for it if another writer has it, or from
+ * PSRAM by the esp-brotli platform layer if no arena is reserved.
+ *
+ * @param mode BROTLI_MODE_TEXT for JSON, BROTLI_MODE_GENERIC for binary encodings.
+ * @param compression Level to compress at, COMPRESSION_STORED to only base64 encode.
+ * @param dictionary Version of the shared dictionary to compress with, or MESSAGE_DICTIONARY_NONE.
+ */
+BrotliWriter::BrotliWriter(BrotliEncoderMode mode, MessageCompression compression, uint8_t dictionary) : compression(compression) {
+    if (compression == COMPRESSION_STORED) {
+        uint8_t header = codec::header(compression, MESSAGE_DICTIONARY_NONE);
+        encode(&header, 1);
+        return;
+    }
+
+    if (arena != nullptr) {
+        xSemaphoreTake(arena_lock, portMAX_DELAY);
+        holds_arena = true;
+        arena_used = 0;
+        encoder = BrotliEncoderCreateInstance(arena_alloc, arena_free, NULL);
+    } else {
+        encoder = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    }
+
+    if (encoder == NULL) {
+        ESP_LOGE("BrotliWriter", "Failed to create encoder.");
+        failed = true;
+        return;
+    }
+
+    int quality = (compression == COMPRESSION_FAST) ? BROTLI_WRITER_QUALITY_FAST :
+                  (compression == COMPRESSION_BALANCED) ? BROTLI_WRITER_QUALITY_BALANCED : BROTLI_WRITER_QUALITY;
+    BrotliEncoderSetParameter(encoder, BROTLI_PARAM_MODE, mode);
+    BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY, quality);
+    BrotliEncoderSetParameter(encoder, BROTLI_PARAM_LGWIN, BROTLI_WRITER_LGWIN);
+
+    if (quality < BROTLI_WRITER_QUALITY_BALANCED) dictionary = MESSAGE_DICTIONARY_NONE; // It would be attached, but not used.
+    if (dictionary != MESSAGE_DICTIONARY_NONE) {
+        const BrotliEncoderPreparedDictionary* prepared = codec::preparedDictionary(dictionary);
+        if (prepared == nullptr || !BrotliEncoderAttachPreparedDictionary(encoder, prepared)) {
+            ESP_LOGW("BrotliWriter", "Dictionary v%u unavailable, compressing without it.", dictionary);
+            dictionary = MESSAGE_DICTIONARY_NONE;
+        }
+    }
+
+    uint8_t header = codec::header(compression, dictionary);
+    encode(&header, 1);
+}
+
+BrotliWriter::~BrotliWriter() {
+    if (encoder != NULL) BrotliEncoderDestroyInstance(encoder);
+    if (holds_arena) xSemaphoreGive(arena_lock);
+    free(payload);
+}
+
+size_t BrotliWriter::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+/**
+ * @brief Gather serialized bytes into the chunk, compressing each full chunk. Stored bytes are base64 encoded straight away.
+ *
+ * @param s
+ * @param n
+ * @return size_t The number of bytes taken, 0 once compression has failed so that serialization stops.
+ */
+size_t BrotliWriter::write(const uint8_t* s, size_t n) {
+    if (failed) return 0;
+
+    if (encoder == NULL) { // Stored.
+        encode(s, n);
+        input_length += n;
+        return failed ? 0 : n;
+    }
+
+    size_t taken = 0;
+    while (taken < n) {
+        size_t length = min(n - taken, BROTLI_WRITER_CHUNK_SIZE - chunk_length);
+        memcpy(chunk + chunk_length, s + taken, length);
+        chunk_length += length;
+        taken += length;
+
+        if (chunk_length == BROTLI_WRITER_CHUNK_SIZE && !compress(BROTLI_OPERATION_PROCESS)) return 0;
+    }
+
+    input_length += n;
+    return n;
+}
+
+/**
+ * @brief Compress the remaining input, end the brotli stream and pad the base64 payload.
+ *
+ * @return true - If the payload is complete.
+ */
+bool BrotliWriter::finish() {
+    if (failed) return false;
+    if (encoder != NULL && !compress(BROTLI_OPERATION_FINISH)) return false;
+
+    if (group_length > 0) { // Pad the final group.
+        char quad[4];
+        quad[0] = base64_chars[group[0] >> 2];
+        quad[1] = base64_chars[((group[0] & 0x03) << 4) | ((group_length > 1) ? group[1] >> 4 : 0)];
+        quad[2] = (group_length > 1) ? base64_chars[(group[1] & 0x0F) << 2] : '=';
+        quad[3] = '=';
+        append(quad);
+        group_length = 0;
+    }
+
+    return !failed;
+}
+
+/**
+ * @brief Take ownership of the payload buffer. It is NUL terminated.
+ *
+ * @param length Set to the length of the payload.
+ * @return char* The payload, or nullptr if compression failed.
+ */
+char* BrotliWriter::release(size_t& length) {
+    if (failed) return nullptr;
+
+    char* ret = payload;
+    length = payload_length;
+
+    payload = nullptr;
+    payload_length = 0;
+    payload_capacity = 0;
+    return ret;
+}
+
+/**
+ * @brief Feed the chunk to the encoder, and encode whatever output it has ready, taken directly from the encoder's own buffer.
+ *
+ * @param operation
+ * @return true - If successful.
+ */
+bool BrotliWriter::compress(BrotliEncoderOperation operation) {
+    const uint8_t* next_in = chunk;
+    size_t available_in = chunk_length;
+
+    do {
+        size_t available_out = 0;
+        if (!BrotliEncoderCompressStream(encoder, operation, &available_in, &next_in, &available_out, NULL, NULL)) {
+            ESP_LOGE("BrotliWriter", "Compression failed.");
+            failed = true;
+            return false;
+        }
+
+        while (BrotliEncoderHasMoreOutput(encoder)) {
+            size_t size = 0;
+            const uint8_t* output = BrotliEncoderTakeOutput(encoder, &size);
+            encode(output, size);
+        }
+    } while (available_in > 0 || (operation == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(encoder)));
+
+    chunk_length = 0;
+    return !failed;
+}
+
+/**
+ * @brief Base64 encode compressed bytes onto the payload, carrying any incomplete group over to the next call.
+ *
+ * @param data
+ * @param length
+ */
+void BrotliWriter::encode(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        group[group_length++] = data[i];
+        if (group_length < 3) continue;
+
+        char quad[4] = {
+            base64_chars[group[0] >> 2],
+            base64_chars[((group[0] & 0x03) << 4) | (group[1] >> 4)],
+            base64_chars[((group[1] & 0x0F) << 2) | (group[2] >> 6)],
+            base64_chars[group[2] & 0x3F]
+        };
+        append(quad);
+        group_length = 0;
+    }
+}
+
+/**
+ * @brief Append four base64 characters to the payload, growing it in PSRAM as required.
+ *
+ * @param quad
+ */
+void BrotliWriter::append(const char* quad) {
+    if (failed) return;
+
+    if (payload_length + 5 > payload_capacity) { // Room for the quad and the terminator.
+        size_t capacity = (payload_capacity > 0) ? payload_capacity * 2 : BROTLI_WRITER_INITIAL_CAPACITY;
+        char* grown = (char*) heap_caps_realloc(payload, capacity, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        if (grown == nullptr) {
+            ESP_LOGE("BrotliWriter", "Failed to allocate %u byte payload.", capacity);
+            failed = true;
+            return;
+        }
+
+        payload = grown;
+        payload_capacity = capacity;
+    }
+
+    memcpy(payload + payload_length, quad, 4);
+    payload_length += 4;
+    payload[payload_length] = '\0';
+}
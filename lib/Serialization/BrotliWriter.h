@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef BROTLI_WRITER_H
+#define BROTLI_WRITER_H
+
+#include <Arduino.h>
+#include <brotli/include/brotli/encode.h>
+
+#include "MessageCodec.h"
+
+#define BROTLI_WRITER_CHUNK_SIZE 512 // Serialized bytes gathered before they are handed to the encoder.
+#ifndef BROTLI_WRITER_QUALITY
+#define BROTLI_WRITER_QUALITY 7 // Quality of COMPRESSION_BEST. Peak encoder heap, by the benchmark: ~970KB up to 8, ~1.8MB from 9.
+#endif
+#define BROTLI_WRITER_QUALITY_BALANCED 5 // Lowest quality which uses the shared dictionary.
+#define BROTLI_WRITER_QUALITY_FAST 2 // The shared dictionary is only used from quality 5, below that brotli's own is.
+#ifndef BROTLI_WRITER_LGWIN
+#define BROTLI_WRITER_LGWIN 10 // 1KB window, the smallest. Up to 16 the hash tables have a fixed size, whatever the message size.
+#endif
+#define BROTLI_WRITER_INITIAL_CAPACITY 2048 // Initial size of the payload buffer, which doubles as required.
+#define BROTLI_WRITER_ARENA_SIZE (1024 * 1024) // Encoder memory reserved at boot. The benchmark allocates up to ~980KB a message at 5 - 8.
+#define BROTLI_WRITER_FAST_SIZE (560 * 1024) // Encoder memory of COMPRESSION_FAST, up to ~540KB a message in the benchmark.
+
+/**
+ * @brief Writer for ArduinoJson's `serializeJson()` and `serializeMsgPack()` which brotli compresses the document as it is written, and
+ * base64 encodes the compressed stream straight into the payload buffer. The serialized document is never held in full, only one chunk of
+ * it, the encoder's window and the payload. The payload starts with the codec header, then the stream compressed at that level with that
+ * dictionary. At COMPRESSION_STORED no encoder is created, and the document is base64 encoded as it is.
+ *
+ * Once `finish()` succeeds, `release()` hands over the payload buffer, which is then owned by the caller and freed with `free()`.
+ *
+ * The encoder allocates from one arena reserved by `begin()` at boot, so compressing never depends on finding a large free block in a
+ * fragmented heap. Writers take turns with the arena, one at a time, and it is emptied as each is destroyed. Without the arena, the encoder
+ * allocates from the heap.
+ */
+class BrotliWriter {
+    private:
+        static uint8_t* arena;
+        static size_t arena_used;
+        static SemaphoreHandle_t arena_lock;
+        static void* arena_alloc(void* opaque, size_t size);
+        static void arena_free(void* opaque, void* address);
+
+        BrotliEncoderState* encoder = NULL;
+        bool holds_arena = false;
+        uint8_t chunk[BROTLI_WRITER_CHUNK_SIZE];
+        size_t chunk_length = 0;
+        size_t input_length = 0;
+
+        uint8_t group[3]; // Compressed bytes waiting for a complete base64 group.
+        size_t group_length = 0;
+
+        char* payload = nullptr;
+        size_t payload_length = 0;
+        size_t payload_capacity = 0;
+        bool failed = false;
+        MessageCompression compression;
+
+        bool compress(BrotliEncoderOperation operation);
+        void encode(const uint8_t* data, size_t length);
+        void append(const char* quad);
+
+    public:
+        static bool begin();
+        static bool reserved() { return arena != nullptr; }
+        static size_t encoderSize(MessageCompression level);
+
+        BrotliWriter(BrotliEncoderMode mode = BROTLI_MODE_TEXT, MessageCompression compression = COMPRESSION_BEST,
+                     uint8_t dictionary = MESSAGE_DICTIONARY_VERSION);
+        ~BrotliWriter();
+
+        size_t write(uint8_t c);
+        size_t write(const uint8_t* s, size_t n);
+        bool finish();
+        char* release(size_t& length);
+
+        size_t inputLength() { return input_length; }
+        size_t payloadLength() { return payload_length; }
+        MessageCompression level() { return compression; }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef COMPRESSION_POLICY_H
+#define COMPRESSION_POLICY_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "MessageCodec.h"
+
+#define COMPRESSION_STORE_BELOW 128 // Document size below which messages are sent uncompressed, as the encoder costs more than it saves.
+#define COMPRESSION_BEST_FROM 4096 // Document size from which messages, such as reading batches, are compressed at the best level.
+#define COMPRESSION_CPU_BUDGET 0.05f // Share of the time compression may take before messages are compressed at a faster level.
+#define COMPRESSION_DUTY_WINDOW_MS 60000 // Window over which the share of time spent compressing is measured.
+
+/**
+ * @brief Statistics of one compression level over a telemetry period.
+ */
+struct CompressionStats {
+    uint32_t messages = 0;
+    uint32_t input = 0; // Serialized bytes.
+    uint32_t output = 0; // Payload bytes.
+    uint32_t time_us = 0; // Spent serializing and compressing.
+};
+
+/**
+ * @brief Chooses the compression level of each outgoing message from its document's size and the CPU headroom, measured as the share of
+ * recent time spent compressing. Small messages are stored, large ones compressed at the best level, and every level steps down to a
+ * faster one while compression uses more than its budget. If no encoder arena was reserved, levels whose encoder would not fit the
+ * largest free PSRAM block are stepped down too. Keeps per level statistics for telemetry.
+ *
+ * All methods are thread safe.
+ */
+class CompressionPolicy {
+    private:
+        SemaphoreHandle_t lock;
+        CompressionStats stats[MESSAGE_COMPRESSION_LEVELS];
+
+        uint64_t window_start_us = 0;
+        uint64_t window_busy_us = 0;
+        float previous_duty = 0; // Share of the previous window spent compressing.
+
+        float duty(uint64_t now_us);
+
+    public:
+        CompressionPolicy();
+        ~CompressionPolicy();
+
+        MessageCompression choose(size_t document_size);
+        void record(MessageCompression level, size_t input_length, size_t payload_length, uint32_t time_us);
+        void serialize(JsonArray& array);
+};
+
+#endif
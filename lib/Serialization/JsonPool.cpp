@@ -0,0 +1,160 @@
+#include "JsonPool.h"
+
+namespace json_pool {
+static const size_t sizes[JSON_POOL_CLASSES] = JSON_POOL_SIZES;
+static const uint8_t arena_counts[JSON_POOL_CLASSES] = JSON_POOL_ARENAS;
+
+struct Arena {
+    uint8_t* memory;
+    uint8_t size_class;
+    bool borrowed;
+};
+
+static Arena* arenas = nullptr; // Grouped by size class, smallest first.
+static size_t arena_total = 0;
+static JsonPoolStats class_stats[JSON_POOL_CLASSES];
+static SemaphoreHandle_t lock = NULL;
+
+/**
+ * @brief Find the smallest size class which fits a document.
+ *
+ * @param size
+ * @return uint8_t - The class, or JSON_POOL_CLASSES if the document is larger than every class.
+ */
+static uint8_t size_class(size_t size) {
+    uint8_t i = 0;
+    while (i < JSON_POOL_CLASSES && sizes[i] < size) i++;
+    return i;
+}
+
+/**
+ * @brief Allocate the arenas. Call once at startup, before the heap is fragmented. Until then, documents are allocated from the heap.
+ *
+ * @return true - If every arena was allocated.
+ */
+bool begin() {
+    if (arenas != nullptr) return true;
+
+    size_t count = 0;
+    for (uint8_t i = 0; i < JSON_POOL_CLASSES; i++) count += arena_counts[i];
+
+    Arena* allocated = (Arena*) heap_caps_calloc(count, sizeof(Arena), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (allocated == nullptr) return false;
+
+    bool complete = true;
+    size_t index = 0;
+    for (uint8_t i = 0; i < JSON_POOL_CLASSES; i++) {
+        class_stats[i] = JsonPoolStats();
+        class_stats[i].size = sizes[i];
+
+        for (uint8_t j = 0; j < arena_counts[i]; j++) {
+            uint8_t* memory = (uint8_t*) heap_caps_malloc(sizes[i], MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+            if (memory == nullptr) {
+                ESP_LOGE("JsonPool", "Failed to allocate %u byte arena.", sizes[i]);
+                complete = false;
+                continue;
+            }
+
+            allocated[index++] = {memory, i, false};
+            class_stats[i].arenas++;
+        }
+    }
+
+    lock = xSemaphoreCreateMutex();
+    arena_total = index;
+    arenas = allocated;
+    return complete;
+}
+
+/**
+ * @brief Borrow the smallest free arena which fits a document.
+ *
+ * @param size Capacity of the document.
+ * @return void* - The arena, or nullptr if the document must be allocated from the heap.
+ */
+void* acquire(size_t size) {
+    if (arenas == nullptr) return nullptr;
+
+    uint8_t wanted = size_class(size);
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (size_t i = 0; i < arena_total; i++) {
+        Arena& arena = arenas[i];
+        if (arena.borrowed || arena.size_class < wanted) continue;
+
+        arena.borrowed = true;
+        JsonPoolStats& stats = class_stats[arena.size_class];
+        stats.borrows++;
+        stats.in_use++;
+        if (stats.in_use > stats.peak_in_use) stats.peak_in_use = stats.in_use;
+        if (size > stats.peak_request) stats.peak_request = size;
+
+        xSemaphoreGive(lock);
+        return arena.memory;
+    }
+
+    class_stats[min(wanted, (uint8_t) (JSON_POOL_CLASSES - 1))].misses++;
+    xSemaphoreGive(lock);
+    return nullptr;
+}
+
+/**
+ * @brief Return an arena to the pool.
+ *
+ * @param ptr
+ * @return true - If the pointer was an arena, else it belongs to the heap.
+ */
+bool release(void* ptr) {
+    if (arenas == nullptr || ptr == nullptr) return false;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (size_t i = 0; i < arena_total; i++) {
+        if (arenas[i].memory != ptr) continue;
+
+        arenas[i].borrowed = false;
+        class_stats[arenas[i].size_class].in_use--;
+        xSemaphoreGive(lock);
+        return true;
+    }
+
+    xSemaphoreGive(lock);
+    return false;
+}
+
+/**
+ * @brief Get the size of the arena a pointer belongs to.
+ *
+ * @param ptr
+ * @return size_t - The size, or 0 if the pointer is not an arena.
+ */
+size_t arenaSize(void* ptr) {
+    for (size_t i = 0; i < arena_total; i++) {
+        if (arenas[i].memory == ptr) return sizes[arenas[i].size_class];
+    }
+    return 0;
+}
+
+/**
+ * @brief Record how much of a document was used, once it is finished with, to track the high-water mark of its size class.
+ *
+ * @param capacity The document's capacity.
+ * @param usage The document's `memoryUsage()`.
+ */
+void recordUsage(size_t capacity, size_t usage) {
+    if (arenas == nullptr) return;
+
+    uint8_t i = min(size_class(capacity), (uint8_t) (JSON_POOL_CLASSES - 1));
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (usage > class_stats[i].peak_usage) class_stats[i].peak_usage = usage;
+    xSemaphoreGive(lock);
+}
+
+JsonPoolStats stats(uint8_t size_class) {
+    if (arenas == nullptr || size_class >= JSON_POOL_CLASSES) return JsonPoolStats();
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    JsonPoolStats ret = class_stats[size_class];
+    xSemaphoreGive(lock);
+    return ret;
+}
+}
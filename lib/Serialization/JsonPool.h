@@ -0,0 +1,44 @@
+#pragma once
+
+#ifndef JSON_POOL_H
+#define JSON_POOL_H
+
+#include <Arduino.h>
+
+/*
+ * Size classes of the JSON document pool, smallest first, and the number of arenas preallocated for each. Documents up to 16KB are used
+ * for readings and the module list, 8KB for bus health and persisted settings, and commands are sized from the message.
+ */
+#define JSON_POOL_CLASSES 4
+#define JSON_POOL_SIZES {1024, 4096, 8192, 16384}
+#define JSON_POOL_ARENAS {2, 2, 2, 2}
+
+/**
+ * @brief Statistics of one size class of the pool, for tuning the sizes and arena counts.
+ */
+struct JsonPoolStats {
+    size_t size; // Size of each arena.
+    uint8_t arenas;
+    uint8_t in_use;
+    uint8_t peak_in_use; // Most arenas borrowed at once.
+    uint32_t borrows;
+    uint32_t misses; // Documents allocated from the heap instead, as every arena of the class was in use, or none was large enough.
+    size_t peak_request; // Largest document capacity served by the class.
+    size_t peak_usage; // Largest `memoryUsage()` recorded for a document of the class.
+};
+
+/**
+ * @brief Preallocated PSRAM arenas which `DynamicPSRAMJsonDocument` borrows through its allocator and returns on destruction, so that the
+ * large documents created every period do not fragment the heap. A document takes the smallest free arena which fits its capacity, and
+ * falls back to the heap when there is none. Thread safe.
+ */
+namespace json_pool {
+    bool begin();
+    void* acquire(size_t size);
+    bool release(void* ptr);
+    size_t arenaSize(void* ptr);
+    void recordUsage(size_t capacity, size_t usage);
+    JsonPoolStats stats(uint8_t size_class);
+}
+
+#endif
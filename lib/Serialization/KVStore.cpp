@@ -0,0 +1,416 @@
+#include "KVStore.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+#define KV_STORE_READ_CHUNK 256
+
+KVStore::KVStore() {
+    lock = xSemaphoreCreateMutex();
+}
+
+KVStore::~KVStore() {
+    vSemaphoreDelete(lock);
+}
+
+uint32_t KVStore::checksum(const KVRecordHeader& header, const char* key) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*) &header, offsetof(KVRecordHeader, crc));
+    return esp_rom_crc32_le(crc, (const uint8_t*) key, header.key_length);
+}
+
+/**
+ * @brief Replay the log, then compact it if it ends in a torn write, so that new batches are not stranded behind it. An interrupted
+ * compaction leaves the old log in place, so its partial copy is removed.
+ *
+ * @return true - If the store is ready.
+ */
+bool KVStore::begin() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    LittleFS.remove(KV_STORE_COMPACT_PATH);
+
+    size_t valid_end = 0;
+    bool success = true;
+    if (!replay(valid_end)) {
+        ESP_LOGW("KVStore", "Log ends in a torn write at %u of %u bytes, compacting.", valid_end, log_size);
+        success = compact();
+    }
+
+    xSemaphoreGive(lock);
+    ESP_LOGI("KVStore", "%u keys, %u of %u bytes live.", index.size(), live_size, log_size);
+    return success;
+}
+
+/**
+ * @brief Rebuild the index from the log. The records of a batch are held back until its commit record is read, and the replay stops at the
+ * first record which is incomplete or fails its checksum.
+ *
+ * @param valid_end Set to the end of the last complete batch.
+ * @return true - If the log holds nothing but complete batches.
+ */
+bool KVStore::replay(size_t& valid_end) {
+    struct Pending {
+        ps::string key;
+        KVRecordType type;
+        KVEntry entry;
+    };
+
+    index.clear();
+    live_size = 0;
+    log_size = 0;
+    sequence = 0;
+    valid_end = 0;
+
+    auto file = LittleFS.open(KV_STORE_PATH, FILE_READ);
+    if (!file) return true; // Nothing saved yet.
+
+    log_size = file.size();
+    ps::vector<Pending> batch;
+    uint32_t batch_sequence = 0;
+    size_t offset = 0;
+    uint8_t buffer[KV_STORE_READ_CHUNK];
+
+    while (offset + sizeof(KVRecordHeader) <= log_size) {
+        KVRecordHeader header;
+        char key[KV_STORE_MAX_KEY_LENGTH];
+        if (file.read((uint8_t*) &header, sizeof(header)) != sizeof(header) || header.magic != KV_RECORD_MAGIC) break;
+        if (file.read((uint8_t*) key, header.key_length) != header.key_length || header.crc != checksum(header, key)) break;
+
+        if (batch.empty()) batch_sequence = header.sequence;
+        else if (header.sequence != batch_sequence) break; // The previous batch was never committed.
+
+        size_t value_offset = offset + sizeof(header) + header.key_length;
+        if (header.type == KV_RECORD_COMMIT) {
+            if (header.value_length != batch.size()) break;
+
+            for (auto& pending : batch) {
+                auto found = index.find(pending.key);
+                if (found != index.end()) {
+                    live_size -= record_size(pending.key.size(), found -> second.length);
+                    index.erase(found);
+                }
+                if (pending.type == KV_RECORD_DELETE) continue;
+
+                index[pending.key] = pending.entry;
+                live_size += record_size(pending.key.size(), pending.entry.length);
+            }
+
+            sequence = header.sequence;
+            batch.clear();
+            offset = value_offset;
+            valid_end = offset;
+            continue;
+        }
+
+        if (header.value_length > log_size - value_offset) break;
+
+        uint32_t crc = 0;
+        size_t read = 0;
+        while (read < header.value_length) {
+            size_t length = min((size_t) KV_STORE_READ_CHUNK, (size_t) header.value_length - read);
+            if (file.read(buffer, length) != length) break;
+            crc = esp_rom_crc32_le(crc, buffer, length);
+            read += length;
+        }
+        if (read != header.value_length || crc != header.value_crc) break;
+
+        batch.push_back({ps::string(key, header.key_length), (KVRecordType) header.type, {(uint32_t) value_offset, header.value_length, crc}});
+        offset = value_offset + header.value_length;
+    }
+
+    file.close();
+    return valid_end == log_size;
+}
+
+/**
+ * @brief Append a record to the log.
+ *
+ * @param file Log opened for appending.
+ * @param batch Sequence of the batch the record belongs to.
+ * @param type
+ * @param key
+ * @param value
+ * @param length For commit records, the number of records in the batch.
+ * @param value_crc
+ * @return true - If the whole record was written.
+ */
+bool KVStore::append(File& file, uint32_t batch, KVRecordType type, const ps::string& key, const char* value, size_t length, uint32_t value_crc) {
+    KVRecordHeader header = {KV_RECORD_MAGIC, batch, (uint32_t) length, value_crc, type, (uint8_t) key.size(), 0};
+    header.crc = checksum(header, key.c_str());
+
+    size_t value_length = (type == KV_RECORD_PUT) ? length : 0;
+    return file.write((const uint8_t*) &header, sizeof(header)) == sizeof(header) &&
+           file.write((const uint8_t*) key.c_str(), key.size()) == key.size() &&
+           file.write((const uint8_t*) value, value_length) == value_length;
+}
+
+/**
+ * @brief Read a value from the log.
+ *
+ * @param file Log opened for reading.
+ * @param entry
+ * @param value
+ * @return true - If the value was read and matches its checksum.
+ */
+bool KVStore::read_value(File& file, const KVEntry& entry, ps::string& value) {
+    value.resize(entry.length);
+    if (!file.seek(entry.offset) || file.read((uint8_t*) &value[0], entry.length) != entry.length) return false;
+    return esp_rom_crc32_le(0, (const uint8_t*) value.c_str(), value.size()) == entry.crc;
+}
+
+/**
+ * @brief Copy the live records to a new log as one batch, then rename it over the old log, which stays in place until the copy is complete.
+ * Call with the lock held.
+ *
+ * @return true - If the log was compacted.
+ */
+bool KVStore::compact() {
+    auto source = LittleFS.open(KV_STORE_PATH, FILE_READ);
+    auto target = LittleFS.open(KV_STORE_COMPACT_PATH, FILE_WRITE, true);
+    if (!target) {
+        ESP_LOGE("KVStore", "Failed to open %s.", KV_STORE_COMPACT_PATH);
+        if (source) source.close();
+        return false;
+    }
+
+    ps::unordered_map<ps::string, KVEntry> compacted;
+    uint32_t batch = sequence + 1;
+    size_t offset = 0;
+    bool success = true;
+    ps::string value;
+
+    for (auto& entry : index) {
+        if (!source || !read_value(source, entry.second, value)) {
+            ESP_LOGE("KVStore", "Dropping unreadable value of %s.", entry.first.c_str());
+            continue;
+        }
+
+        success = success && append(target, batch, KV_RECORD_PUT, entry.first, value.c_str(), value.size(), entry.second.crc);
+        compacted[entry.first] = {(uint32_t) (offset + sizeof(KVRecordHeader) + entry.first.size()), entry.second.length, entry.second.crc};
+        offset += record_size(entry.first.size(), value.size());
+    }
+
+    success = success && append(target, batch, KV_RECORD_COMMIT, "", nullptr, compacted.size(), 0);
+    offset += sizeof(KVRecordHeader);
+    target.close();
+    if (source) source.close();
+
+    if (!success || !LittleFS.rename(KV_STORE_COMPACT_PATH, KV_STORE_PATH)) {
+        ESP_LOGE("KVStore", "Compaction failed.");
+        LittleFS.remove(KV_STORE_COMPACT_PATH);
+        return false;
+    }
+
+    ESP_LOGI("KVStore", "Compacted log from %u to %u bytes.", log_size, offset);
+    index = std::move(compacted);
+    live_size = offset - sizeof(KVRecordHeader);
+    log_size = offset;
+    sequence = batch;
+    torn = false;
+    return true;
+}
+
+/**
+ * @brief Get a value, including changes staged but not yet committed.
+ *
+ * @param key
+ * @param value
+ * @return true - If the key exists and its value could be read.
+ */
+bool KVStore::get(const ps::string& key, ps::string& value) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (auto it = staged.rbegin(); it != staged.rend(); it++) {
+        if (it -> key != key) continue;
+
+        bool found = it -> type == KV_RECORD_PUT;
+        if (found) value = it -> value;
+        xSemaphoreGive(lock);
+        return found;
+    }
+
+    auto entry = index.find(key);
+    if (entry == index.end()) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    auto file = LittleFS.open(KV_STORE_PATH, FILE_READ);
+    bool success = file && read_value(file, entry -> second, value);
+    if (file) file.close();
+    xSemaphoreGive(lock);
+
+    if (!success) ESP_LOGE("KVStore", "Failed to read %s.", key.c_str());
+    return success;
+}
+
+bool KVStore::contains(const ps::string& key) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    bool found = index.find(key) != index.end();
+    for (auto& change : staged) {
+        if (change.key == key) found = change.type == KV_RECORD_PUT;
+    }
+
+    xSemaphoreGive(lock);
+    return found;
+}
+
+/**
+ * @brief List the keys starting with a prefix, including changes staged but not yet committed.
+ *
+ * @param prefix
+ * @return ps::vector<ps::string>
+ */
+ps::vector<ps::string> KVStore::keys(const ps::string& prefix) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    ps::unordered_map<ps::string, bool> present;
+    for (auto& entry : index) {
+        if (entry.first.compare(0, prefix.size(), prefix) == 0) present[entry.first] = true;
+    }
+    for (auto& change : staged) {
+        if (change.key.compare(0, prefix.size(), prefix) == 0) present[change.key] = change.type == KV_RECORD_PUT;
+    }
+
+    xSemaphoreGive(lock);
+
+    ps::vector<ps::string> ret;
+    for (auto& key : present) {
+        if (key.second) ret.push_back(key.first);
+    }
+    return ret;
+}
+
+/**
+ * @brief Stage a value, to be written by the next `commit()`. Values which are already stored are left out.
+ *
+ * @param key At most KV_STORE_MAX_KEY_LENGTH characters.
+ * @param value
+ */
+void KVStore::put(const ps::string& key, const ps::string& value) {
+    if (key.size() > KV_STORE_MAX_KEY_LENGTH) {
+        ESP_LOGE("KVStore", "Key %s is too long.", key.c_str());
+        return;
+    }
+
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*) value.c_str(), value.size());
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (auto it = staged.begin(); it != staged.end();) it = (it -> key == key) ? staged.erase(it) : it + 1;
+
+    auto entry = index.find(key);
+    bool unchanged = entry != index.end() && entry -> second.length == value.size() && entry -> second.crc == crc;
+    if (!unchanged) staged.push_back({key, value, KV_RECORD_PUT});
+
+    xSemaphoreGive(lock);
+}
+
+/**
+ * @brief Stage the removal of a key, to be written by the next `commit()`.
+ *
+ * @param key
+ */
+void KVStore::remove(const ps::string& key) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (auto it = staged.begin(); it != staged.end();) it = (it -> key == key) ? staged.erase(it) : it + 1;
+    if (index.find(key) != index.end()) staged.push_back({key, "", KV_RECORD_DELETE});
+
+    xSemaphoreGive(lock);
+}
+
+/**
+ * @brief Append the staged changes to the log as one batch. A failed write leaves the log with a torn tail, so the log is compacted before
+ * anything else is appended, and the changes stay staged for the next attempt.
+ *
+ * @return true - If the changes are on flash.
+ */
+bool KVStore::commit() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    if (staged.empty()) {
+        xSemaphoreGive(lock);
+        return true;
+    }
+
+    if (torn && !compact()) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    auto file = LittleFS.open(KV_STORE_PATH, FILE_APPEND, true);
+    if (!file) {
+        ESP_LOGE("KVStore", "Failed to open %s.", KV_STORE_PATH);
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    uint32_t batch = sequence + 1;
+    size_t offset = log_size;
+    ps::vector<KVEntry> entries;
+    bool success = true;
+
+    for (auto& change : staged) {
+        uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*) change.value.c_str(), change.value.size());
+        success = success && append(file, batch, change.type, change.key, change.value.c_str(), change.value.size(), crc);
+        entries.push_back({(uint32_t) (offset + sizeof(KVRecordHeader) + change.key.size()), (uint32_t) change.value.size(), crc});
+        offset += record_size(change.key.size(), change.value.size());
+    }
+
+    success = success && append(file, batch, KV_RECORD_COMMIT, "", nullptr, staged.size(), 0);
+    offset += sizeof(KVRecordHeader);
+    file.close();
+
+    if (!success) {
+        ESP_LOGE("KVStore", "Failed to write %u changes.", staged.size());
+        torn = true;
+        compact();
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    for (size_t i = 0; i < staged.size(); i++) {
+        auto found = index.find(staged[i].key);
+        if (found != index.end()) {
+            live_size -= record_size(found -> first.size(), found -> second.length);
+            index.erase(found);
+        }
+        if (staged[i].type == KV_RECORD_DELETE) continue;
+
+        index[staged[i].key] = entries[i];
+        live_size += record_size(staged[i].key.size(), entries[i].length);
+    }
+
+    ESP_LOGD("KVStore", "Committed %u changes in %u bytes.", staged.size(), offset - log_size);
+    staged.clear();
+    log_size = offset;
+    sequence = batch;
+
+    if (log_size > KV_STORE_COMPACT_MIN_SIZE && log_size > KV_STORE_COMPACT_RATIO * live_size) compact();
+
+    xSemaphoreGive(lock);
+    return true;
+}
+
+/**
+ * @brief Remove every key, and the log.
+ */
+void KVStore::clear() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    LittleFS.remove(KV_STORE_PATH);
+    LittleFS.remove(KV_STORE_COMPACT_PATH);
+    index.clear();
+    staged.clear();
+    live_size = 0;
+    log_size = 0;
+    torn = false;
+
+    xSemaphoreGive(lock);
+}
+
+size_t KVStore::size() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    size_t ret = index.size();
+    xSemaphoreGive(lock);
+    return ret;
+}
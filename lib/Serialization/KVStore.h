@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef KV_STORE_H
+#define KV_STORE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ps_stl.h>
+
+#define KV_STORE_PATH "/store.log"
+#define KV_STORE_COMPACT_PATH "/store.tmp" // The compacted log is written here, then renamed over the log.
+#define KV_STORE_COMPACT_MIN_SIZE (32 * 1024) // Log size below which the log is never compacted.
+#define KV_STORE_COMPACT_RATIO 2 // The log is compacted once it is this many times the size of the live records.
+#define KV_STORE_MAX_KEY_LENGTH 255
+#define KV_RECORD_MAGIC 0x4B565231 // "KVR1"
+
+enum KVRecordType : uint8_t {
+    KV_RECORD_PUT = 0,
+    KV_RECORD_DELETE = 1,
+    KV_RECORD_COMMIT = 2 // Ends a batch. Its value length is the number of records in the batch.
+};
+
+struct KVRecordHeader {
+    uint32_t magic;
+    uint32_t sequence; // Batch the record belongs to.
+    uint32_t value_length;
+    uint32_t value_crc;
+    uint8_t type;
+    uint8_t key_length;
+    uint32_t crc; // Of the fields above and the key.
+} __attribute__ ((packed));
+
+/**
+ * @brief Location of a key's current value in the log.
+ */
+struct KVEntry {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t crc;
+};
+
+/**
+ * @brief Log-structured key/value store on LittleFS, holding one record per module, rule set or schedule entry, so that a change to one is
+ * saved by appending only its record rather than rewriting every setting.
+ *
+ * `put()` and `remove()` stage changes in RAM, leaving out values which are unchanged, and `commit()` appends them to the log as one batch
+ * closed by a commit record. On `begin()` the log is replayed, and a batch only takes effect once its commit record is read back intact, so
+ * a reset part way through a commit loses the whole batch and never half of it. Values stay on flash, only their location is held in RAM.
+ * Once superseded records outweigh the live ones, the live records are copied to a new log which is renamed over the old one.
+ *
+ * All methods are thread safe.
+ *
+ * @note Expects the filesystem to be mounted before `begin()`.
+ */
+class KVStore {
+    private:
+        struct Staged {
+            ps::string key;
+            ps::string value;
+            KVRecordType type;
+        };
+
+        SemaphoreHandle_t lock;
+        ps::unordered_map<ps::string, KVEntry> index;
+        ps::vector<Staged> staged;
+        uint32_t sequence = 0; // Of the last batch committed.
+        size_t log_size = 0;
+        size_t live_size = 0; // Bytes of the records holding current values.
+        bool torn = false; // A commit failed part way, so the log must be compacted before it is appended to.
+
+        static uint32_t checksum(const KVRecordHeader& header, const char* key);
+        static size_t record_size(size_t key_length, size_t length) { return sizeof(KVRecordHeader) + key_length + length; }
+        bool replay(size_t& valid_end);
+        bool append(File& file, uint32_t batch, KVRecordType type, const ps::string& key, const char* value, size_t length, uint32_t value_crc);
+        bool read_value(File& file, const KVEntry& entry, ps::string& value);
+        bool compact();
+
+    public:
+        KVStore();
+        ~KVStore();
+
+        bool begin();
+        bool get(const ps::string& key, ps::string& value);
+        bool contains(const ps::string& key);
+        ps::vector<ps::string> keys(const ps::string& prefix = "");
+
+        void put(const ps::string& key, const ps::string& value);
+        void remove(const ps::string& key);
+        bool commit();
+        void clear();
+
+        size_t size();
+};
+
+#endif
@@ -1,26 +1,22 @@
 #include "MQTTClient.h"
 #include <strings.h>
-#include <esp_brotli.h>
-
-struct CallbackQueueItem { // The structure of the compressed messages from the PubSubClient callback.
-    char* topic;
-    char* payload;
-    uint32_t length;
-};
+#include <lwip/sockets.h>
+#include "MessageCodec.h"
 
 struct IncomingMessage { // Structure of messages provided by the task after decompression.
     char* topic;
-    char* message;
+    char* message; // Decompressed message, owned by whoever takes it off the queue.
+    size_t length;
 };
 
 struct OutgoingMessage { // Structure of messages added to the task send queue.
     size_t topic_number;
-    char* message;
+    char* message; // Compressed and base64 encoded payload.
+    size_t length;
 };
 
-QueueHandle_t callback_queue; // Queue for message ingestion.
-
 void communicationTask(void* parent);
+void socketWatchTask(void* parent);
 
 /**
  * ==============================================
@@ -30,20 +26,22 @@ void communicationTask(void* parent);
  * ==============================================
  */
 
-MQTTClient::MQTTClient(Client& connection) : conn_client(connection) {
+MQTTClient::MQTTClient(WiFiClient& connection) : conn_client(connection) {
     incoming_messages_queue = xQueueCreate(5, sizeof(IncomingMessage));
     outgoing_messages_queue = xQueueCreate(5, sizeof(OutgoingMessage));
+    events = xEventGroupCreate();
 }
 
 MQTTClient::~MQTTClient() {
+    if (watch_task_handle != NULL) vTaskDelete(watch_task_handle);
     vTaskDelete(task_handle);
     vQueueDelete(incoming_messages_queue);
     vQueueDelete(outgoing_messages_queue);
-    vQueueDelete(callback_queue);
+    vEventGroupDelete(events);
 }
 
 /**
- * @brief Creates the RTOS task for the MQTT client.
+ * @brief Creates the RTOS tasks for the MQTT client: the communication task, and the task which wakes it when the broker sends data.
  * 
  * @return true 
  * @return false 
@@ -52,32 +50,47 @@ bool MQTTClient::begin(const char* clientid, const char* token) {
     client_id = ps::string(clientid);
     auth_token = ps::string(token);
 
-    return xTaskCreate(
+    if (xTaskCreate(
         communicationTask,
         "Communication Task",
         64 * 1024,
         this,
         2,
         &task_handle
+    ) != pdTRUE) return false;
+
+    return xTaskCreate(
+        socketWatchTask,
+        "Socket Watch Task",
+        3 * 1024,
+        this,
+        2,
+        &watch_task_handle
     ) == pdTRUE;
 }
 
 /**
- * @brief Connect to the MQTT Broker. Blocks until connection is successful, checking every 5 seconds.
+ * @brief Attempt to connect to the MQTT Broker, and subscribe to the topics in the ACL once connected. Attempts are made at most every
+ * MQTT_RECONNECT_INTERVAL_MS, so that messages keep being stored in the outbox while the broker is unreachable.
  * 
+ * @return true - If connected.
  */
-void MQTTClient::connect() {
-    while (! mqtt_client -> connected()) {
-    ESP_LOGE("MQTT", "Attempting to connect...");
-
-    // Attempt to connect
-    if (mqtt_client -> connect(client_id.c_str(), auth_token.c_str(), "0")) { // No password for JWT authentication.
-        ESP_LOGI("MQTT", "Connected.");
-    } else {
+bool MQTTClient::connect() {
+    if (millis() - last_connect_attempt < MQTT_RECONNECT_INTERVAL_MS && last_connect_attempt != 0) return false;
+    last_connect_attempt = millis();
+    socket_fd = -1;
+
+    ESP_LOGI("MQTT", "Attempting to connect...");
+    if (!mqtt_client -> connect(client_id.c_str(), auth_token.c_str(), "0")) { // No password for JWT authentication.
         ESP_LOGE("MQTT", "Failed to connect to broker, state: %d.", mqtt_client -> state());
-        vTaskDelay(5000 / portTICK_PERIOD_MS);
+        return false;
     }
-}
+
+    ESP_LOGI("MQTT", "Connected.");
+    for (auto topic : subscribe_topics) mqtt_client -> subscribe(topic.c_str()); // Sessions are clean, so subscribe every time.
+
+    socket_fd = conn_client.fd();
+    return true;
 }
 
 /**
@@ -85,31 +98,49 @@ void MQTTClient::connect() {
  * 
  * @param topic_number - The number of the topic to publish to when the class goes out of scope.
  * @param size - The size of the underlying JSON document.
+ * @param encoding - How the document is written before compression.
  * @return std::shared_ptr<MessageSerializer> 
  */
-std::shared_ptr<MessageSerializer> MQTTClient::createMessage(size_t topic_number,size_t size) {
-    return ps::make_shared<MessageSerializer>(MQTTClient::shared_from_this(), topic_number, size);
+std::shared_ptr<MessageSerializer> MQTTClient::createMessage(size_t topic_number,size_t size, MessageEncoding encoding) {
+    return ps::make_shared<MessageSerializer>(MQTTClient::shared_from_this(), topic_number, size, encoding);
 }
 
 /**
- * @brief Put a message on the send queue.
+ * @brief Put a compressed message on the send queue. The queue takes ownership of the writer's payload buffer, so it is not copied.
  * 
- * @param message 
+ * @param message A finished writer.
  */
-void MQTTClient::send_message(size_t topic, ps::string message) {
-    char* str = (char*) heap_caps_calloc(message.size() + 1, sizeof(char), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-    memccpy(str, message.c_str(), 0, message.size());
+void MQTTClient::send_message(size_t topic, BrotliWriter& message) {
+    OutgoingMessage new_message;
+    new_message.topic_number = topic;
+    new_message.message = message.release(new_message.length);
+    if (new_message.message == nullptr) return;
 
-    ESP_LOGV("MQTT", "Added message to send queue: %s", str);
+    ESP_LOGV("MQTT", "Added %u byte message to send queue.", new_message.length);
 
-    OutgoingMessage new_message = {
-        topic,
-        str
-    };
+    if (xQueueSendToBack(outgoing_messages_queue, &new_message, 250 / portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW("MQTT", "Send queue full, storing message in outbox.");
+        if (!outbox.push(topic, new_message.message, new_message.length)) ESP_LOGE("MQTT", "Failed to store message.");
+        free(new_message.message);
+        return;
+    }
 
-    if (xQueueSendToBack(outgoing_messages_queue, &new_message, 250 / portTICK_PERIOD_MS) != pdTRUE) ESP_LOGE("MQTT", "Failed to place message on send queue.");
+    xEventGroupSetBits(events, COMMS_EVENT_OUTGOING);
+}
 
-    return;
+/**
+ * @brief Publish a payload, writing it straight to the connection rather than through the PubSubClient buffer, so payloads are not
+ * copied again or limited by the buffer size.
+ * 
+ * @param topic Topic number.
+ * @param payload 
+ * @param length 
+ * @return true - If published.
+ */
+bool MQTTClient::publish(size_t topic, const char* payload, size_t length) {
+    if (!mqtt_client -> beginPublish(publish_topics.at(topic).c_str(), length, false)) return false;
+    if (mqtt_client -> write((const uint8_t*) payload, length) != length) return false;
+    return mqtt_client -> endPublish();
 }
 
 /**
@@ -130,15 +161,11 @@ std::shared_ptr<MessageDeserializer> MQTTClient::getMessage() {
     IncomingMessage new_message;
 
     if (xQueueReceive(incoming_messages_queue, &new_message, 50 / portTICK_PERIOD_MS) != pdTRUE) {
-        free(new_message.topic);
-        free(new_message.message);
         return std::shared_ptr<MessageDeserializer>();
     }
-    ps::string new_string = new_message.message;
-    auto ret = ps::make_shared<MessageDeserializer>(new_message.topic, new_message.message);
 
+    auto ret = ps::make_shared<MessageDeserializer>(new_message.topic, new_message.message, new_message.length); // Takes the message.
     free(new_message.topic);
-    free(new_message.message);
 
     return ret;
 }
@@ -236,18 +263,35 @@ void MQTTClient::decode_token() {
  * 
  * @param client 
  * @param json_document_size 
+ * @param encoding JSON text, or MessagePack.
  */
-MessageSerializer::MessageSerializer(std::shared_ptr<MQTTClient> client, size_t topic_number, size_t json_document_size) :
+MessageSerializer::MessageSerializer(std::shared_ptr<MQTTClient> client, size_t topic_number, size_t json_document_size, MessageEncoding encoding) :
     mqtt_client(client),
-    document(DynamicPSRAMJsonDocument(json_document_size)),
-    topic(topic_number)
+    topic(topic_number),
+    encoding(encoding),
+    document(DynamicPSRAMJsonDocument(json_document_size))
 {
 }
 
 MessageSerializer::~MessageSerializer() {
-    ps::ostringstream message;
-    serializeJson(document, message);
-    mqtt_client->send_message(topic, message.str());
+    json_pool::recordUsage(document.capacity(), document.memoryUsage());
+    uint64_t start_us = micros();
+
+    MessageCompression level = mqtt_client -> compression.choose(document.memoryUsage());
+    BrotliWriter message((encoding == ENCODING_MSGPACK) ? BROTLI_MODE_GENERIC : BROTLI_MODE_TEXT, level);
+
+    if (encoding == ENCODING_MSGPACK) serializeMsgPack(document, message);
+    else serializeJson(document, message);
+
+    if (!message.finish()) {
+        ESP_LOGE("MQTT", "Failed to compress message.");
+        return;
+    }
+
+    uint32_t elapsed_us = micros() - start_us;
+    mqtt_client -> compression.record(level, message.inputLength(), message.payloadLength(), elapsed_us);
+    ESP_LOGV("MQTT", "Compressed %u bytes to %u at level %u. [Took %uus]", message.inputLength(), message.payloadLength(), level, elapsed_us);
+    mqtt_client->send_message(topic, message);
 }
 
 /**
@@ -258,21 +302,52 @@ MessageSerializer::~MessageSerializer() {
  * ==============================================
  */
 
-MessageDeserializer::MessageDeserializer(const char* topic,const char* message) : document(DynamicPSRAMJsonDocument(JSON_DOCUMENT_SIZE)) {
-    uint64_t start_time = millis();
+/**
+ * @brief Take ownership of a decompressed message and deserialize it in place. ArduinoJson's zero-copy mode points the document's strings
+ * into the message rather than copying them, so the document only needs room for its nodes, which is sized from the message.
+ * 
+ * @param topic 
+ * @param message NUL terminated message, freed with the deserializer. May be nullptr.
+ * @param length 
+ */
+MessageDeserializer::MessageDeserializer(const char* topic, char* message, size_t length) :
+    message(message),
+    topic(topic),
+    document(DynamicPSRAMJsonDocument(capacity(message, length)))
+{
+    if (message == nullptr) return;
+    uint64_t start_time = micros();
 
-    MessageDeserializer::topic = ps::string(topic);
-    MessageDeserializer::message = ps::string(message);
-    
-    auto result = deserializeJson(document, &message[0]);
+    ESP_LOGV("MQTT", "Incoming message on topic: %s", topic);
+    ESP_LOGV("MQTT", "Incoming message: %s", message);
+
+    auto result = deserializeJson(document, message, length);
     if (result != DeserializationError::Ok) {
-        ESP_LOGE("MQTT", "Deserialization Error: %d", result);
+        ESP_LOGE("MQTT", "Deserialization Error: %s", result.c_str());
     }
 
-    start_time = millis() - start_time;
-    ESP_LOGV("MQTT", "Incoming message on topic: %s", MessageDeserializer::topic.c_str());
-    ESP_LOGV("MQTT", "Incoming message: %s", MessageDeserializer::message.c_str());
-    ESP_LOGV("MQTT", "Deserialized JSON. [Took %uus]", start_time);
+    ESP_LOGV("MQTT", "Deserialized %u bytes into %u byte document. [Took %uus]", length, document.capacity(), micros() - start_time);
+}
+
+MessageDeserializer::~MessageDeserializer() {
+    json_pool::recordUsage(document.capacity(), document.memoryUsage());
+    free(message);
+}
+
+/**
+ * @brief Upper bound on the document capacity for a message. Every array element and object member is preceded by a ',', '[' or '{'.
+ * 
+ * @param message 
+ * @param length 
+ * @return size_t 
+ */
+size_t MessageDeserializer::capacity(const char* message, size_t length) {
+    size_t slots = 1;
+    for (size_t i = 0; i < length; i++) {
+        char c = message[i];
+        if (c == ',' || c == '[' || c == '{') slots++;
+    }
+    return JSON_ARRAY_SIZE(slots);
 }
 
 
@@ -284,9 +359,7 @@ MessageDeserializer::MessageDeserializer(const char* topic,const char* message)
  * ==============================================
  */
 
-ps::string get_message_payload(CallbackQueueItem& message);
-ps::string compress_message(OutgoingMessage& message);
-void mqtt_callback(char* topic, uint8_t* payload, uint32_t length);
+void deliver_message(MQTTClient* client, char* topic, char* payload, size_t length);
 
 /**
  * @brief RTOS task for the MQTTClient class which handles the MQTT publish & subscribe, as well as compresssion & decompression.
@@ -298,72 +371,76 @@ void communicationTask(void* parent) {
 
     MQTTClient* client = (MQTTClient*) parent;
 
-    callback_queue = xQueueCreate(5, sizeof(CallbackQueueItem));
-
     // Fetch broker and topic details from token.
     client -> decode_token();
 
     // Initialize the MQTT Client
     client -> mqtt_client = ps::make_shared<PubSubClient>();
     client -> mqtt_client -> setClient(client -> conn_client);
-    client -> mqtt_client -> setCallback(mqtt_callback);
+    client -> mqtt_client -> setCallback([client](char* topic, uint8_t* payload, unsigned int length) {
+        deliver_message(client, topic, (char*) payload, length);
+    });
     client -> mqtt_client -> setBufferSize(16384);
     client -> mqtt_client -> setServer(client -> broker_url.c_str(), client -> broker_port);
 
+    // Messages stored while the broker was unreachable, possibly before a restart.
+    client -> outbox.begin();
+
     // Connect to the Broker.
     client -> connect();
 
-    ESP_LOGI("MQTT", "Decoding JWT for ACL...");
-
-    // Subscribe to topics as per ACL.
-    for (auto topic : client -> subscribe_topics) {
-        client -> mqtt_client -> subscribe(topic.c_str());
-    }
-
     // Buffers to store messages from queues.
 
-    IncomingMessage incoming_message;
     OutgoingMessage outgoing_message;
-    CallbackQueueItem compressed_message;
-
-    uint64_t elapsed_tm = 0;
+    uint8_t stored_topic;
+    ps::string stored_message;
+    uint32_t stored_token;
+    uint64_t last_drain = 0;
 
     while(1) {
-        elapsed_tm = millis();
-
-        // Check that we are still connected to the broker, else block until we are.
-        if (!client -> mqtt_client -> connected()) client -> connect();
-
-        // Check for messages to send.
-        if (xQueueReceive(client -> outgoing_messages_queue, &outgoing_message, 50 / portTICK_PERIOD_MS) == pdTRUE ) {
-            // Compress the message, then publish it to the topic.
-            uint64_t start_tm = millis();
-            auto message = compress_message(outgoing_message);
-            ESP_LOGV("MQTT", "Sending Message: %s", message.c_str());
-            if (!client -> mqtt_client -> publish(client -> publish_topics.at(outgoing_message.topic_number).c_str(), message.c_str())) ESP_LOGE("MQTT", "Failed to publish message.");
-            ESP_LOGV("MQTT", "Compression took %ums.", millis() - start_tm);
+        // Sleep until there is something to do, a keepalive may be due, stored messages can be drained or a reconnection attempted.
+        bool connected = client -> mqtt_client -> connected();
+        uint32_t idle_ms = !connected ? MQTT_RECONNECT_INTERVAL_MS : client -> outbox.empty() ? COMMS_KEEPALIVE_MS : OUTBOX_DRAIN_INTERVAL_MS;
+        EventBits_t pending = xEventGroupWaitBits(client -> events, COMMS_EVENT_OUTGOING | COMMS_EVENT_SOCKET, pdTRUE, pdFALSE, idle_ms / portTICK_PERIOD_MS);
+        uint64_t elapsed_tm = millis();
+
+        // Check that we are still connected to the broker, else try to reconnect.
+        connected = client -> mqtt_client -> connected() || client -> connect();
+
+        // Send every queued message. They are already compressed. Whatever cannot be sent is stored.
+        while (xQueueReceive(client -> outgoing_messages_queue, &outgoing_message, 0) == pdTRUE) {
+            ESP_LOGV("MQTT", "Sending Message: %s", outgoing_message.message);
+            if (!connected || !client -> publish(outgoing_message.topic_number, outgoing_message.message, outgoing_message.length)) {
+                ESP_LOGW("MQTT", "Failed to publish message, storing it in outbox.");
+                if (!client -> outbox.push(outgoing_message.topic_number, outgoing_message.message, outgoing_message.length)) ESP_LOGE("MQTT", "Failed to store message.");
+            }
+            free(outgoing_message.message);
         }
 
-        // Service MQTT client.
-        client -> mqtt_client -> loop();
-
-        // Check for received messages.
-        if (xQueueReceive(callback_queue, &compressed_message, 50 / portTICK_PERIOD_MS) == pdTRUE ) {
-            // Decompress the message, and then copy it to a new buffer, then send to the incoming message queue.
-            uint64_t start_tm = millis();
-            ps::string payload = get_message_payload(compressed_message);
-
-            // Copy string to RAM and put pointer on queue.
-            incoming_message.message = (char*) heap_caps_calloc(payload.size() + 1, sizeof(char), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-            incoming_message.topic = compressed_message.topic;
-            memccpy(incoming_message.message, payload.c_str(), 0, payload.size());
-            ESP_LOGV("MQTT", "Decompression took %ums.", millis() - start_tm);
-            xQueueSendToBack(client -> incoming_messages_queue, &incoming_message, portMAX_DELAY);
+        if (connected) {
+            // Drain stored messages at a limited rate, so that a backlog does not flood the broker or starve new messages.
+            if (millis() - last_drain >= OUTBOX_DRAIN_INTERVAL_MS) {
+                last_drain = millis();
+                for (int i = 0; i < OUTBOX_DRAIN_BATCH && client -> outbox.front(stored_topic, stored_message, stored_token); i++) {
+                    if (!client -> publish(stored_topic, stored_message.data(), stored_message.size())) break;
+                    client -> outbox.pop(stored_token);
+                }
+            }
+
+            // Service the MQTT client until everything received has been read. It reads one packet per call, delivering any message
+            // through the callback, and sends pings when due.
+            do {
+                client -> mqtt_client -> loop();
+            } while (client -> mqtt_client -> connected() && client -> conn_client.available() > 0);
         }
 
-        elapsed_tm = millis() - elapsed_tm;
-        ESP_LOGV("RTOS", "Comms task looped, took %ums", elapsed_tm);
-        vTaskDelay((1000 - elapsed_tm) / portTICK_PERIOD_MS );
+        // Write stored messages to flash once enough have gathered.
+        client -> outbox.flush();
+
+        // Let the watch task wait for more data, now that what it signalled has been read.
+        if (pending & COMMS_EVENT_SOCKET) xTaskNotifyGive(client -> watch_task_handle);
+
+        ESP_LOGV("RTOS", "Comms task handled events 0x%x, took %ums", pending, millis() - elapsed_tm);
     }
 
     ESP_LOGE("RTOS", "Communication task escaped loop.");
@@ -371,52 +448,61 @@ void communicationTask(void* parent) {
 }
 
 /**
- * @brief Get the message payload from the callback queue item. Decompresses it. Returns the data if successful, else an empty string if failed.
- *  Frees the memory after conversion to ps::string.
- * @param message 
- * @return ps::string - Decompressed message payload.
+ * @brief RTOS task which waits for the broker connection to become readable, and wakes the communication task. It then waits until the
+ * communication task has read the data, as the socket stays readable until then.
+ * 
+ * @param parent 
  */
-ps::string get_message_payload(CallbackQueueItem& message) {
-    ps::string str = message.payload;
-    free(message.payload);
-    ESP_LOGI("MQTT", "Decompress message: %s", str.c_str());
-    return brotli::decompress(str);
-}
+void socketWatchTask(void* parent) {
+    MQTTClient* client = (MQTTClient*) parent;
 
-/**
- * @brief Compresses a message with brotli, then returns the string ready to be published.
- * Frees the memory after conversion to ps::string.
- * @param message 
- * @return ps::string - Empty if failed.
- */
-ps::string compress_message(OutgoingMessage& message) {
-    ps::string buffer = message.message;
-    free(message.message);
+    while(1) {
+        int fd = client -> socket_fd;
+        if (fd < 0) {
+            vTaskDelay(COMMS_WATCH_RETRY_MS / portTICK_PERIOD_MS);
+            continue;
+        }
 
-    return brotli::compress(buffer);
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        timeval timeout = {COMMS_KEEPALIVE_MS / 1000, 0}; // Notice a reconnection on a new socket.
+
+        int ready = select(fd + 1, &readable, NULL, NULL, &timeout);
+        if (ready < 0) { // Closed underneath us; the communication task reconnects.
+            vTaskDelay(COMMS_WATCH_RETRY_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        if (ready == 0) continue;
+
+        xEventGroupSetBits(client -> events, COMMS_EVENT_SOCKET);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
 }
 
 /**
- * @brief Callback from PubSubClient on message received. Copys the message to PSRAM and puts it on the task callback_queue.
+ * @brief Callback from PubSubClient on message received. Decompresses the message straight out of PubSubClient's buffer, which is
+ * reused once this returns, and puts it on the incoming message queue for the application.
  * 
+ * @param client 
  * @param topic Topic message was received on.
- * @param payload Message Contents.
+ * @param payload Message Contents, which are overwritten.
  * @param length The length of the payload.
  */
-void mqtt_callback(char* topic, uint8_t* payload, uint32_t length) {
+void deliver_message(MQTTClient* client, char* topic, char* payload, size_t length) {
+    uint64_t start_tm = millis();
+
+    IncomingMessage incoming_message;
+    incoming_message.message = codec::decode(payload, length, incoming_message.length);
+    if (incoming_message.message == nullptr) {
+        ESP_LOGE("MQTT", "Dropped message on topic %s which could not be decompressed.", topic);
+        return;
+    }
+
     size_t len_topic = strlen(topic);
-    CallbackQueueItem new_message = {
-        // Allocate memory on PSRAM for strings.
-        (char*) heap_caps_calloc(len_topic + 1, sizeof(char), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM),
-        (char*) heap_caps_calloc(length + 1, sizeof(char), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM),
-        length
-    };
-
-    // Copy data to allocated memory
-    memccpy(new_message.topic, topic, 0, len_topic);
-    memccpy(new_message.payload, payload, 0, length);
-    
-    // Put new message on queue
-    xQueueSendToBack(callback_queue, &new_message, portMAX_DELAY);
-    return;
+    incoming_message.topic = (char*) heap_caps_malloc(len_topic + 1, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    memcpy(incoming_message.topic, topic, len_topic + 1);
+
+    ESP_LOGV("MQTT", "Decompressed %u bytes to %u. [Took %ums]", length, incoming_message.length, millis() - start_tm);
+    xQueueSendToBack(client -> incoming_messages_queue, &incoming_message, portMAX_DELAY);
 }
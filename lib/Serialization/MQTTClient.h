@@ -10,25 +10,53 @@
 
 #include "json_allocator.h"
 #include "ps_base64.h"
+#include "BrotliWriter.h"
+#include "CompressionPolicy.h"
+#include "Outbox.h"
+
+#define COMMS_EVENT_OUTGOING (1 << 0) // A message was placed on the send queue.
+#define COMMS_EVENT_SOCKET (1 << 1) // The broker connection has data to read.
+#define COMMS_KEEPALIVE_MS (MQTT_KEEPALIVE * 1000 / 4) // Longest the idle task sleeps, so that keepalive pings are sent on time.
+#define MQTT_RECONNECT_INTERVAL_MS 5000 // Time between attempts to reconnect to the broker.
+#define COMMS_WATCH_RETRY_MS 100 // Wait before watching the socket again while it is closed or being reconnected.
 
 class MessageSerializer;
 class MessageDeserializer;
 
+/**
+ * @brief Encoding of an outgoing message's document, before compression.
+ * 
+ */
+enum MessageEncoding : uint8_t {
+    ENCODING_JSON = 0,
+    ENCODING_MSGPACK = 1 // Binary MessagePack; smaller, and faster to write as floats are not formatted as text.
+};
+
 /**
  * @brief Asynchronous MQTT client wrapper for the PubSubClient Class. Messages are compressed & decompressed with brotli.
  * 
+ * The communication task sleeps until a message is queued, the broker sends data or a keepalive is due, and then handles everything that is
+ * pending before sleeping again. Messages which cannot be published are kept in the outbox on flash, and published once the broker is
+ * reachable again.
  */
 class MQTTClient : public std::enable_shared_from_this<MQTTClient> {
     private:
         friend void communicationTask(void* parent);
+        friend void socketWatchTask(void* parent);
         friend class MessageSerializer;
         friend class PubSubClient;
 
         TaskHandle_t task_handle;
+        TaskHandle_t watch_task_handle = NULL;
         QueueHandle_t incoming_messages_queue;
         QueueHandle_t outgoing_messages_queue;
+        EventGroupHandle_t events; // COMMS_EVENT_* bits which wake the communication task.
         
-        Client& conn_client;
+        WiFiClient& conn_client;
+        volatile int socket_fd = -1; // Socket of the broker connection while connected, for the watch task.
+        uint64_t last_connect_attempt = 0;
+        Outbox outbox; // Messages which could not be published.
+        CompressionPolicy compression;
         
         ps::string client_id;
         ps::string auth_token;
@@ -41,14 +69,15 @@ class MQTTClient : public std::enable_shared_from_this<MQTTClient> {
         ps::string replace_placeholder(const ps::string& client_id, const ps::string& topic);
         ps::vector<ps::string> publish_topics;
 
-        void send_message(size_t topic, ps::string message);
+        void send_message(size_t topic, BrotliWriter& message);
+        bool publish(size_t topic, const char* payload, size_t length);
         void decode_token();
-        void connect();
+        bool connect();
 
     public:
         std::shared_ptr<PubSubClient> mqtt_client; // Underlying MQTT Client.
 
-        MQTTClient(Client& connection);
+        MQTTClient(WiFiClient& connection);
         ~MQTTClient();
         bool begin(const char* clientid, const char* token);
 
@@ -59,39 +88,46 @@ class MQTTClient : public std::enable_shared_from_this<MQTTClient> {
          */
         const ps::vector<ps::string>& topics() {return publish_topics;}
 
-        std::shared_ptr<MessageSerializer> createMessage(size_t topic_number, size_t size);
+        std::shared_ptr<MessageSerializer> createMessage(size_t topic_number, size_t size, MessageEncoding encoding = ENCODING_JSON);
         
+        void serializeCompression(JsonArray& array) { compression.serialize(array); }
+
         size_t incoming_message_count();
         std::shared_ptr<MessageDeserializer> getMessage();
 };
 
 /**
  * @brief Creates a JSON document of requested size on construction. The JSON document can be modified during the lifetime of the class,
- * finally, when the class runs out of scope, any data in the JSON document is automatically serialized and sent using the MQTT Client to
- * the requested topic.
+ * finally, when the class runs out of scope, any data in the JSON document is automatically serialized, compressed and sent using the MQTT
+ * Client to the requested topic. Serialization streams through the compressor, so only the compressed payload is queued.
  */
 class MessageSerializer {
     private:
         std::shared_ptr<MQTTClient> mqtt_client;
         size_t topic;
+        MessageEncoding encoding;
     public:
         DynamicPSRAMJsonDocument document;
-        MessageSerializer(std::shared_ptr<MQTTClient> client, size_t topic_number,  size_t json_document_size);
+        MessageSerializer(std::shared_ptr<MQTTClient> client, size_t topic_number,  size_t json_document_size, MessageEncoding encoding = ENCODING_JSON);
         ~MessageSerializer();
 };
 
 /**
  * @brief Automatically deserializes the JSON formatted string. The JSON document can be used to get any data contained in the message. 
- * 
+ * The deserializer owns the message buffer, which the document's strings point into.
  */
 class MessageDeserializer {
     private:
-        ps::string message; // JSON document data must remain in memory whilst the document is in use.
+        char* message; // JSON document data must remain in memory whilst the document is in use.
+        static size_t capacity(const char* message, size_t length);
     public:
         ps::string topic;
         DynamicPSRAMJsonDocument document;
-        MessageDeserializer(const char* topic,const char* message);
+        MessageDeserializer(const char* topic, char* message, size_t length);
+        ~MessageDeserializer();
 
+        MessageDeserializer(const MessageDeserializer&) = delete;
+        MessageDeserializer& operator=(const MessageDeserializer&) = delete;
 };
 
 
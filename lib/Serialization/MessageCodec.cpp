@@ -0,0 +1,193 @@
+#include "MessageCodec.h"
+
+namespace codec {
+/**
+ * @brief Build the codec header of a payload.
+ *
+ * @param compression
+ * @param dictionary Dictionary version, MESSAGE_DICTIONARY_NONE for stored payloads.
+ * @return uint8_t
+ */
+uint8_t header(MessageCompression compression, uint8_t dictionary) {
+    return ((compression & MESSAGE_HEADER_LEVEL_MASK) << MESSAGE_HEADER_LEVEL_SHIFT) | (dictionary & MESSAGE_HEADER_DICTIONARY_MASK);
+}
+
+/**
+ * @brief Look up a shared dictionary by the version carried in the codec header.
+ *
+ * @param version
+ * @param data Set to the dictionary, which is held in flash.
+ * @param size Set to the size of the dictionary.
+ * @return true - If the version is known.
+ */
+bool dictionary(uint8_t version, const uint8_t*& data, size_t& size) {
+    switch (version) {
+        case 1:
+            data = brotli_dictionary_v1;
+            size = sizeof(brotli_dictionary_v1);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Get the encoder's prepared form of the outgoing dictionary. It is prepared on first use and kept, as preparing hashes the whole
+ * dictionary.
+ *
+ * @param version Must be MESSAGE_DICTIONARY_VERSION, the only version messages are compressed with.
+ * @return const BrotliEncoderPreparedDictionary* - The prepared dictionary, or nullptr if it is unknown or could not be prepared.
+ */
+const BrotliEncoderPreparedDictionary* preparedDictionary(uint8_t version) {
+    static BrotliEncoderPreparedDictionary* prepared = nullptr;
+
+    if (version != MESSAGE_DICTIONARY_VERSION) return nullptr;
+    if (prepared != nullptr) return prepared;
+
+    const uint8_t* data;
+    size_t size;
+    if (!dictionary(version, data, size)) return nullptr;
+
+    prepared = BrotliEncoderPrepareDictionary(BROTLI_SHARED_DICTIONARY_RAW, size, data, BROTLI_MAX_QUALITY, NULL, NULL, NULL);
+    if (prepared == nullptr) ESP_LOGE("Codec", "Failed to prepare dictionary v%u.", version);
+    return prepared;
+}
+
+/**
+ * @brief Base64 decode in place. The decoded bytes are never ahead of the characters still to be read, so they can share the buffer.
+ *
+ * @param data
+ * @param length
+ * @param decoded_length Set to the number of decoded bytes.
+ * @return true - If the data was valid base64.
+ */
+static bool base64_decode_in_place(char* data, size_t length, size_t& decoded_length) {
+    static int8_t values[256];
+    static bool initialised = false;
+    if (!initialised) {
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        memset(values, -1, sizeof(values));
+        for (int i = 0; i < 64; i++) values[(uint8_t) alphabet[i]] = i;
+        initialised = true;
+    }
+
+    uint32_t bits = 0;
+    int bit_count = 0;
+    decoded_length = 0;
+
+    for (size_t i = 0; i < length && data[i] != '='; i++) {
+        int8_t value = values[(uint8_t) data[i]];
+        if (value < 0) return false;
+
+        bits = (bits << 6) | value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            data[decoded_length++] = (char) ((bits >> bit_count) & 0xFF);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copy a stored message out of the payload, which is owned by the MQTT client.
+ *
+ * @param data
+ * @param length
+ * @return char* - The NUL terminated message, owned by the caller, or nullptr if it could not be allocated.
+ */
+static char* copy_stored(const char* data, size_t length) {
+    char* message = (char*) heap_caps_malloc(length + 1, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (message == nullptr) {
+        ESP_LOGE("Codec", "Failed to allocate %u byte message.", length + 1);
+        return nullptr;
+    }
+
+    memcpy(message, data, length);
+    message[length] = '\0';
+    return message;
+}
+
+/**
+ * @brief Decode a received payload: base64 decode it in place, read the codec header, and decompress the brotli stream with the dictionary
+ * it names straight into the buffer which is returned, so that the message is not copied again on its way to the deserializer. Stored
+ * messages are copied out as they are.
+ *
+ * @param payload Base64 payload, which is overwritten.
+ * @param length
+ * @param message_length Set to the length of the message.
+ * @return char* - The NUL terminated message, owned by the caller and freed with `free()`, or nullptr if the payload is malformed or names
+ * an unknown codec or dictionary.
+ */
+char* decode(char* payload, size_t length, size_t& message_length) {
+    size_t compressed_length;
+    if (!base64_decode_in_place(payload, length, compressed_length) || compressed_length == 0) {
+        ESP_LOGE("Codec", "Malformed payload.");
+        return nullptr;
+    }
+
+    uint8_t header = payload[0];
+    if (header & MESSAGE_HEADER_RESERVED) {
+        ESP_LOGE("Codec", "Unknown codec header 0x%02x.", header);
+        return nullptr;
+    }
+
+    if (((header >> MESSAGE_HEADER_LEVEL_SHIFT) & MESSAGE_HEADER_LEVEL_MASK) == COMPRESSION_STORED) {
+        message_length = compressed_length - 1;
+        return copy_stored(payload + 1, message_length);
+    }
+
+    uint8_t version = header & MESSAGE_HEADER_DICTIONARY_MASK; // The brotli stream does not depend on the level it was compressed at.
+    BrotliDecoderState* decoder = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+    if (decoder == NULL) {
+        ESP_LOGE("Codec", "Failed to create decoder.");
+        return nullptr;
+    }
+
+    if (version != MESSAGE_DICTIONARY_NONE) {
+        const uint8_t* data;
+        size_t size;
+        if (!dictionary(version, data, size) || !BrotliDecoderAttachDictionary(decoder, BROTLI_SHARED_DICTIONARY_RAW, size, data)) {
+            ESP_LOGE("Codec", "Unknown dictionary v%u.", version);
+            BrotliDecoderDestroyInstance(decoder);
+            return nullptr;
+        }
+    }
+
+    const uint8_t* next_in = (const uint8_t*) payload + 1;
+    size_t available_in = compressed_length - 1;
+    size_t capacity = max((size_t) MESSAGE_DECODE_MIN_CAPACITY, available_in * 4);
+    char* message = (char*) heap_caps_malloc(capacity, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    message_length = 0;
+    BrotliDecoderResult result = BROTLI_DECODER_RESULT_ERROR;
+
+    while (message != nullptr) {
+        uint8_t* next_out = (uint8_t*) message + message_length;
+        size_t available_out = capacity - message_length - 1; // Room for the terminator.
+        result = BrotliDecoderDecompressStream(decoder, &available_in, &next_in, &available_out, &next_out, NULL);
+        message_length = (char*) next_out - message;
+        if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) break;
+
+        capacity *= 2;
+        char* grown = (char*) heap_caps_realloc(message, capacity, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        if (grown == nullptr) {
+            ESP_LOGE("Codec", "Failed to allocate %u byte message.", capacity);
+            result = BROTLI_DECODER_RESULT_ERROR;
+            break;
+        }
+        message = grown;
+    }
+
+    BrotliDecoderDestroyInstance(decoder);
+
+    if (result != BROTLI_DECODER_RESULT_SUCCESS) {
+        if (message != nullptr) ESP_LOGE("Codec", "Decompression failed.");
+        free(message);
+        return nullptr;
+    }
+
+    message[message_length] = '\0';
+    return message;
+}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef MESSAGE_CODEC_H
+#define MESSAGE_CODEC_H
+
+#include <Arduino.h>
+#include <ps_stl.h>
+#include <brotli/include/brotli/encode.h>
+#include <brotli/include/brotli/decode.h>
+
+#include "brotli_dictionary.h"
+
+/*
+ * MQTT payloads are base64 encoded, and the first byte of the decoded payload is the codec header: the compression level in bits 5-6, and
+ * in bits 0-4 the version of the shared dictionary the brotli stream that follows was compressed with, or MESSAGE_DICTIONARY_NONE. Stored
+ * messages follow the header uncompressed. Bit 7 is reserved. Headers sent before the level was added read as brotli at the best level.
+ * Regenerate brotli_dictionary.h with tools/brotli_dictionary/build_dictionary.py, and keep every version the server may still send in
+ * `dictionary()`.
+ */
+#define MESSAGE_DICTIONARY_NONE 0
+#ifndef MESSAGE_DICTIONARY_VERSION
+#define MESSAGE_DICTIONARY_VERSION BROTLI_DICTIONARY_LATEST // Dictionary outgoing messages are compressed with.
+#endif
+#define MESSAGE_HEADER_DICTIONARY_MASK 0x1F
+#define MESSAGE_HEADER_LEVEL_SHIFT 5
+#define MESSAGE_HEADER_LEVEL_MASK 0x03
+#define MESSAGE_HEADER_RESERVED 0x80
+#define MESSAGE_DECODE_MIN_CAPACITY 1024 // Smallest buffer a message is decompressed into. It starts at 4x the compressed size, and doubles.
+
+/**
+ * @brief Compression level of a payload, carried in the codec header. The brotli quality of each level is set in BrotliWriter.h.
+ * 
+ */
+enum MessageCompression : uint8_t {
+    COMPRESSION_BEST = 0,
+    COMPRESSION_BALANCED = 1,
+    COMPRESSION_FAST = 2,
+    COMPRESSION_STORED = 3 // Not compressed.
+};
+#define MESSAGE_COMPRESSION_LEVELS 4
+
+namespace codec {
+    uint8_t header(MessageCompression compression, uint8_t dictionary);
+    bool dictionary(uint8_t version, const uint8_t*& data, size_t& size);
+    const BrotliEncoderPreparedDictionary* preparedDictionary(uint8_t version);
+    char* decode(char* payload, size_t length, size_t& message_length);
+}
+
+#endif
@@ -0,0 +1,435 @@
+#include "Outbox.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+#define OUTBOX_INDEX_PATH "/outbox.idx"
+
+Outbox::Outbox() {
+    lock = xSemaphoreCreateMutex();
+}
+
+Outbox::~Outbox() {
+    vSemaphoreDelete(lock);
+}
+
+ps::string Outbox::segment_path(uint32_t segment) {
+    char path[20];
+    snprintf(path, sizeof(path), "/outbox_%u.bin", segment % OUTBOX_SEGMENTS);
+    return ps::string(path);
+}
+
+uint32_t Outbox::checksum(uint8_t topic, const char* payload, size_t length) {
+    uint32_t crc = esp_rom_crc32_le(0, &topic, sizeof(topic));
+    return esp_rom_crc32_le(crc, (const uint8_t*) payload, length);
+}
+
+uint32_t Outbox::checksum(const OutboxIndex& index) {
+    return esp_rom_crc32_le(0, (const uint8_t*) &index, offsetof(OutboxIndex, crc));
+}
+
+/**
+ * @brief Load the index, count the stored messages and find the end of the tail segment. If the tail segment ends in a torn write, appending
+ * continues in a new segment, so that new messages are not stranded behind it.
+ *
+ * @return true - If the outbox is ready.
+ */
+bool Outbox::begin() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    OutboxIndex loaded;
+    auto file = LittleFS.open(OUTBOX_INDEX_PATH, FILE_READ);
+    bool valid = file && file.read((uint8_t*) &loaded, sizeof(loaded)) == sizeof(loaded) && loaded.magic == OUTBOX_INDEX_MAGIC &&
+                 loaded.crc == checksum(loaded) && loaded.tail_segment - loaded.head_segment < OUTBOX_SEGMENTS;
+    if (file) file.close();
+
+    if (valid) {
+        index = loaded;
+    } else {
+        for (uint32_t i = 0; i < OUTBOX_SEGMENTS; i++) LittleFS.remove(segment_path(i).c_str());
+        index = {OUTBOX_INDEX_MAGIC, 0, 0, 0, 0};
+    }
+    saved = valid ? index : OutboxIndex{};
+
+    stored = 0;
+    for (uint32_t segment = index.head_segment; segment != index.tail_segment + 1; segment++) {
+        size_t count = 0;
+        size_t end = 0;
+        bool complete = scan(segment, (segment == index.head_segment) ? index.head_offset : 0, end, count);
+        stored += count;
+
+        if (segment != index.tail_segment) continue;
+        tail_size = end;
+
+        if (!complete) {
+            ESP_LOGW("Outbox", "Segment %u ends in a torn write, starting a new segment.", segment);
+            next_segment();
+        }
+    }
+
+    if (stored == 0) reset();
+    bool success = write_index();
+    xSemaphoreGive(lock);
+
+    if (stored > 0) ESP_LOGI("Outbox", "%u stored messages in segments %u to %u.", stored, index.head_segment, index.tail_segment);
+    return success;
+}
+
+/**
+ * @brief Walk the record headers of a segment.
+ *
+ * @param segment
+ * @param offset Where to start.
+ * @param end Set to the end of the last complete record.
+ * @param count Set to the number of complete records.
+ * @return true - If the segment holds nothing but complete records.
+ */
+bool Outbox::scan(uint32_t segment, size_t offset, size_t& end, size_t& count) {
+    end = offset;
+    count = 0;
+
+    auto file = LittleFS.open(segment_path(segment).c_str(), FILE_READ);
+    if (!file) return offset == 0;
+
+    size_t size = file.size();
+    file.seek(offset);
+
+    OutboxRecordHeader header;
+    while (end < size) {
+        if (file.read((uint8_t*) &header, sizeof(header)) != sizeof(header) || header.magic != OUTBOX_RECORD_MAGIC) break;
+        if (header.length > size - end - sizeof(header)) break;
+
+        end += sizeof(header) + header.length;
+        file.seek(end);
+        count++;
+    }
+
+    file.close();
+    return end == size;
+}
+
+/**
+ * @brief Write the index, if the head or tail segment has moved since it was last written.
+ *
+ * @return true - If the index on flash is current.
+ */
+bool Outbox::write_index() {
+    if (memcmp(&index, &saved, offsetof(OutboxIndex, crc)) == 0) return true;
+
+    index.crc = checksum(index);
+    auto file = LittleFS.open(OUTBOX_INDEX_PATH, FILE_WRITE, true);
+    if (!file || file.write((const uint8_t*) &index, sizeof(index)) != sizeof(index)) {
+        ESP_LOGE("Outbox", "Failed to write index.");
+        if (file) file.close();
+        return false;
+    }
+
+    file.close();
+    saved = index;
+    return true;
+}
+
+/**
+ * @brief Drop the oldest segment to make room, when every segment is in use.
+ */
+void Outbox::drop_head_segment() {
+    size_t count = 0;
+    size_t end = 0;
+    scan(index.head_segment, index.head_offset, end, count);
+
+    LittleFS.remove(segment_path(index.head_segment).c_str());
+    stored -= min(count, stored);
+    head_sequence += max(count, (size_t) 1); // Tokens for the dropped messages no longer match.
+    index.head_segment++;
+    index.head_offset = 0;
+    head_size = 0;
+
+    ESP_LOGW("Outbox", "Outbox full, dropped %u oldest messages.", count);
+}
+
+/**
+ * @brief Start appending to the next segment, dropping the oldest segment first if every segment is in use.
+ */
+void Outbox::next_segment() {
+    index.tail_segment++;
+    tail_size = 0;
+    if (index.tail_segment - index.head_segment >= OUTBOX_SEGMENTS) drop_head_segment();
+    LittleFS.remove(segment_path(index.tail_segment).c_str()); // Left behind by a reset before its index was written.
+}
+
+/**
+ * @brief Once every stored message has been published, remove the tail segment and start the next one.
+ */
+void Outbox::reset() {
+    head_sequence += stored; // Any left are dropped, as when a corrupt segment is skipped.
+    LittleFS.remove(segment_path(index.tail_segment).c_str());
+    if (tail_size > 0) {
+        index.tail_segment++;
+        LittleFS.remove(segment_path(index.tail_segment).c_str());
+    }
+    index.head_segment = index.tail_segment;
+    index.head_offset = 0;
+    tail_size = 0;
+    head_size = 0;
+    stored = 0;
+}
+
+bool Outbox::flash_empty() {
+    return index.head_segment == index.tail_segment && index.head_offset >= tail_size;
+}
+
+/**
+ * @brief Append the buffered records to the tail segment in a single write, starting a new segment first if they do not fit.
+ *
+ * @return true - If the records were written.
+ */
+bool Outbox::write_buffer() {
+    size_t length = buffer.size() - buffer_head;
+    if (length == 0) return true;
+
+    if (tail_size > 0 && tail_size + length > OUTBOX_SEGMENT_SIZE) {
+        next_segment();
+    }
+
+    auto file = LittleFS.open(segment_path(index.tail_segment).c_str(), FILE_APPEND, true);
+    size_t written = file ? file.write(buffer.data() + buffer_head, length) : 0;
+    if (file) file.close();
+
+    if (written != length) {
+        ESP_LOGE("Outbox", "Failed to write %u buffered messages to segment %u.", buffered, index.tail_segment);
+        // Whatever part was written is a torn record, so continue in a new segment.
+        if (written > 0) {
+            next_segment();
+            write_index();
+        }
+        return false;
+    }
+
+    tail_size += length;
+    stored += buffered;
+    ESP_LOGI("Outbox", "Wrote %u messages (%u bytes) to segment %u.", buffered, length, index.tail_segment);
+
+    buffer.clear();
+    buffer.shrink_to_fit();
+    buffer_head = 0;
+    buffered = 0;
+    moves++; // A buffered front record is now on flash.
+    return write_index();
+}
+
+/**
+ * @brief Store a message for later. It is buffered in RAM, and written to flash with the others once enough have been gathered.
+ *
+ * @param topic Topic number.
+ * @param payload Compressed and base64 encoded payload, which is copied.
+ * @param length
+ * @return true - If the message was stored.
+ */
+bool Outbox::push(uint8_t topic, const char* payload, size_t length) {
+    size_t record_size = sizeof(OutboxRecordHeader) + length;
+    if (record_size > OUTBOX_SEGMENT_SIZE) {
+        ESP_LOGE("Outbox", "%u byte message is too large to store.", length);
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    if (buffer.size() - buffer_head + record_size > OUTBOX_SEGMENT_SIZE) { // Flash is failing, bound the RAM used.
+        xSemaphoreGive(lock);
+        ESP_LOGE("Outbox", "Buffer full, message dropped.");
+        return false;
+    }
+
+    OutboxRecordHeader header = {OUTBOX_RECORD_MAGIC, length, checksum(topic, payload, length), topic};
+    if (buffered == 0) buffer_since = millis();
+    buffer.insert(buffer.end(), (const uint8_t*) &header, (const uint8_t*) &header + sizeof(header));
+    buffer.insert(buffer.end(), (const uint8_t*) payload, (const uint8_t*) payload + length);
+    buffered++;
+
+    if (buffer.size() - buffer_head >= OUTBOX_FLUSH_SIZE) write_buffer();
+
+    xSemaphoreGive(lock);
+    return true;
+}
+
+/**
+ * @brief Write the buffered messages to flash, if enough have been gathered or the oldest has waited `OUTBOX_FLUSH_INTERVAL_MS`.
+ *
+ * @param force Write whatever is buffered, such as before a restart.
+ * @return true - If nothing needed writing or it was written.
+ */
+bool Outbox::flush(bool force) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    bool success = true;
+    if (buffered > 0 && (force || buffer.size() - buffer_head >= OUTBOX_FLUSH_SIZE || millis() - buffer_since >= OUTBOX_FLUSH_INTERVAL_MS)) {
+        success = write_buffer();
+    }
+
+    xSemaphoreGive(lock);
+    return success;
+}
+
+/**
+ * @brief Find the oldest stored message, and note where it is for `pop()`. Corrupt records on flash are skipped, along with the rest of their
+ * segment. Expects the lock to be held.
+ *
+ * @param topic Set to the topic number.
+ * @param payload Set to the payload.
+ * @return true - If there is a message.
+ */
+bool Outbox::locate_front(uint8_t& topic, ps::string& payload) {
+    front_size = 0;
+    front_moves = moves;
+
+    while (!flash_empty()) {
+        auto file = LittleFS.open(segment_path(index.head_segment).c_str(), FILE_READ);
+        OutboxRecordHeader header;
+        bool valid = false;
+
+        if (file) {
+            head_size = file.size();
+            file.seek(index.head_offset);
+            valid = file.read((uint8_t*) &header, sizeof(header)) == sizeof(header) && header.magic == OUTBOX_RECORD_MAGIC &&
+                    header.length <= head_size - index.head_offset - sizeof(header);
+            if (valid) {
+                payload.resize(header.length);
+                valid = file.read((uint8_t*) &payload[0], header.length) == header.length &&
+                        checksum(header.topic, payload.data(), header.length) == header.crc;
+            }
+            file.close();
+        }
+
+        if (valid) {
+            topic = header.topic;
+            front_size = sizeof(header) + header.length;
+            front_buffered = false;
+            return true;
+        }
+
+        ESP_LOGE("Outbox", "Skipping corrupt segment %u.", index.head_segment);
+        if (index.head_segment != index.tail_segment) drop_head_segment();
+        else reset();
+        write_index();
+    }
+
+    if (buffered > 0) {
+        OutboxRecordHeader header;
+        memcpy(&header, buffer.data() + buffer_head, sizeof(header));
+        topic = header.topic;
+        payload.assign((const char*) buffer.data() + buffer_head + sizeof(header), header.length);
+        front_size = sizeof(header) + header.length;
+        front_buffered = true;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Get the oldest stored message, without removing it.
+ *
+ * @param topic Set to the topic number.
+ * @param payload Set to the payload.
+ * @param token Set to the message's token, to be passed to `pop()`.
+ * @return true - If there is a message.
+ */
+bool Outbox::front(uint8_t& topic, ps::string& payload, uint32_t& token) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool found = locate_front(topic, payload);
+    token = head_sequence;
+    xSemaphoreGive(lock);
+    return found;
+}
+
+/**
+ * @brief Remove the message returned by `front()`, once it has been published. A finished segment is removed from flash, and the index only
+ * written then. If the message was moved to flash since `front()`, it is found again there.
+ *
+ * @param token The token `front()` gave for the message.
+ * @return true - If the message was removed. False if it is already gone, dropped or cleared since `front()`.
+ */
+bool Outbox::pop(uint32_t token) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    if (token != head_sequence) {
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    if (front_size == 0 || front_moves != moves) { // Moved to flash by a push, or not located yet.
+        uint8_t topic;
+        ps::string payload;
+        if (!locate_front(topic, payload) || token != head_sequence) {
+            front_size = 0;
+            xSemaphoreGive(lock);
+            return false;
+        }
+    }
+
+    if (front_buffered) {
+        buffer_head += front_size;
+        if (--buffered == 0) {
+            buffer.clear();
+            buffer_head = 0;
+        }
+    } else {
+        index.head_offset += front_size;
+        stored -= min((size_t) 1, stored);
+
+        if (flash_empty()) {
+            reset();
+            write_index();
+        } else if (index.head_segment != index.tail_segment && index.head_offset >= head_size) {
+            LittleFS.remove(segment_path(index.head_segment).c_str());
+            index.head_segment++;
+            index.head_offset = 0;
+            write_index();
+        }
+    }
+
+    head_sequence++;
+    front_size = 0;
+    xSemaphoreGive(lock);
+    return true;
+}
+
+/**
+ * @brief Remove every stored message, from RAM and flash.
+ */
+void Outbox::clear() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (uint32_t i = 0; i < OUTBOX_SEGMENTS; i++) LittleFS.remove(segment_path(i).c_str());
+    head_sequence += stored + buffered + 1; // Tokens handed out before the clear no longer match.
+    buffer.clear();
+    buffer_head = 0;
+    buffered = 0;
+    front_size = 0;
+    tail_size = 0;
+    index.head_segment = index.tail_segment;
+    index.head_offset = 0;
+    head_size = 0;
+    stored = 0;
+    write_index();
+
+    xSemaphoreGive(lock);
+}
+
+bool Outbox::empty() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool ret = flash_empty() && buffered == 0;
+    xSemaphoreGive(lock);
+    return ret;
+}
+
+/**
+ * @brief Get the number of stored messages, on flash and buffered.
+ *
+ * @return size_t
+ */
+size_t Outbox::size() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    size_t ret = stored + buffered;
+    xSemaphoreGive(lock);
+    return ret;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <Arduino.h>
+#include <ps_stl.h>
+
+#define OUTBOX_SEGMENTS 8 // Segment files rotated through. The oldest segment is dropped when all are full.
+#define OUTBOX_SEGMENT_SIZE (64 * 1024) // Size at which a segment is closed and the next one started.
+#define OUTBOX_FLUSH_SIZE (16 * 1024) // Messages gathered in RAM before they are written to flash in one append.
+#define OUTBOX_FLUSH_INTERVAL_MS (10 * 60 * 1000) // Longest a message waits in RAM before it is written to flash.
+#define OUTBOX_DRAIN_BATCH 4 // Stored messages published per drain interval after reconnecting.
+#define OUTBOX_DRAIN_INTERVAL_MS 1000
+#define OUTBOX_RECORD_MAGIC 0x4F425831 // "OBX1"
+#define OUTBOX_INDEX_MAGIC 0x4F424931 // "OBI1"
+
+struct OutboxRecordHeader {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t crc; // Of the topic and the payload.
+    uint8_t topic;
+} __attribute__ ((packed));
+
+struct OutboxIndex {
+    uint32_t magic;
+    uint32_t head_segment; // Sequence number of the segment holding the oldest message.
+    uint32_t head_offset; // Offset of the oldest message in its segment.
+    uint32_t tail_segment; // Sequence number of the segment being appended to.
+    uint32_t crc;
+} __attribute__ ((packed));
+
+/**
+ * @brief Bounded store-and-forward queue of compressed messages, kept on LittleFS while the broker is unreachable.
+ *
+ * Messages are appended to segment files, named by their sequence number modulo `OUTBOX_SEGMENTS`, and read back oldest first from the
+ * head recorded in the index file. To spare the flash, pushed messages are gathered in RAM and appended in one write once
+ * `OUTBOX_FLUSH_SIZE` is reached or `OUTBOX_FLUSH_INTERVAL_MS` has passed, and the index is only written when a flush or a finished
+ * segment moves the head or tail. After a reset, messages published since the last index write are published again.
+ *
+ * All methods are thread safe. `front()` hands out a token naming the message it returned, and `pop()` only removes that message, so a push
+ * flushing the buffer, or a clear, between the two cannot make `pop()` remove the wrong record.
+ *
+ * @note Expects the filesystem to be mounted before `begin()`.
+ */
+class Outbox {
+    private:
+        SemaphoreHandle_t lock;
+        OutboxIndex index = {OUTBOX_INDEX_MAGIC, 0, 0, 0, 0};
+        OutboxIndex saved = {}; // The index as last written to flash.
+        size_t head_size = 0; // Bytes in the head segment, as of the last `front()`.
+        size_t tail_size = 0; // Bytes in the tail segment.
+        size_t stored = 0; // Messages on flash.
+
+        ps::vector<uint8_t> buffer; // Records not yet written to flash.
+        size_t buffer_head = 0; // Offset of the oldest unpublished record in the buffer.
+        size_t buffered = 0; // Messages in the buffer.
+        uint64_t buffer_since = 0; // millis() of the oldest record in the buffer.
+
+        size_t front_size = 0; // Size of the record returned by `front()`, removed by `pop()`.
+        bool front_buffered = false;
+        uint32_t front_moves = 0; // `moves` when the front record was located.
+
+        uint32_t head_sequence = 0; // Sequence number of the oldest message, advanced as messages are removed or dropped.
+        uint32_t moves = 0; // Bumped whenever buffered records are moved to flash.
+
+        ps::string segment_path(uint32_t segment);
+        uint32_t checksum(uint8_t topic, const char* payload, size_t length);
+        uint32_t checksum(const OutboxIndex& index);
+        bool scan(uint32_t segment, size_t offset, size_t& end, size_t& count);
+        bool write_index();
+        void drop_head_segment();
+        void next_segment();
+        void reset();
+        bool flash_empty();
+        bool write_buffer();
+        bool locate_front(uint8_t& topic, ps::string& payload);
+
+    public:
+        Outbox();
+        ~Outbox();
+
+        bool begin();
+        bool push(uint8_t topic, const char* payload, size_t length);
+        bool flush(bool force = false);
+        bool front(uint8_t& topic, ps::string& payload, uint32_t& token);
+        bool pop(uint32_t token);
+        void clear();
+
+        bool empty();
+        size_t size();
+};
+
+#endif
@@ -12,10 +12,62 @@
 
 #include "json_allocator.h"
 
+#define PERSISTENCE_READ_BUFFER 512 // Bytes read from flash at a time while a file is parsed or compared.
+
+/**
+ * @brief Reads a file through a buffer, a block at a time, as a source ArduinoJson can deserialize from. The document is parsed as the file
+ * is read, so the file is never held in memory whole, and the parser's reads of one character at a time do not each reach the filesystem.
+ * 
+ */
+class BufferedFileReader {
+    private:
+        File& file;
+        uint8_t buffer[PERSISTENCE_READ_BUFFER];
+        size_t length = 0; // Bytes in the buffer.
+        size_t position = 0; // Next byte of the buffer to read.
+
+        bool fill() {
+            length = file.read(buffer, sizeof(buffer));
+            position = 0;
+            return length > 0;
+        }
+
+    public:
+        BufferedFileReader(File& file) : file(file) {}
+
+        /**
+         * @brief Read the next byte of the file.
+         * 
+         * @return int The byte, or -1 at the end of the file.
+         */
+        int read() {
+            if (position == length && !fill()) return -1;
+            return buffer[position++];
+        }
+
+        /**
+         * @brief Read up to `size` bytes of the file.
+         * 
+         * @return size_t The number of bytes read, fewer than `size` only at the end of the file.
+         */
+        size_t readBytes(char* data, size_t size) {
+            size_t count = 0;
+            while (count < size && (position < length || fill())) {
+                size_t chunk = std::min(size - count, length - position);
+                memcpy(data + count, buffer + position, chunk);
+                position += chunk;
+                count += chunk;
+            }
+            return count;
+        }
+};
+
 /**
  * @brief This class opens a file on the filesystem and creates a DynamicJsonDocument on the PSRAM during construction. The document can then be modified during the life of the
  * class. Upon destruction, the contents of the Json document are serialized and written to the file on flash memory if write_on_destruction is set to true during construction.
  * 
+ * The file is deserialized as it is read, through a `BufferedFileReader`, so loading needs no copy of the file beside the document.
+ * 
  * @note Expects the provided file system to be mounted before class construction.
  * 
  */
@@ -25,6 +77,28 @@ class Persistence {
         ps::string path;
         bool write;
 
+        /**
+         * @brief Check whether the file on flash holds exactly the serialized document.
+         * 
+         * @param output The serialized document.
+         * @return true - If the file is the same length and its contents match.
+         */
+        bool unchanged(const ps::string& output) {
+            auto file = LittleFS.open(path.c_str(), FILE_READ);
+            if (!file) return false;
+
+            bool same = file.size() == output.size();
+            BufferedFileReader reader(file);
+            char chunk[64];
+            for (size_t offset = 0; same && offset < output.size(); offset += sizeof(chunk)) {
+                size_t length = std::min(sizeof(chunk), output.size() - offset);
+                same = reader.readBytes(chunk, length) == length && memcmp(chunk, output.data() + offset, length) == 0;
+            }
+
+            file.close();
+            return same;
+        }
+
     public:
         DynamicPSRAMJsonDocument document;
         
@@ -36,12 +110,16 @@ class Persistence {
                 return;
             }
 
-            ps::string data = file.readString().c_str();
-            ESP_LOGI("Persistence" , "File: %s", data.c_str());
-
-            auto result = deserializeJson(document, data.c_str());
-            if (result.code() != 0) ESP_LOGE("Persistence", "Json Deserialization Failed: %s", result.c_str());
+            uint32_t start_us = micros();
+            size_t size = file.size();
+            if (size > 0) {
+                BufferedFileReader reader(file);
+                auto result = deserializeJson(document, reader);
+                if (result.code() != 0) ESP_LOGE("Persistence", "Json Deserialization Failed for %s: %s", path.c_str(), result.c_str());
+            }
 
+            ESP_LOGI("Persistence", "Loaded %s: %u bytes into %u of %u bytes of document in %u us.", path.c_str(), size, document.memoryUsage(),
+                     document.capacity(), micros() - start_us);
             file.close();
         }
 
@@ -71,33 +149,20 @@ class Persistence {
         }
 
         ~Persistence() {
+            json_pool::recordUsage(document.capacity(), document.memoryUsage());
+
             if (write) {
-                ps::ostringstream output;
-                if (serializeJson(document, output) == 0) {
+                ps::ostringstream stream;
+                if (serializeJson(document, stream) == 0) {
                     ESP_LOGE("Persistence", "Serialization Failed.");
                 }
 
-                auto file = LittleFS.open(path.c_str(), FILE_READ, true);
-
-                char buf;
-                bool write_required = false;
-                size_t filePos = 0; // Initialize file position
-
-                while (filePos < output.str().size() && file.readBytes(&buf, 1) > 0) {
-                    if (buf != output.str().c_str()[filePos]) {
-                        ESP_LOGI("Persistence", "File and output are different.");
-                        write_required = true; // Data needs to be written
-                        break;
-                    }
-                    filePos++; // Increment the file position
-                }
-
-                file.close();
-
-                if (!write_required) return; // If the file and output are the same, do not write to the file.
+                ps::string output = stream.str();
+                if (unchanged(output)) return; // If the file and output are the same, do not write to the file.
+                ESP_LOGI("Persistence", "File and output are different.");
             
-                file = LittleFS.open(path.c_str(), FILE_WRITE, true);
-                file.write((const uint8_t*)output.str().c_str(), output.str().size());
+                auto file = LittleFS.open(path.c_str(), FILE_WRITE, true);
+                file.write((const uint8_t*)output.c_str(), output.size());
                 file.flush();
                 file.close();
             }
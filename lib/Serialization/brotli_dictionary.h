@@ -0,0 +1,142 @@
+#pragma once
+
+#ifndef BROTLI_DICTIONARY_DATA_H
+#define BROTLI_DICTIONARY_DATA_H
+
+#include <Arduino.h>
+
+// Generated by tools/brotli_dictionary/build_dictionary.py from 145 messages. Do not edit.
+#define BROTLI_DICTIONARY_LATEST 1
+
+const uint8_t brotli_dictionary_v1[] PROGMEM = {
+	0x2c, 0x22, 0x70, 0x65, 0x72, 0x69, 0x6f, 0x64, 0x22, 0x3a, 0x2c, 0x22, 0x63, 0x6e, 0x74, 0x22,
+	0x3a, 0x5b, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x64, 0x61, 0x74, 0x61, 0x22, 0x3a, 0x7b, 0x22, 0x75,
+	0x6e, 0x69, 0x74, 0x5f, 0x72, 0x75, 0x6c, 0x65, 0x73, 0x22, 0x3a, 0x7b, 0x22, 0x61, 0x63, 0x74,
+	0x69, 0x6f, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x36, 0x2c,
+	0x22, 0x65, 0x6e, 0x64, 0x22, 0x3a, 0x39, 0x7d, 0x2c, 0x7b, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74,
+	0x22, 0x3a, 0x6f, 0x6d, 0x6d, 0x61, 0x6e, 0x64, 0x22, 0x3a, 0x22, 0x73, 0x65, 0x74, 0x5f, 0x72,
+	0x65, 0x6c, 0x61, 0x79, 0x28, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x22, 0x7d, 0x5d, 0x7d, 0x5d,
+	0x7d, 0x7d, 0x2c, 0x33, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x5d, 0x7d,
+	0x5d, 0x7d, 0x7d, 0x22, 0x74, 0x79, 0x70, 0x65, 0x22, 0x3a, 0x33, 0x2c, 0x22, 0x64, 0x61, 0x74,
+	0x61, 0x22, 0x3a, 0x7b, 0x22, 0x73, 0x65, 0x61, 0x73, 0x6f, 0x6e, 0x73, 0x22, 0x3a, 0x5b, 0x7b,
+	0x22, 0x6e, 0x61, 0x22, 0x3a, 0x30, 0x7d, 0x2c, 0x7b, 0x22, 0x64, 0x61, 0x79, 0x22, 0x3a, 0x32,
+	0x37, 0x2c, 0x22, 0x6d, 0x6f, 0x6e, 0x74, 0x68, 0x22, 0x3a, 0x33, 0x2c, 0x22, 0x79, 0x65, 0x61,
+	0x72, 0x22, 0x3a, 0x5d, 0x2c, 0x22, 0x62, 0x61, 0x73, 0x65, 0x5f, 0x70, 0x72, 0x69, 0x63, 0x65,
+	0x73, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x73, 0x65, 0x61, 0x73, 0x6f, 0x6e, 0x22, 0x3a, 0x22, 0x68,
+	0x69, 0x67, 0x68, 0x7d, 0x2c, 0x7b, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x31, 0x37,
+	0x2c, 0x22, 0x65, 0x6e, 0x64, 0x22, 0x3a, 0x31, 0x39, 0x7d, 0x5d, 0x2c, 0x22, 0x70, 0x72, 0x69,
+	0x63, 0x65, 0x22, 0x22, 0x3a, 0x7b, 0x22, 0x6d, 0x6f, 0x6e, 0x74, 0x68, 0x22, 0x3a, 0x34, 0x2c,
+	0x22, 0x64, 0x61, 0x79, 0x22, 0x3a, 0x33, 0x30, 0x7d, 0x7d, 0x5d, 0x2c, 0x22, 0x70, 0x75, 0x62,
+	0x6c, 0x69, 0x63, 0x7d, 0x2c, 0x7b, 0x22, 0x73, 0x65, 0x61, 0x73, 0x6f, 0x6e, 0x22, 0x3a, 0x22,
+	0x6c, 0x6f, 0x77, 0x22, 0x2c, 0x22, 0x70, 0x72, 0x69, 0x63, 0x65, 0x22, 0x3a, 0x2c, 0x22, 0x63,
+	0x6f, 0x75, 0x6e, 0x74, 0x22, 0x3a, 0x2d, 0x31, 0x7d, 0x5d, 0x7d, 0x7d, 0x2c, 0x30, 0x2c, 0x30,
+	0x2c, 0x31, 0x2c, 0x31, 0x5d, 0x2c, 0x22, 0x6c, 0x61, 0x74, 0x22, 0x3a, 0x5b, 0x30, 0x2c, 0x30,
+	0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x31, 0x2c, 0x30, 0x5d,
+	0x2c, 0x22, 0x6c, 0x61, 0x74, 0x22, 0x3a, 0x5b, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c,
+	0x30, 0x2c, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64,
+	0x72, 0x22, 0x3a, 0x32, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62,
+	0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x2c, 0x22,
+	0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c,
+	0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x39, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a,
+	0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22,
+	0x3a, 0x38, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73,
+	0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x37, 0x2c, 0x22, 0x73, 0x72,
+	0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61,
+	0x64, 0x64, 0x72, 0x22, 0x3a, 0x36, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c,
+	0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x35,
+	0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a,
+	0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x34, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74,
+	0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64,
+	0x72, 0x22, 0x3a, 0x33, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x61, 0x79, 0x73, 0x22,
+	0x3a, 0x5b, 0x7b, 0x22, 0x64, 0x61, 0x79, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x6d, 0x6f, 0x6e, 0x74,
+	0x68, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x79, 0x65, 0x61, 0x72, 0x22, 0x3a, 0x22, 0x74, 0x79, 0x70,
+	0x65, 0x22, 0x3a, 0x32, 0x2c, 0x22, 0x64, 0x61, 0x74, 0x61, 0x22, 0x3a, 0x7b, 0x22, 0x73, 0x61,
+	0x6d, 0x70, 0x6c, 0x65, 0x5f, 0x70, 0x65, 0x72, 0x69, 0x6f, 0x64, 0x22, 0x72, 0x69, 0x6f, 0x64,
+	0x22, 0x3a, 0x36, 0x30, 0x2c, 0x22, 0x6d, 0x6f, 0x64, 0x65, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x65,
+	0x6e, 0x63, 0x6f, 0x64, 0x69, 0x6e, 0x67, 0x22, 0x3a, 0x30, 0x7d, 0x7d, 0x2c, 0x33, 0x2c, 0x30,
+	0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x5d, 0x7d, 0x2c, 0x7b, 0x22, 0x6d, 0x6f, 0x64,
+	0x75, 0x6c, 0x65, 0x5f, 0x69, 0x64, 0x22, 0x3a, 0x22, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c,
+	0x31, 0x5d, 0x2c, 0x22, 0x6c, 0x61, 0x74, 0x22, 0x3a, 0x5b, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c,
+	0x30, 0x2c, 0x30, 0x2c, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61,
+	0x64, 0x64, 0x72, 0x22, 0x3a, 0x32, 0x30, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22,
+	0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a,
+	0x31, 0x39, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73,
+	0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x38, 0x2c, 0x22, 0x73,
+	0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22,
+	0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x37, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a,
+	0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22,
+	0x3a, 0x31, 0x36, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75,
+	0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x35, 0x2c, 0x22,
+	0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c,
+	0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x34, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22,
+	0x3a, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72,
+	0x22, 0x3a, 0x31, 0x33, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x62,
+	0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x32, 0x2c,
+	0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x6d, 0x6f, 0x6e, 0x74, 0x68, 0x22, 0x3a, 0x38,
+	0x2c, 0x22, 0x64, 0x61, 0x79, 0x22, 0x3a, 0x31, 0x7d, 0x2c, 0x22, 0x65, 0x6e, 0x64, 0x5f, 0x64,
+	0x61, 0x74, 0x65, 0x22, 0x3a, 0x7b, 0x22, 0x22, 0x3a, 0x37, 0x2c, 0x22, 0x64, 0x61, 0x79, 0x22,
+	0x3a, 0x33, 0x31, 0x7d, 0x7d, 0x2c, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a, 0x22, 0x6c,
+	0x6f, 0x77, 0x22, 0x2c, 0x22, 0x73, 0x74, 0x22, 0x3a, 0x30, 0x7d, 0x5d, 0x2c, 0x22, 0x74, 0x6f,
+	0x75, 0x5f, 0x70, 0x72, 0x69, 0x63, 0x65, 0x73, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x73, 0x65, 0x61,
+	0x73, 0x6f, 0x6e, 0x22, 0x3a, 0x22, 0x68, 0x2c, 0x22, 0x74, 0x72, 0x65, 0x61, 0x74, 0x5f, 0x61,
+	0x73, 0x22, 0x3a, 0x30, 0x7d, 0x2c, 0x7b, 0x22, 0x64, 0x61, 0x79, 0x22, 0x3a, 0x32, 0x37, 0x2c,
+	0x22, 0x6d, 0x6f, 0x6e, 0x74, 0x68, 0x22, 0x22, 0x3a, 0x36, 0x2c, 0x22, 0x65, 0x6e, 0x64, 0x22,
+	0x3a, 0x39, 0x7d, 0x2c, 0x7b, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x31, 0x37, 0x2c,
+	0x22, 0x65, 0x6e, 0x64, 0x22, 0x3a, 0x31, 0x22, 0x3a, 0x33, 0x30, 0x7d, 0x7d, 0x5d, 0x2c, 0x22,
+	0x70, 0x75, 0x62, 0x6c, 0x69, 0x63, 0x5f, 0x68, 0x6f, 0x6c, 0x69, 0x64, 0x61, 0x79, 0x73, 0x22,
+	0x3a, 0x5b, 0x7b, 0x22, 0x64, 0x61, 0x79, 0x22, 0x2c, 0x22, 0x73, 0x74, 0x61, 0x72, 0x74, 0x5f,
+	0x64, 0x61, 0x74, 0x65, 0x22, 0x3a, 0x7b, 0x22, 0x6d, 0x6f, 0x6e, 0x74, 0x68, 0x22, 0x3a, 0x35,
+	0x2c, 0x22, 0x64, 0x61, 0x79, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x64, 0x61, 0x79, 0x73, 0x22, 0x3a,
+	0x5b, 0x31, 0x2c, 0x32, 0x2c, 0x33, 0x2c, 0x34, 0x2c, 0x35, 0x5d, 0x2c, 0x22, 0x74, 0x69, 0x6d,
+	0x65, 0x73, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x61, 0x74, 0x61, 0x22, 0x3a, 0x7b, 0x22, 0x73, 0x65,
+	0x61, 0x73, 0x6f, 0x6e, 0x73, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x6e, 0x61, 0x6d, 0x65, 0x22, 0x3a,
+	0x22, 0x68, 0x69, 0x67, 0x68, 0x22, 0x2c, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x73, 0x65, 0x72, 0x69,
+	0x61, 0x6c, 0x69, 0x7a, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x5f, 0x70, 0x65, 0x72, 0x69, 0x6f, 0x64,
+	0x22, 0x3a, 0x36, 0x30, 0x2c, 0x22, 0x6d, 0x61, 0x74, 0x61, 0x22, 0x3a, 0x7b, 0x22, 0x61, 0x63,
+	0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x73, 0x63, 0x68, 0x65, 0x64, 0x75, 0x6c,
+	0x65, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x6d, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x5f, 0x68, 0x65, 0x61,
+	0x6c, 0x74, 0x68, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x6d, 0x6f, 0x64, 0x75, 0x6c, 0x65, 0x5f, 0x69,
+	0x64, 0x22, 0x3a, 0x22, 0x22, 0x3a, 0x30, 0x2c, 0x22, 0x72, 0x75, 0x6c, 0x65, 0x73, 0x22, 0x3a,
+	0x5b, 0x5d, 0x7d, 0x2c, 0x22, 0x6d, 0x6f, 0x64, 0x75, 0x6c, 0x65, 0x5f, 0x72, 0x75, 0x6c, 0x65,
+	0x73, 0x22, 0x3a, 0x5b, 0x7d, 0x5d, 0x7d, 0x2c, 0x7b, 0x22, 0x6d, 0x6f, 0x64, 0x75, 0x6c, 0x65,
+	0x5f, 0x69, 0x64, 0x22, 0x3a, 0x22, 0x34, 0x2c, 0x22, 0x65, 0x78, 0x70, 0x72, 0x65, 0x73, 0x73,
+	0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x22, 0x28, 0x70, 0x6f, 0x77, 0x65, 0x72, 0x5f, 0x66, 0x61, 0x63,
+	0x74, 0x6f, 0x72, 0x20, 0x3c, 0x20, 0x22, 0x2c, 0x22, 0x62, 0x75, 0x73, 0x22, 0x3a, 0x32, 0x2c,
+	0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x31, 0x2c, 0x22, 0x73, 0x72, 0x74, 0x74, 0x22,
+	0x3a, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x72, 0x75, 0x6c, 0x65, 0x73,
+	0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x70, 0x72, 0x69, 0x6f, 0x72, 0x69, 0x74, 0x79, 0x22, 0x3a, 0x34,
+	0x2c, 0x22, 0x2c, 0x22, 0x63, 0x6f, 0x6d, 0x6d, 0x61, 0x6e, 0x64, 0x22, 0x3a, 0x22, 0x73, 0x65,
+	0x74, 0x5f, 0x72, 0x65, 0x6c, 0x61, 0x79, 0x28, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x22, 0x7d,
+	0x5d, 0x20, 0x26, 0x26, 0x20, 0x28, 0x73, 0x77, 0x69, 0x74, 0x63, 0x68, 0x5f, 0x73, 0x74, 0x61,
+	0x74, 0x75, 0x73, 0x20, 0x3d, 0x3d, 0x20, 0x74, 0x72, 0x75, 0x65, 0x29, 0x22, 0x2c, 0x22, 0x63,
+	0x6f, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x5d, 0x2c, 0x22, 0x6c, 0x61, 0x74, 0x22,
+	0x3a, 0x5b, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x30, 0x2c, 0x22, 0x2c, 0x22, 0x62,
+	0x75, 0x73, 0x22, 0x3a, 0x31, 0x2c, 0x22, 0x61, 0x64, 0x64, 0x72, 0x22, 0x3a, 0x31, 0x30, 0x2c,
+	0x22, 0x73, 0x72, 0x74, 0x74, 0x22, 0x3a, 0x22, 0x3a, 0x7b, 0x22, 0x75, 0x6e, 0x69, 0x74, 0x5f,
+	0x72, 0x75, 0x6c, 0x65, 0x73, 0x22, 0x3a, 0x7b, 0x22, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x22,
+	0x3a, 0x30, 0x2c, 0x22, 0x72, 0x75, 0x6c, 0x22, 0x74, 0x79, 0x70, 0x65, 0x22, 0x3a, 0x31, 0x2c,
+	0x22, 0x64, 0x61, 0x74, 0x61, 0x22, 0x3a, 0x7b, 0x22, 0x70, 0x65, 0x72, 0x69, 0x6f, 0x64, 0x5f,
+	0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x3a, 0x2c, 0x22, 0x6b, 0x77, 0x68, 0x5f, 0x74, 0x6f, 0x74,
+	0x61, 0x6c, 0x22, 0x3a, 0x2c, 0x22, 0x6b, 0x77, 0x68, 0x5f, 0x74, 0x6f, 0x64, 0x61, 0x79, 0x22,
+	0x3a, 0x2c, 0x22, 0x70, 0x65, 0x72, 0x69, 0x6f, 0x64, 0x5f, 0x65, 0x6e, 0x64, 0x22, 0x3a, 0x5d,
+	0x2c, 0x22, 0x73, 0x74, 0x61, 0x74, 0x65, 0x5f, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x22,
+	0x3a, 0x5b, 0x5d, 0x7d, 0x5d, 0x7d, 0x7d, 0x5f, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x73, 0x22,
+	0x3a, 0x5b, 0x7b, 0x22, 0x73, 0x74, 0x61, 0x74, 0x65, 0x22, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65,
+	0x2c, 0x22, 0x74, 0x69, 0x6d, 0x65, 0x73, 0x2c, 0x22, 0x6d, 0x65, 0x61, 0x6e, 0x5f, 0x76, 0x6f,
+	0x6c, 0x74, 0x61, 0x67, 0x65, 0x22, 0x3a, 0x2c, 0x22, 0x6d, 0x65, 0x61, 0x6e, 0x5f, 0x66, 0x72,
+	0x65, 0x71, 0x75, 0x65, 0x6e, 0x63, 0x79, 0x22, 0x3a, 0x5d, 0x2c, 0x22, 0x70, 0x6f, 0x77, 0x65,
+	0x72, 0x5f, 0x66, 0x61, 0x63, 0x74, 0x6f, 0x72, 0x22, 0x3a, 0x5b, 0x2c, 0x22, 0x61, 0x70, 0x70,
+	0x61, 0x72, 0x65, 0x6e, 0x74, 0x5f, 0x70, 0x6f, 0x77, 0x65, 0x72, 0x22, 0x3a, 0x5b, 0x2c, 0x22,
+	0x72, 0x65, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x73, 0x22, 0x3a, 0x5b, 0x7b, 0x22, 0x6d, 0x6f, 0x64,
+	0x75, 0x6c, 0x65, 0x5f, 0x69, 0x64, 0x22, 0x3a, 0x22, 0x67, 0x65, 0x73, 0x22, 0x3a, 0x5b, 0x7b,
+	0x22, 0x73, 0x74, 0x61, 0x74, 0x65, 0x22, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x22, 0x74, 0x69,
+	0x6d, 0x65, 0x73, 0x74, 0x61, 0x6d, 0x70, 0x22, 0x3a, 0x22, 0x2c, 0x22, 0x73, 0x61, 0x6d, 0x70,
+	0x6c, 0x65, 0x5f, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x22, 0x3a, 0x36, 0x30, 0x2c, 0x22, 0x6b, 0x77,
+	0x68, 0x5f, 0x75, 0x73, 0x61, 0x67, 0x65, 0x22, 0x3a, 0x74, 0x61, 0x74, 0x65, 0x5f, 0x63, 0x68,
+	0x61, 0x6e, 0x67, 0x65, 0x73, 0x22, 0x3a, 0x5b, 0x5d, 0x7d, 0x2c, 0x7b, 0x22, 0x6d, 0x6f, 0x64,
+	0x75, 0x6c, 0x65, 0x5f, 0x69, 0x64, 0x22, 0x3a, 0x22, 0x7b, 0x22, 0x74, 0x79, 0x70, 0x65, 0x22,
+	0x3a, 0x30, 0x2c, 0x22, 0x64, 0x61, 0x74, 0x61, 0x22, 0x3a, 0x7b, 0x22, 0x70, 0x65, 0x72, 0x69,
+	0x6f, 0x64, 0x5f, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22,
+};
+
+#endif
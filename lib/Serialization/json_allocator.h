@@ -7,9 +7,17 @@
 #include <ArduinoJson.h>
 #include <ps_stl.h>
 
+#include "JsonPool.h"
 
+
+/**
+ * @brief Allocates documents from the JSON pool's arenas, falling back to the PSRAM heap.
+ */
 struct JsonPSRAMAllocator {
     void* allocate(size_t n) {
+        void* arena = json_pool::acquire(n);
+        if (arena != nullptr) return arena;
+
 #ifdef BOARD_HAS_PSRAM
         return heap_caps_malloc(n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
 #else
@@ -18,6 +26,8 @@ struct JsonPSRAMAllocator {
     }
 
     void deallocate(void* p) {
+        if (json_pool::release(p)) return;
+
 #ifdef BOARD_HAS_PSRAM
         heap_caps_free(p);
 #else
@@ -26,6 +36,15 @@ struct JsonPSRAMAllocator {
     }
 
     void* reallocate(void* p, size_t n) {
+        size_t arena_size = json_pool::arenaSize(p);
+        if (arena_size >= n) return p; // Shrinking within the arena.
+        if (arena_size > 0) {
+            void* moved = allocate(n);
+            if (moved != nullptr) memcpy(moved, p, arena_size);
+            deallocate(p);
+            return moved;
+        }
+
 #ifdef BOARD_HAS_PSRAM
         return heap_caps_realloc(p, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
 #else
@@ -0,0 +1,131 @@
+#include "EnergyStore.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <algorithm>
+
+ps::string EnergyStore::slot_path(uint8_t slot_number) {
+    char path[16];
+    snprintf(path, sizeof(path), "/energy_%u.bin", slot_number);
+    return ps::string(path);
+}
+
+uint32_t EnergyStore::checksum(const EnergyCheckpointHeader& header, const ps::vector<EnergyRecord>& records) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*) &header.sequence, sizeof(header.sequence) + sizeof(header.count));
+    return esp_rom_crc32_le(crc, (const uint8_t*) records.data(), records.size() * sizeof(EnergyRecord));
+}
+
+/**
+ * @brief Find the newest valid checkpoint in the slots and hold its counters, to be restored as the modules are adopted.
+ */
+void EnergyStore::begin() {
+    bool found = false;
+
+    for (uint8_t i = 0; i < ENERGY_STORE_SLOTS; i++) {
+        auto file = LittleFS.open(slot_path(i).c_str(), FILE_READ);
+        if (!file) continue;
+
+        EnergyCheckpointHeader header;
+        if (file.read((uint8_t*) &header, sizeof(header)) != sizeof(header) || header.magic != ENERGY_STORE_MAGIC ||
+            header.count > (file.size() - sizeof(header)) / sizeof(EnergyRecord)) {
+            file.close();
+            continue;
+        }
+
+        ps::vector<EnergyRecord> slot_records(header.count);
+        size_t length = header.count * sizeof(EnergyRecord);
+        bool valid = file.read((uint8_t*) slot_records.data(), length) == length && checksum(header, slot_records) == header.crc;
+        file.close();
+
+        if (!valid) {
+            ESP_LOGE("EnergyStore", "Discarding corrupt checkpoint in slot %u.", i);
+            continue;
+        }
+
+        if (!found || header.sequence > sequence) {
+            records = std::move(slot_records);
+            sequence = header.sequence;
+            slot = i;
+            found = true;
+        }
+    }
+
+    if (!found) return;
+
+    for (auto& record : records) record.module_id[sizeof(record.module_id) - 1] = 0;
+    ESP_LOGI("EnergyStore", "Loaded %u energy counters from slot %u (seq %u).", records.size(), slot, sequence);
+}
+
+/**
+ * @brief Restore a newly adopted module's counters from the newest checkpoint, if it holds them.
+ *
+ * @param module
+ */
+void EnergyStore::restore(std::shared_ptr<Module>& module) {
+    for (auto& record : records) {
+        if (module -> getModuleID() != record.module_id) continue;
+
+        module -> energy().restore(record.total_kwh, record.today_kwh, record.day);
+        last_checkpoint_kwh += module -> energy().totalEnergy(); // Restored energy is not new energy to checkpoint.
+        return;
+    }
+}
+
+/**
+ * @brief Write the module energy counters to the next slot, if the checkpoint interval has elapsed and enough energy has accumulated. The
+ * counters of modules not in the list are carried over from the previous checkpoint.
+ *
+ * @param modules
+ * @param force Write regardless of the interval and energy thresholds.
+ * @return true - A checkpoint was written.
+ */
+bool EnergyStore::checkpoint(ps::vector<std::shared_ptr<Module>>& modules, bool force) {
+    double total_kwh = 0;
+    for (auto& module : modules) total_kwh += module -> energy().totalEnergy();
+
+    if (!force) {
+        if (millis() - last_checkpoint < ENERGY_CHECKPOINT_INTERVAL_MS) return false;
+        if (total_kwh - last_checkpoint_kwh < ENERGY_CHECKPOINT_MIN_DELTA_KWH) return false;
+    }
+
+    ps::vector<EnergyRecord> merged = records;
+    for (auto& module : modules) {
+        EnergyRecord record = {};
+        strncpy(record.module_id, module -> getModuleID().c_str(), sizeof(record.module_id) - 1);
+        record.total_kwh = module -> energy().totalEnergy();
+        record.today_kwh = module -> energy().todayEnergy();
+        record.day = module -> energy().dayNumber();
+
+        auto saved = std::find_if(merged.begin(), merged.end(), [&](const EnergyRecord& other) {
+            return strcmp(other.module_id, record.module_id) == 0;
+        });
+        if (saved != merged.end()) *saved = record;
+        else merged.push_back(record);
+    }
+
+    EnergyCheckpointHeader header;
+    header.magic = ENERGY_STORE_MAGIC;
+    header.sequence = sequence + 1;
+    header.count = merged.size();
+    header.crc = checksum(header, merged);
+
+    uint8_t next_slot = (slot + 1) % ENERGY_STORE_SLOTS;
+    auto file = LittleFS.open(slot_path(next_slot).c_str(), FILE_WRITE, true);
+    if (!file) {
+        ESP_LOGE("EnergyStore", "Failed to open slot %u.", next_slot);
+        return false;
+    }
+
+    file.write((const uint8_t*) &header, sizeof(header));
+    file.write((const uint8_t*) merged.data(), merged.size() * sizeof(EnergyRecord));
+    file.flush();
+    file.close();
+
+    records = std::move(merged);
+    sequence = header.sequence;
+    slot = next_slot;
+    last_checkpoint = millis();
+    last_checkpoint_kwh = total_kwh;
+
+    ESP_LOGI("EnergyStore", "Checkpointed %u energy counters to slot %u (seq %u).", records.size(), slot, sequence);
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef ENERGY_STORE_H
+#define ENERGY_STORE_H
+
+#include <Arduino.h>
+#include <ps_stl.h>
+
+#include "Module.h"
+
+#define ENERGY_STORE_SLOTS 4 // Number of checkpoint files rotated through.
+#define ENERGY_CHECKPOINT_INTERVAL_MS (15 * 60 * 1000) // Minimum time between checkpoints.
+#define ENERGY_CHECKPOINT_MIN_DELTA_KWH 0.01 // Minimum unsaved energy before a checkpoint is written.
+#define ENERGY_STORE_MAGIC 0x4E524731 // "NRG1"
+
+struct EnergyRecord {
+    char module_id[38];
+    double total_kwh;
+    double today_kwh;
+    int32_t day;
+} __attribute__ ((packed));
+
+struct EnergyCheckpointHeader {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t count;
+    uint32_t crc;
+} __attribute__ ((packed));
+
+/**
+ * @brief Checkpoints the cumulative module energy counters to flash. Checkpoints are written at most once per `ENERGY_CHECKPOINT_INTERVAL_MS`,
+ * and only once enough energy has accumulated. Each checkpoint goes to the next of `ENERGY_STORE_SLOTS` files so that writes are spread over
+ * the slots, and a torn write never destroys the last good checkpoint.
+ *
+ * The newest checkpoint is held in RAM. Each module's counters are restored from it when the module is adopted, and a checkpoint keeps the
+ * counters of modules that are not connected, so they are not lost while a module is unplugged or not yet found.
+ *
+ * @note Expects the filesystem to be mounted before use.
+ */
+class EnergyStore {
+    private:
+        uint32_t sequence = 0;
+        uint8_t slot = 0;
+        uint64_t last_checkpoint = 0;
+        double last_checkpoint_kwh = 0;
+        ps::vector<EnergyRecord> records; // Of the newest checkpoint.
+
+        ps::string slot_path(uint8_t slot_number);
+        uint32_t checksum(const EnergyCheckpointHeader& header, const ps::vector<EnergyRecord>& records);
+
+    public:
+        void begin();
+        void restore(std::shared_ptr<Module>& module);
+        bool checkpoint(ps::vector<std::shared_ptr<Module>>& modules, bool force = false);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "EnergyIntegrator.h"
+
+#define US_PER_HOUR 3600000000.0
+
+/**
+ * @brief Add a new active power sample. The energy between this sample and the previous one is integrated with the trapezoidal rule, unless the
+ * interval exceeds the maximum gap, in which case it is counted as gap time and integration restarts from this sample.
+ *
+ * @param monotonic_us Monotonic timestamp of the sample in microseconds.
+ * @param active_power_w Active power in watts.
+ * @param day_number Local day number of the sample (e.g. days since epoch), used to reset the daily counter.
+ */
+void EnergyIntegrator::addSample(uint64_t monotonic_us, double active_power_w, int32_t day_number) {
+    if (day_number != day) {
+        today_kwh = 0;
+        day = day_number;
+    }
+
+    if (has_sample && monotonic_us > last_sample_us) {
+        uint64_t dt = monotonic_us - last_sample_us;
+
+        if (dt <= max_gap_us) {
+            double kwh = ((last_power + active_power_w) / 2) * (dt / US_PER_HOUR) / 1000;
+            total_kwh += kwh;
+            today_kwh += kwh;
+            period_kwh += kwh;
+        } else {
+            period_gap_s += dt / 1000000;
+        }
+    }
+
+    last_sample_us = monotonic_us;
+    last_power = active_power_w;
+    has_sample = true;
+}
+
+/**
+ * @brief Restore the cumulative counters from a checkpoint. The daily counter is discarded if the checkpoint was taken on another day.
+ *
+ * @param total Lifetime energy in kWh.
+ * @param today Energy used on the checkpoint day in kWh.
+ * @param day_number The day the checkpoint was taken on.
+ */
+void EnergyIntegrator::restore(double total, double today, int32_t day_number) {
+    total_kwh = total;
+    today_kwh = today;
+    day = day_number;
+}
+
+/**
+ * @brief Get the energy integrated since the last call, then reset the period counter.
+ *
+ * @return double Energy in kWh.
+ */
+double EnergyIntegrator::takePeriodEnergy() {
+    double ret = period_kwh;
+    period_kwh = 0;
+    return ret;
+}
+
+/**
+ * @brief Get the number of seconds which could not be integrated since the last call, then reset the counter.
+ *
+ * @return uint32_t Gap time in seconds.
+ */
+uint32_t EnergyIntegrator::takePeriodGap() {
+    uint32_t ret = period_gap_s;
+    period_gap_s = 0;
+    return ret;
+}
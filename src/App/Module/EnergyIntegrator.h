@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef ENERGY_INTEGRATOR_H
+#define ENERGY_INTEGRATOR_H
+
+#include <stdint.h>
+
+/**
+ * @brief The longest interval between two power samples which will still be integrated. Longer intervals are treated as a gap in the data.
+ */
+#define ENERGY_MAX_GAP_US (300ULL * 1000000ULL)
+
+/**
+ * @brief Integrates timestamped active power samples into cumulative kWh counters using the trapezoidal rule. Missed polls are bridged by the
+ * trapezoid between the surrounding samples, while intervals longer than the maximum gap are not integrated and are instead reported as gap time.
+ *
+ */
+class EnergyIntegrator {
+    private:
+        uint64_t max_gap_us;
+        uint64_t last_sample_us = 0;
+        double last_power = 0;
+        bool has_sample = false;
+
+        double total_kwh = 0;
+        double today_kwh = 0;
+        double period_kwh = 0;
+        int32_t day = -1;
+        uint32_t period_gap_s = 0;
+
+    public:
+        EnergyIntegrator(uint64_t max_gap = ENERGY_MAX_GAP_US) : max_gap_us(max_gap) {}
+
+        void addSample(uint64_t monotonic_us, double active_power_w, int32_t day_number);
+        void restore(double total, double today, int32_t day_number);
+
+        double takePeriodEnergy();
+        uint32_t takePeriodGap();
+
+        double periodEnergy() const { return period_kwh; }
+        uint32_t periodGap() const { return period_gap_s; }
+        double totalEnergy() const { return total_kwh; }
+        double todayEnergy() const { return today_kwh; }
+        int32_t dayNumber() const { return day; }
+};
+
+#endif
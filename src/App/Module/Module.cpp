@@ -1,5 +1,6 @@
 #include "Module.h"
 #include <time.h>
+#include <algorithm>
 
 uint64_t Module::getTime() {
     struct tm timeinfo;
@@ -16,74 +17,143 @@ uint64_t Module::getTime() {
  * @return false if failed to get time or reading, true if successful.
 */
 bool Module::refresh() {
-    auto now = getTime();
-    if (now == 0) return false;
+    if (interface -> supportsBatch(slave_address)) {
+        ps::vector<BatchEntry> batch;
+        if (!interface -> getBatch(slave_address, batch)) return false;
+        uint64_t received_us = esp_timer_get_time();
+
+        for (auto& entry : batch) {
+            ReadingDataPacket data = entry.reading;
+            addReading(data, received_us - (uint64_t) entry.age_ms * 1000);
+        }
+        return true;
+    }
 
     auto data = interface -> getReading(slave_address);
     if (data.voltage == -1) return false;
 
-    Reading new_reading(data, (uint64_t) now);
+    return addReading(data, esp_timer_get_time());
+}
 
-    readings.push_front(new_reading);
-    new_readings++;
+/**
+ * @brief Adds a reading taken from the meter module, e.g. by a bus worker, and publishes the change in contribution to the unit.
+ * 
+ * @param data The reading received from the module.
+ * @param monotonic_us The esp_timer_get_time() at which the reading was received.
+ * @return false if failed to get time, true if successful.
+ */
+bool Module::addReading(ReadingDataPacket& data, uint64_t monotonic_us) {
+    auto now = getTime();
+    if (now == 0) return false;
 
-    if (readings.size() > 300) readings.pop_back();
+    uint64_t age_s = (esp_timer_get_time() - monotonic_us) / 1000000; // Batched readings were taken before they were received.
+    Reading new_reading(data, (uint64_t) now - age_s);
+
+    { // Integrate the active power into the energy counters, keyed on the local day for the daily counter.
+        time_t epoch = (time_t) now;
+        struct tm timeinfo;
+        localtime_r(&epoch, &timeinfo);
+        energy_integrator.addSample(monotonic_us, new_reading.active_power(), timeinfo.tm_year * 1000 + timeinfo.tm_yday);
+    }
+
+    readings.push_front(new_reading);
+    if (readings.size() > max_readings()) readings.pop_back();
+    if (new_readings < readings.size()) new_readings++;
+
+    ModuleContribution next = contribution;
+    next.apparent_power = new_reading.apparent_power;
+    next.active_power = new_reading.active_power();
+    next.reactive_power = new_reading.reactive_power();
+    next.voltage = new_reading.voltage;
+    next.frequency = new_reading.frequency;
+    next.current = new_reading.current;
+    next.power_factor = new_reading.power_factor;
+    publish_contribution(next);
 
     return true;
 }
 
 /**
- * @brief Serializes the readings into the provided array. Automatically appends a new object to the array.
+ * @brief Get the most readings held, sized from the module's sample rate: `BATCH_SAMPLE_HZ` when it is batch read, otherwise at most one
+ * per second, as the sample period is in whole seconds.
+ *
+ * @return size_t
+ */
+size_t Module::max_readings() {
+    size_t rate_hz = (interface && interface -> supportsBatch(slave_address)) ? BATCH_SAMPLE_HZ : 1;
+    return READING_DEQUE_SIZE + READING_BUFFER_SECONDS * rate_hz;
+}
+
+/**
+ * @brief Drop the readings already summarized, beyond the last `READING_DEQUE_SIZE`, as they are not needed again.
+ */
+void Module::trim_readings() {
+    while (readings.size() > READING_DEQUE_SIZE + new_readings) readings.pop_back();
+}
+
+/**
+ * @brief Summarizes the readings taken since the last serialization.
  * 
- * @return bool true - If serialization was successful, or the class is empty, else false.
+ * @return ReadingSummary 
  */
-bool Module::serialize(JsonObject& obj) {
+ReadingSummary Module::summarize() {
     // Fetch all the new readings.
     ps::deque<Reading> new_reading_deque;
+    size_t count = std::min<size_t>(new_readings, readings.size());
     auto it = readings.cbegin();
-    for (uint16_t i = 0; i < new_readings; i++, it++) {
+    for (size_t i = 0; i < count; i++, it++) {
         new_reading_deque.push_back(*it);
     }
 
-    obj[JSON_MODULE_UID].set(module_id.c_str());
-    obj[JSON_READING_COUNT].set(new_reading_deque.size());
+    // Features are rounded to the meter's float precision, so that MessagePack can encode them as 4 byte floats.
+    ReadingSummary summary;
+    summary.sample_count = new_reading_deque.size();
+    summary.voltage = (float) calc_mean<double>(&Reading::voltage, new_reading_deque);
+    summary.frequency = (float) calc_mean<double>(&Reading::frequency, new_reading_deque);
+
+    auto apparent_power = get_summary(&Reading::apparent_power, new_reading_deque);
+    summary.apparent_power[0] = (float) std::get<0>(apparent_power); // Mean
+    summary.apparent_power[1] = (float) std::get<1>(apparent_power); // Maximum
+    summary.apparent_power[2] = (float) std::get<2>(apparent_power); // IQR
+    summary.apparent_power[3] = (!isnan(std::get<3>(apparent_power))) ? (float) std::get<3>(apparent_power) : 0.0f; // Kurtosis
+
+    auto power_factor = get_summary(&Reading::power_factor, new_reading_deque);
+    summary.power_factor[0] = (float) std::get<0>(power_factor); // Mean
+    summary.power_factor[1] = (float) std::get<1>(power_factor); // Maximum
+    summary.power_factor[2] = (float) std::get<2>(power_factor); // IQR
+    summary.power_factor[3] = (!isnan(std::get<3>(power_factor))) ? (float) std::get<3>(power_factor) : 0.0f; // Kurtosis
+
+    return summary;
+}
 
-    { // Sum the kWh Usage readings.
-        double kwh_usage = 0;
-        for (auto reading : new_reading_deque) {
-            kwh_usage += reading.kwh_usage;
-        }
-        obj[JSON_KWH_USAGE].set(kwh_usage);
-    }
+/**
+ * @brief Writes a summary, the energy counters and the new state changes into the object, and marks the readings as sent.
+ * 
+ * @param obj 
+ * @param summary 
+ */
+void Module::write_summary(JsonObject& obj, const ReadingSummary& summary) {
+    obj[JSON_MODULE_UID].set(module_id.c_str());
+    obj[JSON_READING_COUNT].set(summary.sample_count);
+    if (skipped_periods > 0) obj[JSON_SKIPPED_PERIODS].set(skipped_periods);
 
+    { // Load the integrated energy counters.
+        obj[JSON_KWH_USAGE].set(energy_integrator.takePeriodEnergy());
+        obj[JSON_KWH_TODAY].set(energy_integrator.todayEnergy());
+        obj[JSON_KWH_TOTAL].set(energy_integrator.totalEnergy());
 
-    // Load the mean voltage
-    obj[JSON_VOLTAGE].set(calc_mean<double>(&Reading::voltage, new_reading_deque));
-    
-    // Load the mean frequency
-    obj[JSON_FREQUENCY].set(calc_mean<double>(&Reading::frequency, new_reading_deque));
-    
-    { // Load the apparent power features
-        auto apparent_power = get_summary(&Reading::apparent_power, new_reading_deque);
-        auto apparent_arr = obj.createNestedArray(JSON_APPARENT_POWER);
-        apparent_arr.add(std::get<0>(apparent_power)); // Mean
-        apparent_arr.add(std::get<1>(apparent_power)); // Maximum
-        apparent_arr.add(std::get<2>(apparent_power)); // IQR
-
-        auto kurt = std::get<3>(apparent_power);
-        apparent_arr.add((!isnan(kurt)) ? kurt : 0); // Kurtosis 
+        uint32_t gap = energy_integrator.takePeriodGap();
+        if (gap > 0) obj[JSON_KWH_GAP].set(gap);
     }
 
-    { // Load the power factor features
-        auto power_factor = get_summary(&Reading::power_factor, new_reading_deque);
-        auto pf_arr = obj.createNestedArray(JSON_POWER_FACTOR);
-        pf_arr.add(std::get<0>(power_factor)); // Mean
-        pf_arr.add(std::get<1>(power_factor)); // Maximum
-        pf_arr.add(std::get<2>(power_factor)); // IQR
+    obj[JSON_VOLTAGE].set(summary.voltage);
+    obj[JSON_FREQUENCY].set(summary.frequency);
 
-        auto kurt = std::get<3>(power_factor);
-        pf_arr.add((!isnan(kurt)) ? kurt : 0); // Kurtosis 
-    }
+    auto apparent_arr = obj.createNestedArray(JSON_APPARENT_POWER);
+    for (float feature : summary.apparent_power) apparent_arr.add(feature);
+
+    auto pf_arr = obj.createNestedArray(JSON_POWER_FACTOR);
+    for (float feature : summary.power_factor) pf_arr.add(feature);
    
     { // Serialize state changes.
         JsonArray state_changes_array = obj.createNestedArray("state_changes");
@@ -98,6 +168,68 @@ bool Module::serialize(JsonObject& obj) {
     }
 
     new_readings = 0;
+    trim_readings();
+    skipped_periods = 0;
+    last_sent = summary;
+    sent = true;
+}
+
+/**
+ * @brief Checks whether a summary is within the deadbands of the last summary sent.
+ * 
+ * @param summary 
+ * @param deadband 
+ * @return true - If the server's copy of the module is still accurate enough.
+ */
+bool Module::within_deadband(const ReadingSummary& summary, const ReadingDeadband& deadband) {
+    if (!sent) return false;
+    if (new_status_changes > 0) return false;
+    if (energy_integrator.periodEnergy() >= deadband.energy || energy_integrator.periodGap() > 0) return false;
+    if (summary.sample_count == 0) return true; // No readings, so nothing has moved.
+
+    if (fabsf(summary.voltage - last_sent.voltage) > deadband.voltage) return false;
+    if (fabsf(summary.frequency - last_sent.frequency) > deadband.frequency) return false;
+
+    // Kurtosis is left out, it moves with noise even under a steady load.
+    for (int i = 0; i < 3; i++) {
+        if (fabsf(summary.apparent_power[i] - last_sent.apparent_power[i]) > deadband.apparent_power) return false;
+        if (fabsf(summary.power_factor[i] - last_sent.power_factor[i]) > deadband.power_factor) return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Serializes the readings into the provided object.
+ * 
+ * @return bool true - If serialization was successful, or the class is empty, else false.
+ */
+bool Module::serialize(JsonObject& obj) {
+    write_summary(obj, summarize());
+    return true;
+}
+
+/**
+ * @brief Serializes the readings as part of a delta frame. The module is only appended to the array if it has state changes, has used
+ * more energy than the energy deadband since it was last sent, or one of its features has moved beyond its deadband. Otherwise the period's
+ * readings are dropped, the energy carries over to the next time the module is sent, and the server keeps the last values it received.
+ * 
+ * @param array The message's reading array.
+ * @param deadband 
+ * @return bool true - If the module was appended to the array.
+ */
+bool Module::serializeDelta(JsonArray& array, const ReadingDeadband& deadband) {
+    ReadingSummary summary = summarize();
+
+    if (within_deadband(summary, deadband)) {
+        new_readings = 0;
+        trim_readings();
+        skipped_periods++;
+        return false;
+    }
+
+    JsonObject obj = array.createNestedObject();
+    write_summary(obj, summary);
     return true;
 }
 
@@ -163,12 +295,18 @@ void Module::load_re_vars() {
     re::RuleEngineBase::mk_var(re::VAR_BOOL, SWITCH_STATUS, std::function<bool()>([this]() { return this->getRelayState(); }));
     re::RuleEngineBase::mk_var(re::VAR_INT, READING_COUNT, std::function<int()>([this](){ return this -> getReadings().size(); }));
     re::RuleEngineBase::mk_var(re::VAR_INT, NEW_READING_COUNT, std::function<int()>([this](){ return this -> new_readings; }));
+    re::RuleEngineBase::mk_var(re::VAR_DOUBLE, KWH_TODAY, std::function<double()>([this]() { return this->energy().todayEnergy(); }));
+    re::RuleEngineBase::mk_var(re::VAR_DOUBLE, KWH_TOTAL, std::function<double()>([this]() { return this->energy().totalEnergy(); }));
 }
 
 const ps::string& Module::getModuleID() {
     return module_id;
 }
 
+const uint16_t& Module::getAddress() {
+    return slave_address;
+}
+
 const int& Module::getModulePriority() {
     return circuit_priority;
 }
@@ -205,11 +343,17 @@ bool Module::setRelayState(bool state) {
     StatusChange new_change;
     new_change.status = state;
     
-    if (!interface -> sendOperation(slave_address, (state) ? OPERATION_RELAY_SET : OPERATION_RELAY_RESET)) return false;
+    uint16_t operation = (state) ? OPERATION_RELAY_SET : OPERATION_RELAY_RESET;
+    bool sent = (bus_worker) ? bus_worker -> operate(slave_address, operation) : interface -> sendOperation(slave_address, operation);
+    if (!sent) return false;
     new_status_changes++;
     new_change.timestamp = getTime();
     status_updates.emplace_front(new_change);
 
+    ModuleContribution next = contribution;
+    next.active = state;
+    publish_contribution(next);
+
     return true;
 }
 
@@ -231,6 +375,43 @@ const ps::deque<Reading>& Module::getReadings() {
     return readings;
 }
 
+/**
+ * @brief Get the module's energy integrator, which holds the cumulative kWh counters.
+ * 
+ * @return EnergyIntegrator& 
+ */
+EnergyIntegrator& Module::energy() {
+    return energy_integrator;
+}
+
+/**
+ * @brief Set the listener which is notified with the (previous, next) contribution whenever this module's share of the unit aggregates changes.
+ * 
+ * @param listener 
+ */
+void Module::setContributionListener(ContributionListener listener) {
+    contribution_listener = listener;
+}
+
+/**
+ * @brief Get this module's current share of the unit aggregates.
+ * 
+ * @return const ModuleContribution& 
+ */
+const ModuleContribution& Module::getContribution() {
+    return contribution;
+}
+
+/**
+ * @brief Replace the current contribution, notifying the listener of the delta.
+ * 
+ * @param next 
+ */
+void Module::publish_contribution(const ModuleContribution& next) {
+    if (contribution_listener) contribution_listener(contribution, next);
+    contribution = next;
+}
+
 /**
  * @brief Check whether the module requires an update.
  * 
@@ -250,3 +431,13 @@ bool& Module::updateRequired() {
 bool& Module::saveRequired() {
     return save_required;
 }
+
+/**
+ * @brief Check whether the module's saved configuration has been loaded, or found missing. Until it has, the module is not saved.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool& Module::configLoaded() {
+    return config_loaded;
+}
@@ -3,19 +3,62 @@
 #ifndef SDR_MODULE_H
 #define SDR_MODULE_H
 
-#define READING_DEQUE_SIZE 15
+#define READING_DEQUE_SIZE 15 // Readings kept once they have been summarized.
+#define READING_BUFFER_SECONDS 120 // Unsent readings held at the module's sample rate while a summary is late. The oldest are dropped beyond.
 
 #include <ArduinoJson.h>
 #include <ps_stl.h>
 
+#include "config.h"
 #include "Persistence.h"
 
 #include "SDRSemantics.h"
 #include "RuleEngineBase.h"
 #include "ModuleInterface.h"
+#include "BusWorker.h"
 
 #include "Reading.h"
 #include "StatusChange.h"
+#include "EnergyIntegrator.h"
+
+/**
+ * @brief The share of the unit aggregates contributed by a single module. Published to the unit as a (previous, next) pair whenever it changes,
+ * so that the unit totals can be maintained without rescanning every module.
+ */
+struct ModuleContribution {
+    double apparent_power = 0;
+    double active_power = 0;
+    double reactive_power = 0;
+    double voltage = 0;
+    double frequency = 0;
+    double current = 0;
+    double power_factor = 0;
+    bool active = false;
+};
+
+typedef std::function<void(const ModuleContribution&, const ModuleContribution&)> ContributionListener;
+
+/**
+ * @brief The features of a module's readings over one serialization period, as sent in a reading message.
+ */
+struct ReadingSummary {
+    uint16_t sample_count = 0;
+    float voltage = 0;
+    float frequency = 0;
+    float apparent_power[4] = {0, 0, 0, 0}; // Mean, maximum, IQR, kurtosis.
+    float power_factor[4] = {0, 0, 0, 0}; // Mean, maximum, IQR, kurtosis.
+};
+
+/**
+ * @brief How far each feature may move from the value last sent before a delta frame includes the module again.
+ */
+struct ReadingDeadband {
+    float voltage = DEFAULT_DEADBAND_VOLTAGE; // V
+    float frequency = DEFAULT_DEADBAND_FREQUENCY; // Hz
+    float apparent_power = DEFAULT_DEADBAND_APPARENT_POWER; // VA, of the mean, maximum and IQR.
+    float power_factor = DEFAULT_DEADBAND_POWER_FACTOR; // Of the mean, maximum and IQR.
+    double energy = DEFAULT_DEADBAND_ENERGY; // kWh used since the module was last sent.
+};
 
 struct ReadingPacket {
     uint8_t status;
@@ -32,10 +75,12 @@ struct ReadingPacket {
 class Module : public re::RuleEngineBase, public std::enable_shared_from_this<Module> {
     private:
     std::shared_ptr<ModuleInterface> interface;
+    std::shared_ptr<BusWorker> bus_worker; // Schedules relay commands ahead of polling, if set.
     std::shared_ptr<re::FunctionStorage> functions;
     uint16_t slave_address;
     bool update_required;
     bool save_required;
+    bool config_loaded = false; // Whether the saved configuration was loaded, or found missing, so saving cannot overwrite it.
 
     ps::deque<Reading> readings;
     
@@ -45,6 +90,19 @@ class Module : public re::RuleEngineBase, public std::enable_shared_from_this<Mo
     ps::string module_id;
     int circuit_priority;
 
+    EnergyIntegrator energy_integrator;
+
+    ReadingSummary last_sent;
+    bool sent = false;
+    uint16_t skipped_periods = 0; // Periods left out of delta frames since the module was last sent.
+    ReadingSummary summarize();
+    void write_summary(JsonObject& obj, const ReadingSummary& summary);
+    bool within_deadband(const ReadingSummary& summary, const ReadingDeadband& deadband);
+
+    ModuleContribution contribution;
+    ContributionListener contribution_listener;
+    void publish_contribution(const ModuleContribution& next);
+
 
     template <typename T>
     const T calc_max(const T Reading::*, const ps::deque<Reading>&) const;
@@ -65,6 +123,8 @@ class Module : public re::RuleEngineBase, public std::enable_shared_from_this<Mo
 
     void load_re_vars();
     uint64_t getTime();
+    size_t max_readings();
+    void trim_readings();
 
     public:
     uint16_t new_readings = 0;
@@ -98,20 +158,29 @@ class Module : public re::RuleEngineBase, public std::enable_shared_from_this<Mo
     bool load(JsonObject&);
     bool save(JsonObject&);
     bool serialize(JsonObject&);
+    bool serializeDelta(JsonArray&, const ReadingDeadband&);
 
     bool refresh();
+    bool addReading(ReadingDataPacket& data, uint64_t monotonic_us);
     bool setRelayState(bool);
     const bool getRelayState();
     const uint64_t getRelayStateChangeTime();
     const ps::deque<StatusChange>& getRelayStateChanges();
 
     const ps::string& getModuleID();
+    const uint16_t& getAddress();
     const int& getModulePriority();
     const Reading& getLatestReading();
     const ps::deque<Reading>& getReadings();
+    EnergyIntegrator& energy();
+
+    void setContributionListener(ContributionListener listener);
+    void setBusWorker(std::shared_ptr<BusWorker> worker) { bus_worker = worker; }
+    const ModuleContribution& getContribution();
 
     bool& updateRequired();
     bool& saveRequired();
+    bool& configLoaded();
 
     template <typename T>
     const T max(const T Reading::* attribute);
@@ -0,0 +1,267 @@
+#include "TariffTable.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <math.h>
+#include <algorithm>
+
+#define TARIFF_DAYS 7
+#define TARIFF_HOURS 24
+
+static bool holiday_before(const TariffHoliday& a, const TariffHoliday& b) {
+    if (a.year != b.year) return a.year < b.year;
+    if (a.month != b.month) return a.month < b.month;
+    return a.day < b.day;
+}
+
+uint32_t TariffTable::checksum(const TariffTableHeader& header) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*) &header.seasons, sizeof(header.seasons) + sizeof(header.holidays));
+    crc = esp_rom_crc32_le(crc, (const uint8_t*) day_seasons, sizeof(day_seasons));
+    crc = esp_rom_crc32_le(crc, (const uint8_t*) holidays.data(), holidays.size() * sizeof(TariffHoliday));
+    return esp_rom_crc32_le(crc, (const uint8_t*) prices.data(), prices.size() * sizeof(double));
+}
+
+/**
+ * @brief Compile a TOU pricing schedule into the tables, replacing the ones held.
+ *
+ * @param schedule The schedule, with its "seasons", "public_holidays", "tou_prices" and "base_prices".
+ * @return true - If the schedule was compiled. Otherwise no prices are held.
+ */
+bool TariffTable::compile(JsonObjectConst schedule) {
+    ready = false;
+
+    ps::vector<ps::string> names = {""}; // The first season is the days outside every season.
+    auto season_list = schedule["seasons"].as<JsonArrayConst>();
+    for (JsonObjectConst season : season_list) {
+        auto name = season["name"].as<ps::string>();
+        if (std::find(names.begin(), names.end(), name) != names.end()) continue;
+
+        if (names.size() == TARIFF_MAX_SEASONS) {
+            ESP_LOGE("Tariff", "More than %u seasons in the schedule.", TARIFF_MAX_SEASONS - 1);
+            return false;
+        }
+        names.push_back(name);
+    }
+    seasons = names.size();
+
+    for (int month = 0; month < 12; month++) {
+        for (int day = 1; day <= 31; day++) {
+            day_seasons[month][day - 1] = 0;
+
+            for (JsonObjectConst season : season_list) {
+                auto start_date = season["start_date"].as<JsonObjectConst>();
+                auto end_date = season["end_date"].as<JsonObjectConst>();
+
+                int start_mo = start_date["month"].as<int>();
+                int end_mo = end_date["month"].as<int>();
+                int start_day = start_date["day"].as<int>();
+                int end_day = end_date["day"].as<int>();
+
+                if ((month > start_mo || (month == start_mo && day >= start_day)) &&
+                    (month < end_mo || (month == end_mo && day <= end_day))) {
+                        auto name = season["name"].as<ps::string>();
+                        day_seasons[month][day - 1] = std::find(names.begin(), names.end(), name) - names.begin();
+                        break;
+                }
+            }
+        }
+    }
+
+    holidays.clear();
+    for (JsonObjectConst holiday : schedule["public_holidays"].as<JsonArrayConst>()) {
+        int treat_as = holiday["treat_as"].as<int>();
+        if (treat_as < 0 || treat_as >= TARIFF_DAYS) {
+            ESP_LOGE("Tariff", "Skipping holiday treated as unknown day %d.", treat_as);
+            continue;
+        }
+
+        if (holidays.size() == TARIFF_MAX_HOLIDAYS) {
+            ESP_LOGE("Tariff", "More than %u public holidays in the schedule, skipping the rest.", TARIFF_MAX_HOLIDAYS);
+            break;
+        }
+
+        holidays.push_back({holiday["year"].as<uint16_t>(), holiday["month"].as<uint8_t>(), holiday["day"].as<uint8_t>(), (uint8_t) treat_as});
+    }
+    std::stable_sort(holidays.begin(), holidays.end(), holiday_before); // Of holidays on the same date, the first listed applies.
+
+    prices.assign(seasons * TARIFF_DAYS * TARIFF_HOURS, NAN);
+    auto tou_prices = schedule["tou_prices"].as<JsonArrayConst>();
+    for (size_t season = 0; season < seasons; season++) {
+        double base = NAN;
+        for (JsonObjectConst base_price : schedule["base_prices"].as<JsonArrayConst>()) {
+            if (base_price["season"].as<ps::string>() == names[season]) {
+                base = base_price["price"].as<double>();
+                break;
+            }
+        }
+
+        for (int day = 0; day < TARIFF_DAYS; day++) {
+            for (int hour = 0; hour < TARIFF_HOURS; hour++) {
+                double price = base;
+
+                for (JsonObjectConst tou_price : tou_prices) { // The first TOU price covering the day and hour applies.
+                    if (tou_price["season"].as<ps::string>() != names[season]) continue;
+
+                    bool covered = false;
+                    for (int listed : tou_price["days"].as<JsonArrayConst>()) covered = covered || listed == day;
+                    if (!covered) continue;
+
+                    covered = false;
+                    for (JsonObjectConst time : tou_price["times"].as<JsonArrayConst>()) {
+                        covered = covered || (time["start"].as<int>() <= hour && time["end"].as<int>() > hour);
+                    }
+
+                    if (covered) {
+                        price = tou_price["price"].as<double>();
+                        break;
+                    }
+                }
+
+                prices[(season * TARIFF_DAYS + day) * TARIFF_HOURS + hour] = price;
+            }
+        }
+    }
+
+    ready = true;
+    ESP_LOGI("Tariff", "Compiled %u seasons and %u public holidays.", seasons - 1, holidays.size());
+    return true;
+}
+
+/**
+ * @brief Load the tables last saved to flash.
+ *
+ * @return true - If valid tables were loaded.
+ */
+bool TariffTable::restore() {
+    ready = false;
+
+    auto file = LittleFS.open(TARIFF_TABLE_PATH, FILE_READ);
+    if (!file) return false;
+
+    TariffTableHeader header;
+    if (file.read((uint8_t*) &header, sizeof(header)) != sizeof(header) || header.magic != TARIFF_TABLE_MAGIC ||
+        header.seasons == 0 || header.seasons > TARIFF_MAX_SEASONS || header.holidays > TARIFF_MAX_HOLIDAYS) {
+        file.close();
+        return false;
+    }
+
+    seasons = header.seasons;
+    holidays.resize(header.holidays);
+    prices.resize(seasons * TARIFF_DAYS * TARIFF_HOURS);
+
+    size_t holidays_length = holidays.size() * sizeof(TariffHoliday);
+    size_t prices_length = prices.size() * sizeof(double);
+    bool valid = file.read((uint8_t*) day_seasons, sizeof(day_seasons)) == sizeof(day_seasons) &&
+                 file.read((uint8_t*) holidays.data(), holidays_length) == holidays_length &&
+                 file.read((uint8_t*) prices.data(), prices_length) == prices_length &&
+                 checksum(header) == header.crc;
+    file.close();
+
+    if (!valid) {
+        ESP_LOGE("Tariff", "Discarding corrupt compiled schedule.");
+        return false;
+    }
+
+    for (auto& row : day_seasons) {
+        for (auto& season : row) season = (season < seasons) ? season : 0;
+    }
+
+    ready = true;
+    return true;
+}
+
+/**
+ * @brief Write the tables to flash, to be restored after a reset without compiling the schedule again.
+ *
+ * @return true - If the tables were written.
+ */
+bool TariffTable::save() {
+    if (!ready) return false;
+
+    TariffTableHeader header;
+    header.magic = TARIFF_TABLE_MAGIC;
+    header.seasons = seasons;
+    header.holidays = holidays.size();
+    header.crc = checksum(header);
+
+    auto file = LittleFS.open(TARIFF_TABLE_PATH, FILE_WRITE, true);
+    if (!file) {
+        ESP_LOGE("Tariff", "Failed to open %s.", TARIFF_TABLE_PATH);
+        return false;
+    }
+
+    file.write((const uint8_t*) &header, sizeof(header));
+    file.write((const uint8_t*) day_seasons, sizeof(day_seasons));
+    file.write((const uint8_t*) holidays.data(), holidays.size() * sizeof(TariffHoliday));
+    file.write((const uint8_t*) prices.data(), prices.size() * sizeof(double));
+    file.flush();
+    file.close();
+    return true;
+}
+
+/**
+ * @brief Get the day of the week whose prices apply on the date, which for a public holiday is the day it is treated as.
+ *
+ * @param timeinfo
+ * @return int 0 - 6, Sunday first.
+ */
+int TariffTable::weekday(const struct tm& timeinfo) const {
+    TariffHoliday date = {(uint16_t) (timeinfo.tm_year + 1900), (uint8_t) timeinfo.tm_mon, (uint8_t) timeinfo.tm_mday, 0};
+    auto holiday = std::lower_bound(holidays.begin(), holidays.end(), date, holiday_before);
+
+    if (holiday != holidays.end() && !holiday_before(date, *holiday)) return holiday -> treat_as;
+    return timeinfo.tm_wday;
+}
+
+double TariffTable::hourly_price(const struct tm& timeinfo) const {
+    uint8_t season = day_seasons[timeinfo.tm_mon][timeinfo.tm_mday - 1];
+    return prices[(season * TARIFF_DAYS + weekday(timeinfo)) * TARIFF_HOURS + timeinfo.tm_hour];
+}
+
+/**
+ * @brief Get the price at the given local time.
+ *
+ * @param timeinfo
+ * @param price Set to the price in the schedule's currency per kWh.
+ * @return true - If the schedule gives a price at the time.
+ */
+bool TariffTable::price(const struct tm& timeinfo, double& price) const {
+    if (!ready) return false;
+
+    double hourly = hourly_price(timeinfo);
+    if (isnan(hourly)) return false;
+
+    price = hourly;
+    return true;
+}
+
+/**
+ * @brief Find the start of the next hour, after the given local time, at which the price differs from the price at that time.
+ *
+ * @param timeinfo
+ * @return uint64_t The epoch time of the change, or 0 if the price holds for `TARIFF_LOOKAHEAD_DAYS`, or no schedule is held.
+ */
+uint64_t TariffTable::nextChange(const struct tm& timeinfo) const {
+    if (!ready) return 0;
+
+    double current = hourly_price(timeinfo);
+    struct tm next = timeinfo;
+    next.tm_min = 0;
+    next.tm_sec = 0;
+
+    for (int hour = 1; hour <= TARIFF_LOOKAHEAD_DAYS * TARIFF_HOURS; hour++) {
+        if (++next.tm_hour == TARIFF_HOURS) { // Let mktime roll the date over, setting the day of the week.
+            next.tm_hour = 0;
+            next.tm_mday++;
+            next.tm_isdst = -1;
+            mktime(&next);
+        }
+
+        double price = hourly_price(next);
+        if (price == current || (isnan(price) && isnan(current))) continue;
+
+        next.tm_isdst = -1;
+        return (uint64_t) mktime(&next);
+    }
+
+    return 0;
+}
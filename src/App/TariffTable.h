@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef TARIFF_TABLE_H
+#define TARIFF_TABLE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <time.h>
+#include <ps_stl.h>
+
+#define TARIFF_TABLE_PATH "/tou.bin" // The compiled schedule, kept beside the JSON schedule in "/tou.txt".
+#define TARIFF_TABLE_MAGIC 0x544F5532 // "TOU2". Tables saved with float prices by "TOU1" are compiled again.
+#define TARIFF_MAX_SEASONS 8 // Distinct season names, plus one for the days outside every season.
+#define TARIFF_MAX_HOLIDAYS 128
+#define TARIFF_LOOKAHEAD_DAYS 366 // How far ahead the next price change is searched for.
+
+struct TariffTableHeader {
+    uint32_t magic;
+    uint32_t seasons;
+    uint32_t holidays;
+    uint32_t crc;
+} __attribute__ ((packed));
+
+struct TariffHoliday {
+    uint16_t year;
+    uint8_t month; // 0 - 11, as in `struct tm`.
+    uint8_t day;
+    uint8_t treat_as; // The day of the week whose prices apply.
+} __attribute__ ((packed));
+
+/**
+ * @brief A TOU pricing schedule compiled into lookup tables: the season of each day of the year, the public holidays sorted by date, and an
+ * hourly price for each season and day of the week. Finding the price at a time reads the tables rather than searching the schedule.
+ *
+ * Compiled with the same rules the schedule was searched with: the first season whose dates contain the day, a holiday taking the prices of
+ * the day of the week it is treated as, the first TOU price of the season covering the day and hour, and otherwise the season's base price.
+ *
+ * @note Expects the filesystem to be mounted before `restore()` or `save()`.
+ */
+class TariffTable {
+    private:
+        uint8_t day_seasons[12][31] = {}; // Season of each day, by month and day of the month - 1.
+        ps::vector<TariffHoliday> holidays; // Sorted by date.
+        ps::vector<double> prices; // By season, day of the week and hour, as given in the schedule. NAN where it gives no price.
+        uint32_t seasons = 0;
+        bool ready = false;
+
+        uint32_t checksum(const TariffTableHeader& header);
+        int weekday(const struct tm& timeinfo) const;
+        double hourly_price(const struct tm& timeinfo) const;
+
+    public:
+        bool compile(JsonObjectConst schedule);
+        bool restore();
+        bool save();
+        bool valid() const { return ready; }
+
+        bool price(const struct tm& timeinfo, double& price) const;
+        uint64_t nextChange(const struct tm& timeinfo) const;
+};
+
+#endif
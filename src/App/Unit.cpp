@@ -18,6 +18,8 @@ void Unit::load_vars() {
     re::RuleEngineBase::mk_var(re::VAR_INT, MODULE_COUNT, std::function<int()>([this]() { return this->moduleCount(); }));
 
     re::RuleEngineBase::mk_var(re::VAR_DOUBLE, KWH_PRICE, std::function<double()>([this]() { return this->getkWhPrice(); }));
+    re::RuleEngineBase::mk_var(re::VAR_UINT64_T, NEXT_PRICE_CHANGE, std::function<uint64_t()>([this]() { return this->nextPriceChange(); }));
+    re::RuleEngineBase::mk_var(re::VAR_DOUBLE, TOTAL_KWH_TODAY, std::function<double()>([this]() { return this->totalEnergyToday(); }));
 }
 
 void Unit::loadUnitVarsInModule(std::shared_ptr<Module>& module) {
@@ -34,27 +36,130 @@ void Unit::loadUnitVarsInModule(std::shared_ptr<Module>& module) {
     module -> mk_var(re::VAR_INT, MODULE_COUNT, std::function<int()>([this]() { return this->moduleCount(); }));  
 
     module -> mk_var(re::VAR_DOUBLE, KWH_PRICE, std::function<double()>([this]() { return this->getkWhPrice(); }));
+    module -> mk_var(re::VAR_UINT64_T, NEXT_PRICE_CHANGE, std::function<uint64_t()>([this]() { return this->nextPriceChange(); }));
+    module -> mk_var(re::VAR_DOUBLE, TOTAL_KWH_TODAY, std::function<double()>([this]() { return this->totalEnergyToday(); }));
 }
 
-void Unit::begin(Stream* stream_1, uint8_t ctrl_1, uint8_t ctrl_2, uint8_t dir_1) {
+/**
+ * @brief Discover the modules on both RS-485 buses, and start a worker task for each bus to poll them.
+ * 
+ */
+void Unit::begin(HardwareSerial* serial_1, uint8_t ctrl_1, uint8_t dir_1, HardwareSerial* serial_2, uint8_t ctrl_2, uint8_t dir_2) {
     number_of_modules = 0;
     load_vars();
-    interface_1 = ps::make_shared<ModuleInterface>(stream_1, ctrl_1, ctrl_2, dir_1);
-    auto found_modules = interface_1 -> begin();
+    energy_store.begin();
 
-    for (auto found_module : found_modules) {
-        ESP_LOGI("Unit", "Found: %s", &found_module.first.id[0]);
-        module_list.push_back(
-            ps::make_shared<Module>(functions, interface_1, found_module.second, ps::string(found_module.first.id), found_module.first.firmware_version, found_module.first.hardware_version)
-        );
-        loadUnitVarsInModule(module_list.back());
-        number_of_modules++;
-    }
+    reading_queue = xQueueCreate(READING_QUEUE_LENGTH, sizeof(BusReading));
+    cycle_group = xEventGroupCreate();
+    discovery_queue = xQueueCreate(DISCOVERY_QUEUE_LENGTH, sizeof(BusDiscovery));
+
+    interface_1 = ps::make_shared<ModuleInterface>(serial_1, ctrl_1, dir_1);
+    interface_2 = ps::make_shared<ModuleInterface>(serial_2, ctrl_2, dir_2);
+
+    worker_1 = ps::make_shared<BusWorker>(0, interface_1, reading_queue, cycle_group, discovery_queue);
+    worker_2 = ps::make_shared<BusWorker>(1, interface_2, reading_queue, cycle_group, discovery_queue);
+
+    discoverBus(worker_1);
+    discoverBus(worker_2);
 
     create_module_map(); 
     last_serialization = getTime();
 }
 
+/**
+ * @brief Address the modules on the worker's bus, create them, then start the worker polling them.
+ * 
+ * @param worker 
+ */
+void Unit::discoverBus(std::shared_ptr<BusWorker>& worker) {
+    auto found_modules = worker -> getInterface() -> begin();
+    ps::vector<uint8_t> addresses;
+
+    for (auto found_module : found_modules) {
+        adopt_module(worker, found_module.first, found_module.second);
+        addresses.push_back(found_module.second);
+    }
+
+    if (!worker -> begin(addresses)) ESP_LOGE("Unit", "Failed to start bus %u worker.", worker -> bus());
+}
+
+/**
+ * @brief Create a module for an addressed device, register it with the unit, and load its saved configuration and energy counters.
+ * 
+ * @param worker The worker of the bus the module is on.
+ * @param announce 
+ * @param address 
+ * @return std::shared_ptr<Module> 
+ */
+std::shared_ptr<Module> Unit::adopt_module(std::shared_ptr<BusWorker>& worker, const AnnouncePacket& announce, uint8_t address) {
+    ESP_LOGI("Unit", "Found: %s on bus %u", &announce.id[0], worker -> bus());
+
+    auto module = ps::make_shared<Module>(functions, worker -> getInterface(), address, ps::string(announce.id), announce.firmware_version, announce.hardware_version);
+    loadUnitVarsInModule(module);
+    module -> setBusWorker(worker);
+    module -> setContributionListener([this](const ModuleContribution& previous, const ModuleContribution& next) {
+        this -> applyContribution(previous, next);
+    });
+
+    module_list.push_back(module);
+    bus_module_map.insert(std::make_pair((uint16_t) ((worker -> bus() << 8) | address), module));
+    number_of_modules++;
+
+    load_module_config(module);
+    energy_store.restore(module);
+    return module;
+}
+
+/**
+ * @brief Adopt the modules the bus workers have found since the last call, and load their saved configuration. Existing modules are not
+ * affected, and keep their readings.
+ * 
+ */
+void Unit::adopt_discovered() {
+    BusDiscovery discovery;
+
+    while (xQueueReceive(discovery_queue, &discovery, 0) == pdTRUE) {
+        auto& worker = (discovery.bus == worker_1 -> bus()) ? worker_1 : worker_2;
+        auto module = adopt_module(worker, discovery.announce, discovery.address);
+
+        module_map.insert(std::make_pair(module -> getModuleID(), module));
+        update_means();
+    }
+}
+
+/**
+ * @brief Load a module's saved rule engine from flash, if it has been connected to this unit before. A module whose saved configuration
+ * cannot be read is left unloaded, so it is never saved over.
+ * 
+ * @param module 
+ */
+void Unit::load_module_config(std::shared_ptr<Module>& module) {
+    if (!store) return;
+
+    ps::string saved;
+    if (!store -> get(STORE_KEY_MODULE + module -> getModuleID(), saved)) {
+        module -> configLoaded() = true; // New to this unit, nothing to load.
+        return;
+    }
+
+    DynamicPSRAMJsonDocument document(8192);
+    auto result = deserializeJson(document, saved.c_str(), saved.size());
+    if (result.code() != 0) {
+        ESP_LOGE("Unit", "Failed to deserialize saved configuration for %s: %s", module -> getModuleID().c_str(), result.c_str());
+        return;
+    }
+
+    JsonObject object = document.as<JsonObject>();
+    if (!module -> load(object)) {
+        ESP_LOGE("Unit", "Saved configuration for %s belongs to another module.", module -> getModuleID().c_str());
+        return;
+    }
+
+    module -> markSaved(module -> version()); // What was just loaded needs no saving.
+    module -> configLoaded() = true;
+    ESP_LOGI("Unit", "Loaded saved configuration for %s.", module -> getModuleID().c_str());
+}
+
 bool Unit::evaluateAll() {
     try {
         RuleEngineBase::reason();
@@ -96,46 +201,145 @@ void Unit::create_module_map() {
 }
 
 /**
- * @brief Calculate the unit class variables, read power status pin, read from all modules, and reason on their data. Finally, count how many modules are on.
- * Finally, evaluates the unit rule engine.
+ * @brief Start a sample cycle on both buses, and ingest the readings into the modules as the workers produce them. A full sample of all
+ * modules takes as long as the slower bus, rather than the sum of both. Both buses latch their readings at the start of the cycle, so the
+ * unit totals are built from a time aligned snapshot. Modules the workers have discovered since the last cycle are adopted first.
+ * 
+ * Each cycle is numbered, so that a timed out cycle which finishes late is not taken for the completion of the current one.
+ * 
+ * @return true - Both buses completed the cycle.
+ * @return false - The cycle timed out, or could not be started on a bus.
+ */
+bool Unit::sample() {
+    adopt_discovered();
+
+    const EventBits_t all_buses = worker_1 -> cycleBit() | worker_2 -> cycleBit();
+    EventBits_t started = 0;
+    uint32_t sequence = ++cycle_sequence;
+
+    xEventGroupClearBits(cycle_group, all_buses);
+    for (auto worker : {worker_1, worker_2}) {
+        if (worker -> startCycle(sequence)) started |= worker -> cycleBit();
+        else ESP_LOGE("Unit", "Failed to start sample cycle on bus %u.", worker -> bus());
+    }
+    if (started == 0) return false;
+
+    uint32_t start_tm = millis();
+    BusReading reading;
+
+    while (1) {
+        if (xQueueReceive(reading_queue, &reading, 10 / portTICK_PERIOD_MS) == pdTRUE) {
+            auto module = bus_module_map.find((reading.bus << 8) | reading.address);
+            if (module != bus_module_map.end()) module -> second -> addReading(reading.data, reading.monotonic_us);
+            continue;
+        }
+
+        // Workers set their bit after queueing their last reading, so the cycle is complete once the started buses have set their bits for
+        // this cycle and the queue is empty. A bit may also be set by a late finish of an earlier cycle.
+        bool complete = (xEventGroupGetBits(cycle_group) & started) == started && uxQueueMessagesWaiting(reading_queue) == 0;
+        for (auto worker : {worker_1, worker_2}) {
+            if ((started & worker -> cycleBit()) && !worker -> cycleComplete(sequence)) complete = false;
+        }
+
+        if (complete) {
+            log_bus_stats();
+            return started == all_buses;
+        }
+
+        if (millis() - start_tm > SAMPLE_CYCLE_TIMEOUT_MS) {
+            ESP_LOGE("Unit", "Sample cycle timed out.");
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Log the time requests of each priority class have spent queued on each bus.
+ * 
+ */
+void Unit::log_bus_stats() {
+    static const char* class_names[BUS_PRIORITY_CLASSES] = {"actuation", "discovery", "poll"};
+
+    for (auto worker : {worker_1, worker_2}) {
+        for (uint8_t priority = 0; priority < BUS_PRIORITY_CLASSES; priority++) {
+            auto& stats = worker -> queueStats((BusPriority) priority);
+            if (stats.requests == 0) continue;
+            ESP_LOGD("Unit", "Bus %u %s queue: %u requests, mean wait %uus, max wait %uus.", worker -> bus(), class_names[priority], stats.requests, stats.meanWait(), stats.max_wait_us);
+        }
+    }
+}
+
+/**
+ * @brief Read the power status pin and checkpoint the energy counters if due. The unit totals and means are maintained incrementally from the module contribution deltas, so no
+ * rescan of the modules is required here.
  * 
  * @return true 
- * @return false 
+ * @return false - No modules are attached.
  */
 bool Unit::refresh() {
-    total_apparent_power = 0;
-    total_active_power = 0;
-    total_reactive_power = 0;
-    mean_pf = 0;
-    mean_voltage = 0;
-    mean_frequency = 0;
-    mean_current = 0;
-
-    if (module_list.size() == 0) return false;
-
-    for (auto module : module_list) {
-        auto reading = module -> getLatestReading();
-        total_apparent_power += reading.apparent_power;
-        total_reactive_power += reading.reactive_power();
-        total_active_power += reading.active_power();
-
-        if (module -> getRelayState()) mean_pf += reading.power_factor / active_modules;
-        mean_voltage += reading.voltage / number_of_modules;
-        mean_frequency += reading.frequency / number_of_modules;
-        mean_current += reading.current / number_of_modules;
+    power_status = (analogRead(power_sense_pin) > 1000);
+
+    energy_store.checkpoint(module_list); // Rate limited internally.
+
+    return module_list.size() != 0;
+}
+
+/**
+ * @brief Apply a module's change in contribution to the unit totals. O(1) per module update.
+ * 
+ * @param previous The contribution the module was making before the change.
+ * @param next The contribution the module is making after the change.
+ */
+void Unit::applyContribution(const ModuleContribution& previous, const ModuleContribution& next) {
+    total_apparent_power += next.apparent_power - previous.apparent_power;
+    total_active_power += next.active_power - previous.active_power;
+    total_reactive_power += next.reactive_power - previous.reactive_power;
+
+    sum_voltage += next.voltage - previous.voltage;
+    sum_frequency += next.frequency - previous.frequency;
+    sum_current += next.current - previous.current;
+
+    if (previous.active) {
+        sum_active_pf -= previous.power_factor;
+        active_modules--;
     }
 
-    active_modules = activeModules(); // Check which modules are on after reasoning.
+    if (next.active) {
+        sum_active_pf += next.power_factor;
+        active_modules++;
+    }
 
-    power_status = (analogRead(power_sense_pin) > 1000);
+    if (active_modules == 0) sum_active_pf = 0; // Do not let rounding error accumulate while no modules are on.
 
-    return true;
+    update_means();
+}
+
+/**
+ * @brief Recalculate the means from the running sums. Power factor is averaged over the modules which are on, the rest over all modules.
+ * 
+ */
+void Unit::update_means() {
+    if (number_of_modules == 0) return;
+
+    mean_voltage = sum_voltage / number_of_modules;
+    mean_frequency = sum_frequency / number_of_modules;
+    mean_current = sum_current / number_of_modules;
+    mean_pf = (active_modules > 0) ? sum_active_pf / active_modules : 0;
 }
 
 bool Unit::load(JsonObject& obj) {
     sample_period = obj["sample_period"].as<uint32_t>();
     serialization_period = obj["serialization_period"].as<uint32_t>();
     mode = obj["mode"].as<uint32_t>();
+    encoding = obj["encoding"].as<uint32_t>();
+    keyframe_interval = obj[JSON_KEYFRAME_INTERVAL] | DEFAULT_KEYFRAME_INTERVAL;
+
+    JsonObject deadband_obj = obj[JSON_DEADBAND];
+    deadband.voltage = deadband_obj[JSON_VOLTAGE] | DEFAULT_DEADBAND_VOLTAGE;
+    deadband.frequency = deadband_obj[JSON_FREQUENCY] | DEFAULT_DEADBAND_FREQUENCY;
+    deadband.apparent_power = deadband_obj[JSON_APPARENT_POWER] | DEFAULT_DEADBAND_APPARENT_POWER;
+    deadband.power_factor = deadband_obj[JSON_POWER_FACTOR] | DEFAULT_DEADBAND_POWER_FACTOR;
+    deadband.energy = deadband_obj[JSON_KWH_USAGE] | DEFAULT_DEADBAND_ENERGY;
 
     auto rule_obj = obj["rule_engine"].as<JsonObject>();
     RuleEngineBase::load_rule_engine(rule_obj);
@@ -146,12 +350,26 @@ bool Unit::save(JsonObject& obj) {
     obj["sample_period"] = sample_period;
     obj["serialization_period"] = serialization_period;
     obj["mode"] = mode;
+    obj["encoding"] = encoding;
+    obj[JSON_KEYFRAME_INTERVAL] = keyframe_interval;
+
+    JsonObject deadband_obj = obj.createNestedObject(JSON_DEADBAND);
+    deadband_obj[JSON_VOLTAGE] = deadband.voltage;
+    deadband_obj[JSON_FREQUENCY] = deadband.frequency;
+    deadband_obj[JSON_APPARENT_POWER] = deadband.apparent_power;
+    deadband_obj[JSON_POWER_FACTOR] = deadband.power_factor;
+    deadband_obj[JSON_KWH_USAGE] = deadband.energy;
 
     auto rule_obj = obj.createNestedObject("rule_engine");
     RuleEngineBase::save_rule_engine(rule_obj);
     return true;
 }
 
+/**
+ * @brief Get the kWh price now, from the compiled TOU pricing schedule.
+ * 
+ * @return double The price, or `DEFAULT_KWH_PRICE` if the time is unknown or the schedule gives none.
+ */
 double Unit::getkWhPrice() {
     struct tm timeinfo;
     if (!getLocalTime(&timeinfo)) {
@@ -159,97 +377,73 @@ double Unit::getkWhPrice() {
         return DEFAULT_KWH_PRICE;
     }
 
-    if (kwh_price == -1 || timeinfo.tm_hour != tou_calc_hr) {
-        Persistence persistence("/tou.txt", 16384, false);
-        if (!loadTOUSchedule(persistence.document, timeinfo)) return DEFAULT_KWH_PRICE;
-        tou_calc_hr = timeinfo.tm_hour;
-    }
+    load_tariff();
 
-    return kwh_price;
+    double price;
+    if (!tariff.price(timeinfo, price)) return DEFAULT_KWH_PRICE;
+    return price;
 }
 
 /**
- * @brief Find the current kWh price based on the TOU period data. Takes into account high and low seasons, as well as public holidays.
+ * @brief Get the time at which the kWh price next changes. Searched for once, then held until it passes.
  * 
- * @param obj 
- * @return bool - true if successfully found tou price, false otherwise.
+ * @return uint64_t The epoch time of the change, or 0 if the time is unknown or the price holds for `TARIFF_LOOKAHEAD_DAYS`.
  */
-bool Unit::loadTOUSchedule(DynamicPSRAMJsonDocument& obj, struct tm& timeinfo) {
-    /* Get current day, week & month. */
-    int current_wday = timeinfo.tm_wday;
-    int current_mday = timeinfo.tm_mday;
-    int current_mo = timeinfo.tm_mon;
-
-    /* Find current season */
-    auto seasons = obj["seasons"].as<JsonArray>();
-    ps::string current_season = "";
-    for (JsonObject season : seasons) {
-        auto start_date = season["start_date"].as<JsonObject>();
-        auto end_date = season["end_date"].as<JsonObject>();
-        
-        int start_mo = start_date["month"].as<int>();
-        int end_mo = end_date["month"].as<int>();
-        int start_day = start_date["day"].as<int>();
-        int end_day = end_date["day"].as<int>();
-
-        if ((current_mo > start_mo || (current_mo == start_mo && current_mday >= start_day)) &&
-            (current_mo < end_mo || (current_mo == end_mo && current_mday <= end_day))) {
-                current_season = season["name"].as<ps::string>();
-                break;
-        }
-    }
+uint64_t Unit::nextPriceChange() {
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo)) return 0;
 
-    /* Check if any public holidays are now. */
-    auto holidays = obj["public_holidays"].as<JsonArray>();
-    for (JsonObject holiday : holidays) {
-        int day = holiday["day"].as<int>();
-        int month = holiday["month"].as<int>();
-        int year = holiday["year"].as<int>();
+    struct tm copy = timeinfo;
+    uint64_t now = (uint64_t) mktime(&copy);
+    if (now < next_price_check) return next_price_change;
 
-        if (current_mday == day && current_mo == month && (timeinfo.tm_year + 1900) == year) {
-            current_wday = holiday["treat_as"].as<int>();
-            break;
-        }
-    }
+    load_tariff();
+    next_price_change = tariff.nextChange(timeinfo);
+    next_price_check = (next_price_change != 0) ? next_price_change : now + 3600; // Without a change ahead, search again in an hour.
+    return next_price_change;
+}
 
-    /* Check if we are in a TOU period. */
-    auto tou_prices = obj["tou_prices"].as<JsonArray>();
-    for (JsonObject tou_price : tou_prices) {
-        if (tou_price["season"].as<ps::string>() != current_season) {
-            continue;
-        }
+/**
+ * @brief Compile a new TOU pricing schedule and save the compiled tables to flash.
+ * 
+ * @param schedule 
+ * @return true - If the schedule was compiled.
+ */
+bool Unit::setTariff(JsonObjectConst schedule) {
+    tariff_loaded = true;
+    next_price_check = 0;
 
-        auto days = tou_price["days"].as<JsonArray>();
-        for (int day : days) {
-            if (day == current_wday) {
-                auto times = tou_price["times"].as<JsonArray>();
-                for (JsonObject time : times) {
-                    if (time["start"].as<int>() <= timeinfo.tm_hour && time["end"].as<int>() > timeinfo.tm_hour) {
-                        kwh_price = tou_price["price"].as<double>();
-                        return true;
-                    }
-                }
-            }
-        }
+    if (!tariff.compile(schedule)) {
+        LittleFS.remove(TARIFF_TABLE_PATH);
+        return false;
     }
 
-    /* Otherwise just load the base price for now. */
-    auto base_prices = obj["base_prices"].as<JsonArray>();
-    for (JsonObject base_price : base_prices) {
-        if (base_price["season"].as<ps::string>() == current_season) {
-            kwh_price = base_price["price"].as<double>();
-            return true;
-        }
-    }
+    return tariff.save();
+}
 
-    return false;
+/**
+ * @brief Load the compiled TOU pricing schedule from flash, the first time it is needed. If it is missing or corrupt, as after an update
+ * from firmware which did not compile the schedule, it is compiled again from the JSON schedule.
+ * 
+ */
+void Unit::load_tariff() {
+    if (tariff_loaded) return;
+    tariff_loaded = true;
+
+    if (tariff.restore() || !LittleFS.exists("/tou.txt")) return;
+
+    Persistence persistence("/tou.txt", 16384, false);
+    if (tariff.compile(persistence.document.as<JsonObjectConst>())) tariff.save();
 }
 
-uint16_t Unit::activeModules() {
-    uint16_t ret = 0;
-    for (auto module: module_list) {
-        if (module -> getRelayState()) ret++;
-    }
+/**
+ * @brief Get the sum of the modules' energy usage for today.
+ * 
+ * @return double Energy in kWh.
+ */
+double Unit::totalEnergyToday() {
+    double ret = 0;
+    for (auto& module : module_list) ret += module -> energy().todayEnergy();
     return ret;
 }
 
@@ -265,4 +459,36 @@ std::pair<uint64_t, uint64_t> Unit::getSerializationPeriod() {
     last_serialization = now;
 
     return ret;
-}
\ No newline at end of file
+}
+/**
+ * @brief Serialize the bus statistics of each module since the last call, then reset them.
+ * 
+ * @param array 
+ */
+void Unit::serializeBusHealth(JsonArray& array) {
+    for (auto& entry : bus_module_map) {
+        uint8_t bus = entry.first >> 8;
+        uint8_t address = entry.first & 0xFF;
+        auto interface = (bus == worker_1 -> bus()) ? interface_1 : interface_2;
+
+        LinkStats stats = interface -> takeLinkStats(address);
+        if (stats.frames_sent == 0) continue;
+
+        JsonObject obj = array.createNestedObject();
+        obj[JSON_MODULE_UID] = entry.second -> getModuleID();
+        obj[JSON_BUS] = bus;
+        obj[JSON_ADDRESS] = address;
+        obj[JSON_SRTT] = interface -> linkHealth(address).srtt();
+
+        JsonArray counters = obj.createNestedArray(JSON_LINK_COUNTERS);
+        counters.add(stats.frames_sent);
+        counters.add(stats.frames_received);
+        counters.add(stats.check_failures);
+        counters.add(stats.size_mismatches);
+        counters.add(stats.timeouts);
+        counters.add(stats.retries);
+
+        JsonArray latency = obj.createNestedArray(JSON_LATENCY_HISTOGRAM);
+        for (auto count : stats.latency) latency.add(count);
+    }
+}
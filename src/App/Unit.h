@@ -15,14 +15,31 @@
 #include "JSONFields.h"
 #include "Module.h"
 #include "ModuleInterface.h"
+#include "BusWorker.h"
+#include "EnergyStore.h"
+#include "TariffTable.h"
+#include "KVStore.h"
+
+#define READING_QUEUE_LENGTH 32
+#define DISCOVERY_QUEUE_LENGTH 8
+#define SAMPLE_CYCLE_TIMEOUT_MS 30000
 
 
 class Unit: public re::RuleEngineBase, private std::enable_shared_from_this<Unit> {
     private:
     std::shared_ptr<ModuleInterface> interface_1;
     std::shared_ptr<ModuleInterface> interface_2;
+    std::shared_ptr<BusWorker> worker_1;
+    std::shared_ptr<BusWorker> worker_2;
+    QueueHandle_t reading_queue; // Shared queue of BusReading from both bus workers.
+    EventGroupHandle_t cycle_group; // Bus workers set their bit when they finish a sample cycle.
+    uint32_t cycle_sequence = 0; // Number of the last sample cycle started.
+    QueueHandle_t discovery_queue; // Shared queue of BusDiscovery, modules connected after boot.
+
     ps::vector<std::shared_ptr<Module>> module_list;
+    ps::unordered_map<uint16_t, std::shared_ptr<Module>> bus_module_map; // Keyed by (bus << 8) | address.
     std::shared_ptr<re::FunctionStorage> functions;
+    std::shared_ptr<KVStore> store; // Saved module variables, loaded as modules are adopted.
 
     uint8_t power_sense_pin;
 
@@ -33,12 +50,20 @@ class Unit: public re::RuleEngineBase, private std::enable_shared_from_this<Unit
     double mean_pf = 0;
     double mean_voltage = 0;
     double mean_frequency = 0;
+
+    /* Running sums maintained from module contribution deltas. */
+    double sum_voltage = 0;
+    double sum_frequency = 0;
+    double sum_current = 0;
+    double sum_active_pf = 0;
     
     bool power_status = false;
     
     uint16_t active_modules = 0;
     uint16_t number_of_modules = 0;
 
+    EnergyStore energy_store;
+
     ps::string unit_id_;
     uint64_t last_serialization = 0;
 
@@ -47,18 +72,30 @@ class Unit: public re::RuleEngineBase, private std::enable_shared_from_this<Unit
 
     void load_vars();
     void loadUnitVarsInModule(std::shared_ptr<Module>& module);
+    void discoverBus(std::shared_ptr<BusWorker>& worker);
+    std::shared_ptr<Module> adopt_module(std::shared_ptr<BusWorker>& worker, const AnnouncePacket& announce, uint8_t address);
+    void adopt_discovered();
+    void load_module_config(std::shared_ptr<Module>& module);
+    void log_bus_stats();
+    void applyContribution(const ModuleContribution& previous, const ModuleContribution& next);
+    void update_means();
 
 
     /* Time of Use */
-    double kwh_price = -1;
-    double tou_calc_hr = 0;
-    bool loadTOUSchedule(DynamicPSRAMJsonDocument& doc, struct tm& timeinfo);
+    TariffTable tariff;
+    bool tariff_loaded = false; // Whether the compiled schedule was loaded, or found missing, since it last changed.
+    uint64_t next_price_change = 0;
+    uint64_t next_price_check = 0; // Epoch time before which `next_price_change` holds.
+    void load_tariff();
 
     public:
     bool publish_readings = false;
     uint32_t sample_period = DEFAULT_SAMPLE_PERIOD;
     uint32_t serialization_period = DEFAULT_SERIALIZATION_PERIOD;
     uint32_t mode = DEFAULT_MODE;
+    uint32_t encoding = DEFAULT_ENCODING;
+    uint32_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+    ReadingDeadband deadband;
 
     ps::unordered_map<ps::string, std::shared_ptr<Module>> module_map;
 
@@ -76,7 +113,7 @@ class Unit: public re::RuleEngineBase, private std::enable_shared_from_this<Unit
         unit_id_ <<= unit_id;
     }
 
-    void begin(Stream* stream_1, uint8_t ctrl_1, uint8_t ctrl_2, uint8_t dir_1);
+    void begin(HardwareSerial* serial_1, uint8_t ctrl_1, uint8_t dir_1, HardwareSerial* serial_2, uint8_t ctrl_2, uint8_t dir_2);
 
     bool evaluateAll();
     bool evaluateModules();
@@ -84,6 +121,8 @@ class Unit: public re::RuleEngineBase, private std::enable_shared_from_this<Unit
     void create_module_map();
 
     double getkWhPrice();
+    uint64_t nextPriceChange();
+    bool setTariff(JsonObjectConst schedule);
 
     const ps::string& id() { return unit_id_; }
     uint16_t& moduleCount() { return number_of_modules; }
@@ -95,11 +134,15 @@ class Unit: public re::RuleEngineBase, private std::enable_shared_from_this<Unit
     double& meanPowerFactor() { return mean_pf; }
     double& meanCurrent() { return mean_current; }
     bool powerStatus() { return (analogRead(power_sense_pin) > 150); }    
-    uint16_t activeModules();
+    uint16_t activeModules() { return active_modules; }
+    double totalEnergyToday();
     ps::vector<std::shared_ptr<Module>>& getModules() { return module_list; }
+    void setStore(std::shared_ptr<KVStore> store) { this -> store = store; }
+    bool sample();
     bool refresh();
     uint64_t getTimeSinceLastSerialization() { return getTime() - last_serialization; }
     std::pair<uint64_t, uint64_t> getSerializationPeriod();
+    void serializeBusHealth(JsonArray& array);
 
     uint64_t getTime() {
         struct tm timeinfo;
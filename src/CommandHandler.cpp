@@ -110,7 +110,6 @@ void CommandHandler::loadUnitRules(JsonObject& unit_rules) {
     default:
         break;
     }
-    save_required = true;
 }
 
 /**
@@ -173,7 +172,6 @@ void CommandHandler::loadModuleRules(JsonArray& module_rules) {
             break;
         }
     }
-    save_required = true;
 }
 
 
@@ -207,13 +205,27 @@ void CommandHandler::handleSchedulerCommand(JsonObject& object) {
         ESP_LOGI("CommandHandler", "Adding item to scheduler. Module ID: %s", module_id.c_str());
         scheduler -> add(SchedulerItem(item));
     }
+}
 
-    save_required = true;
+/**
+ * @brief Get a deadband from the command, if given and not negative.
+ * 
+ * @param object The command's deadband object.
+ * @param key 
+ * @param current The deadband kept if the command leaves it out.
+ * @param fallback The deadband used if the command's is negative.
+ * @return double 
+ */
+static double deadband_value(JsonObject& object, const char* key, double current, double fallback) {
+    if (!object.containsKey(key)) return current;
 
+    double value = object[key].as<double>();
+    return (value >= 0) ? value : fallback;
 }
 
 /**
- * @brief Handles the incoming control unit parameters command.
+ * @brief Handles the incoming control unit parameters command. The encoding, keyframe interval and deadbands of delta frames are only
+ * changed if given.
  * 
  * @param object 
  */
@@ -222,6 +234,28 @@ void CommandHandler::handleControlUnitParameters(JsonObject& object) {
     unit -> serialization_period = object["serialization_period"].as<int32_t>();
     unit -> mode = object["mode"].as<int32_t>();
 
+    if (object.containsKey("encoding")) {
+        int32_t encoding = object["encoding"].as<int32_t>();
+        if (encoding == ENCODING_JSON || encoding == ENCODING_MSGPACK) unit -> encoding = encoding;
+        else ESP_LOGE("CommandHandler", "Unknown encoding %d, keeping %u.", encoding, unit -> encoding);
+    }
+
+    // Delta frame parameters are optional, and kept when left out. Out of range values fall back to the defaults.
+    if (object.containsKey(JSON_KEYFRAME_INTERVAL)) {
+        int32_t keyframe_interval = object[JSON_KEYFRAME_INTERVAL].as<int32_t>();
+        unit -> keyframe_interval = (keyframe_interval >= 1) ? keyframe_interval : DEFAULT_KEYFRAME_INTERVAL;
+    }
+
+    JsonObject deadband_obj = object[JSON_DEADBAND];
+    if (!deadband_obj.isNull()) {
+        auto& deadband = unit -> deadband;
+        deadband.voltage = deadband_value(deadband_obj, JSON_VOLTAGE, deadband.voltage, DEFAULT_DEADBAND_VOLTAGE);
+        deadband.frequency = deadband_value(deadband_obj, JSON_FREQUENCY, deadband.frequency, DEFAULT_DEADBAND_FREQUENCY);
+        deadband.apparent_power = deadband_value(deadband_obj, JSON_APPARENT_POWER, deadband.apparent_power, DEFAULT_DEADBAND_APPARENT_POWER);
+        deadband.power_factor = deadband_value(deadband_obj, JSON_POWER_FACTOR, deadband.power_factor, DEFAULT_DEADBAND_POWER_FACTOR);
+        deadband.energy = deadband_value(deadband_obj, JSON_KWH_USAGE, deadband.energy, DEFAULT_DEADBAND_ENERGY);
+    }
+
     if (object["format_device"].as<bool>()) {
         scheduler -> clear();
         for (auto& module : unit -> module_map) {
@@ -232,22 +266,29 @@ void CommandHandler::handleControlUnitParameters(JsonObject& object) {
         unit -> sample_period = DEFAULT_SAMPLE_PERIOD;
         unit -> serialization_period = DEFAULT_SERIALIZATION_PERIOD;
         unit -> mode = DEFAULT_MODE;
+        unit -> encoding = DEFAULT_ENCODING;
+        unit -> keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+        unit -> deadband = ReadingDeadband();
     }
 
+    unit -> changed(); // The parameters are saved with the unit's rule engine.
+
     if (object["reset_device"].as<bool>()) {
         LittleFS.format();
         ESP.restart();
     }
-
-    save_required = true;
 }
 
 /**
- * @brief Handles the incoming TOU pricing schedule command.
+ * @brief Handles the incoming TOU pricing schedule command. Saves the schedule, and compiles it into the unit's price lookup tables.
  * 
  * @param object 
  */
 void CommandHandler::handleTOUPricing(JsonObject& object) {
-    Persistence persistence("/tou.txt", 16384, true);
-    persistence.document = object;
+    {
+        Persistence persistence("/tou.txt", 16384, true);
+        persistence.document = object;
+    }
+
+    if (!unit -> setTariff(object)) ESP_LOGE("CommandHandler", "Failed to compile the TOU pricing schedule.");
 }
\ No newline at end of file
@@ -22,7 +22,6 @@ class CommandHandler{
     void handleTOUPricing(JsonObject& object);
 
     public:
-    bool save_required = false;
     CommandHandler();
 
     void begin(std::shared_ptr<Unit> unit, std::shared_ptr<Scheduler> scheduler);
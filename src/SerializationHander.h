@@ -11,10 +11,13 @@ class SerializationHandler {
     private:
     std::shared_ptr<Unit> unit;
     std::shared_ptr<MQTTClient> mqtt_client;
+    uint64_t last_bus_health = 0;
+    uint32_t frames_since_keyframe = 0; // Reading messages sent since the last keyframe.
 
     public:
     SerializationHandler();
     void begin(std::shared_ptr<Unit> unit, std::shared_ptr<MQTTClient> mqtt_client);
 
     void serializeReadings();
+    void serializeBusHealth();
 };
\ No newline at end of file
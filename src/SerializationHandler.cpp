@@ -11,7 +11,9 @@ void SerializationHandler::begin(std::shared_ptr<Unit> unit, std::shared_ptr<MQT
 }
 
 /**
- * @brief If it is time to serialize readings, serialize them and send them to the MQTT client.
+ * @brief If it is time to serialize readings, serialize them and send them to the MQTT client, in the encoding set by the unit parameters.
+ * Every `keyframe_interval` messages a keyframe holds every module, and the messages between are delta frames holding only the modules
+ * which moved beyond the unit's deadbands.
  * 
  * @note This function will block if the MQTT client is not connected and the outgoing message queue is full.
  * 
@@ -20,10 +22,15 @@ void SerializationHandler::serializeReadings() {
     if (unit -> getTimeSinceLastSerialization() < unit -> serialization_period) return; // Not time to serialize readings yet.
 
     try {
-        auto new_message = mqtt_client -> createMessage(0, 16 * 1024);
+        MessageEncoding encoding = (unit -> encoding == ENCODING_MSGPACK) ? ENCODING_MSGPACK : ENCODING_JSON;
+        auto new_message = mqtt_client -> createMessage(0, 16 * 1024, encoding);
+
+        bool keyframe = (frames_since_keyframe == 0);
+        frames_since_keyframe = (unit -> keyframe_interval > 1) ? (frames_since_keyframe + 1) % unit -> keyframe_interval : 0;
 
         new_message -> document[JSON_TYPE].set(0); // Set message type to reading.
         JsonObject data_obj = new_message -> document.createNestedObject(JSON_DATA);
+        data_obj[JSON_KEYFRAME].set(keyframe);
 
         // Save period time data.
         std::pair<uint64_t, uint64_t> period = unit -> getSerializationPeriod();
@@ -36,12 +43,49 @@ void SerializationHandler::serializeReadings() {
         auto& modules = unit -> getModules();
         for (auto module : modules) {
             ESP_LOGD("Serialize", "Module: %s", module -> getModuleID().c_str());
+            if (!keyframe) {
+                module -> serializeDelta(data_array, unit -> deadband); // Only added if it changed.
+                continue;
+            }
+
             JsonObject obj = data_array.createNestedObject();
             module -> serialize(obj); // Get each module to add its reading data.
         };
 
+        ESP_LOGD("Serialize", "%s with %u of %u modules.", keyframe ? "Keyframe" : "Delta frame", data_array.size(), modules.size());
+
         // Message will be sent as new_message class goes out of scope now. Note: Queue insertion with portMAX_DELAY.
     } catch (...) {
         ESP_LOGE("Unit", "Failed to serialize readings.");
     }
 }
+
+/**
+ * @brief If it is time, send the bus statistics of each module, so that failing modules and noisy bus segments can be located, and the
+ * compression statistics of the outgoing messages.
+ * 
+ */
+void SerializationHandler::serializeBusHealth() {
+    uint64_t now = unit -> getTime();
+    if (last_bus_health == 0) last_bus_health = now; // First period starts now.
+    if (now - last_bus_health < BUS_HEALTH_PERIOD) return;
+
+    try {
+        auto new_message = mqtt_client -> createMessage(0, 8 * 1024);
+
+        new_message -> document[JSON_TYPE].set(1); // Set message type to bus health.
+        JsonObject data_obj = new_message -> document.createNestedObject(JSON_DATA);
+        data_obj[JSON_PERIOD_START].set(last_bus_health);
+        data_obj[JSON_PERIOD_END].set(now);
+
+        JsonArray health_array = data_obj.createNestedArray(JSON_BUS_HEALTH);
+        unit -> serializeBusHealth(health_array);
+
+        JsonArray compression_array = data_obj.createNestedArray(JSON_COMPRESSION);
+        mqtt_client -> serializeCompression(compression_array);
+
+        last_bus_health = now;
+    } catch (...) {
+        ESP_LOGE("Unit", "Failed to serialize bus health.");
+    }
+}
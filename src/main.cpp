@@ -13,6 +13,7 @@
 #include "Display.h"
 #include "MQTTClient.h"
 #include "Persistence.h"
+#include "KVStore.h"
 #include "Scheduler.h"
 
 
@@ -35,6 +36,7 @@ std::shared_ptr<MQTTClient> mqtt_client; // The MQTT and (De)Compression handler
 std::shared_ptr<Scheduler> scheduler; // The scheduler class.
 std::shared_ptr<CommandHandler> command_handler; // The command handler class.
 std::shared_ptr<SerializationHandler> serialization_handler; // The serialization handler class.
+std::shared_ptr<KVStore> store; // The saved unit, module and scheduler variables.
 
 TaskHandle_t sentry_task;
 TaskHandle_t app_task;
@@ -55,10 +57,20 @@ void log_memory_usage() {
 
   log_printf("- PSRAM Usage: %.4f/%u KB (%f%%)\n", ((float)(tot_psram - free_psram)) / 1024, tot_psram / 1024, 100 *( 1 - ((float) free_psram) / ((float) tot_psram)));
   log_printf("- SRAM Usage: %.4f/%u KB (%f%%)\n", ((float)(tot_sram - free_sram)) / 1024, tot_sram / 1024, 100 *( 1 - ((float) free_sram) / ((float) tot_sram)));
+
+  for (uint8_t i = 0; i < JSON_POOL_CLASSES; i++) {
+    JsonPoolStats pool = json_pool::stats(i);
+    log_printf("- JSON Pool %u KB: %u/%u in use (peak %u), %u borrows, %u misses, largest document %u B, peak usage %u B\n", pool.size / 1024,
+               pool.in_use, pool.arenas, pool.peak_in_use, pool.borrows, pool.misses, pool.peak_request, pool.peak_usage);
+  }
 }
 
 void first_time_setup(Persistence& persistence);
 void save_runtime_variables();
+void migrate_legacy_variables();
+bool load_variables(const ps::string& key, JsonDocument& document);
+void save_variables(const ps::string& key, JsonVariantConst variables);
+ps::string schedule_key(size_t index);
 void check_reset_condition();
 
 void onOTAStart();
@@ -67,6 +79,8 @@ void onOTAEnd(bool success);
 
 void setup() {
   psramInit();
+  if (!json_pool::begin()) ESP_LOGE("Setup", "Failed to allocate the JSON document pool.");
+  if (!BrotliWriter::begin()) ESP_LOGE("Setup", "Failed to allocate the brotli encoder arena.");
   check_reset_condition();
   
   xTaskCreate(
@@ -189,10 +203,16 @@ void taskApp(void* pvParameters) {
   functions = load_functions();
   ESP_LOGD("App", "Functions Loaded.");
 
+  store = ps::make_shared<KVStore>();
+  if (!store -> begin()) ESP_LOGE("App", "Failed to open the variable store.");
+  migrate_legacy_variables();
+  ESP_LOGD("App", "Variable Store Opened.");
+
   unit = ps::make_shared<Unit>(functions, UNIT_UUID, POWER_SENSE);
+  unit -> setStore(store); // Modules load their saved variables as they are adopted.
   ESP_LOGD("App", "Unit Created.");
 
-  unit -> begin(&Serial1, U1_CTRL, U2_CTRL, U1_DIR);
+  unit -> begin(&Serial1, U1_CTRL, U1_DIR, &Serial2, U2_CTRL, U2_DIR);
   ESP_LOGD("App", "Unit Started.");
 
   scheduler = ps::make_shared<Scheduler>();
@@ -207,34 +227,24 @@ void taskApp(void* pvParameters) {
   ESP_LOGD("App", "Serialization Handler Created.");
 
   { // Load the Scheduler variables from flash.
-    Persistence persistence("/schedule.txt", 8192, false); // Dont write anything to flash.
-    auto scheduler_data = persistence.document.as<JsonArray>();
+    DynamicPSRAMJsonDocument document(8192);
+    auto scheduler_data = document.to<JsonArray>();
+
+    DynamicPSRAMJsonDocument entry(1024);
+    for (size_t i = 0; load_variables(schedule_key(i), entry); i++) scheduler_data.add(entry.as<JsonObject>());
+
     if (scheduler_data.size() > 0)
     scheduler -> load(scheduler_data);
+    scheduler -> markSaved(scheduler -> version()); // What was just loaded needs no saving.
   }
 
   { // Load the Unit variables from flash.
-    Persistence persistence("/unit.txt", 8192, false); // Dont write anything to flash.
-    auto unit_data = persistence.document.as<JsonObject>();
-    if (unit_data.size() > 0)
-    unit -> load(unit_data);
-  }
-
-  { // Load the Module variables from flash.
-    Persistence persistence("/modules.txt", 16384, false); // Dont write anything to flash.
-    auto module_data = persistence.document.as<JsonArray>();
-    auto modules = unit -> getModules();
-
-    if (module_data.size() > 0 && modules.size() > 0)
-    for (JsonObject module : module_data) {
-      ps::string target_id = module[JSON_MODULE_UID].as<ps::string>();
-      auto& map = unit -> module_map;
-
-      auto target = map.find(target_id);
-      if (target == map.end()) continue; // Skip unknown.
-
-      target -> second -> load(module); // Load into known module.
+    DynamicPSRAMJsonDocument document(8192);
+    if (load_variables(STORE_KEY_UNIT, document)) {
+      auto unit_data = document.as<JsonObject>();
+      unit -> load(unit_data);
     }
+    unit -> markSaved(unit -> version());
   }
 
   display -> finishLoading();
@@ -247,8 +257,7 @@ void taskApp(void* pvParameters) {
     int64_t start_tm = millis();
 
     if (millis() - last_sample > (1000 * unit -> sample_period)) { // Sample every second.
-      auto modules = unit -> getModules();
-      for (auto module : modules) module -> refresh();
+      unit -> sample(); // Both buses are polled in parallel by their worker tasks.
       unit -> refresh();
     
       last_sample = millis();
@@ -280,6 +289,7 @@ void taskApp(void* pvParameters) {
     }
 
     serialization_handler -> serializeReadings(); // Serialize readings if it is time to do so.
+    serialization_handler -> serializeBusHealth();
 
     while (mqtt_client -> incoming_message_count() > 0) {
       command_handler -> handle(mqtt_client -> getMessage()); // Handle incoming messages.
@@ -374,62 +384,153 @@ void first_time_setup(Persistence& persistence) {
 }
 
 /**
- * @brief Save all variables to flash which need to be, every 5 minutes. Saves the unit & module rule engines, as well as the scheduler.
+ * @brief Save the variables which changed since they were last saved to flash, at most every `SAVE_MIN_INTERVAL_MS`. The unit & module rule
+ * engines, as well as the scheduler, each keep a version of their state, so only those whose version moved are serialized, one record each
+ * in the variable store, and nothing is done while none did. Their versions are marked saved once the records are committed. Modules whose
+ * saved configuration was not loaded are never saved, and the records of unplugged modules are kept for when they are adopted again.
  * 
  */
 void save_runtime_variables() {
-  if (!command_handler -> save_required) return;
-  command_handler -> save_required = true;
+  static uint64_t last_save = 0;
+  if (last_save != 0 && millis() - last_save < SAVE_MIN_INTERVAL_MS) return;
+
+  ps::vector<std::shared_ptr<Module>> modules;
+  for (auto& entry : unit -> module_map) { // Modules whose saved configuration was not loaded would lose it if saved.
+    if (entry.second -> unsaved() && entry.second -> configLoaded()) modules.push_back(entry.second);
+  }
+
+  bool save_scheduler = scheduler -> unsaved();
+  bool save_unit = unit -> unsaved();
+  if (!save_scheduler && !save_unit && modules.empty()) return;
+
+  last_save = millis();
   ESP_LOGI("Unit", "Saving Runtime Variables.");
 
-  { // Save the Scheduler variables to flash.
-    Persistence persistence("/sched.txt", 8192, true);
-    auto scheduler_data = persistence.document.as<JsonArray>();
+  uint32_t scheduler_version = scheduler -> version();
+  if (save_scheduler) { // Save the Scheduler variables to flash, one record per entry.
+    DynamicPSRAMJsonDocument document(8192);
+    auto scheduler_data = document.to<JsonArray>();
     scheduler -> save(scheduler_data);
+
+    size_t count = 0;
+    for (JsonObject entry : scheduler_data) save_variables(schedule_key(count++), entry);
+    while (store -> contains(schedule_key(count))) store -> remove(schedule_key(count++)); // Entries which have since been removed.
   }
 
-  { // Save the Unit variables to flash.
-    Persistence persistence("/unit.txt", 8192, true);
-    auto unit_data = persistence.document.as<JsonObject>();
+  uint32_t unit_version = unit -> version();
+  if (save_unit) { // Save the Unit variables to flash.
+    DynamicPSRAMJsonDocument document(8192);
+    auto unit_data = document.to<JsonObject>();
     unit -> save(unit_data);
+    save_variables(STORE_KEY_UNIT, unit_data);
   }
 
-  { // Save the Module variables to flash.
-    Persistence persistence("/mod.txt", 16384, true);
-    auto module_data = persistence.document.as<JsonArray>();
-    auto modules = unit -> getModules();
-    auto& module_map = unit -> module_map;
-
-    ps::unordered_map<ps::string, std::shared_ptr<Module>> saved_modules;
-
-    for (JsonObject module : module_data) { // Update existing saves.
-      if (module.containsKey(JSON_MODULE_UID)) {
-        auto module_id = module[JSON_MODULE_UID].as<ps::string>();
-        auto found_module = module_map.find(module_id);
-
-        if (found_module != module_map.end()) {
-          found_module -> second -> save(module); // Load into known module.
-          saved_modules.insert( std::make_pair( module_id, found_module -> second ));
-          continue;
-        } else {
-          module_data.remove(module); // Remove unknown module.
-        }
-      }
-    }
+  ps::vector<uint32_t> module_versions;
+  if (!modules.empty()) { // Save the changed Module variables to flash, one record per module. Unplugged modules keep theirs.
+    for (auto module : modules) {
+      module_versions.push_back(module -> version());
 
-    for (auto module : modules) { // Save all modules that have not been saved.
-      if (saved_modules.find(module -> getModuleID()) == saved_modules.end()) {
-        JsonObject obj = module_data.createNestedObject();
-        module -> save(obj);
-      }
+      DynamicPSRAMJsonDocument document(8192);
+      auto module_data = document.to<JsonObject>();
+      module_data[JSON_MODULE_UID] = module -> getModuleID();
+      module -> save(module_data);
+      save_variables(STORE_KEY_MODULE + module -> getModuleID(), module_data);
     }
+  }
 
+  if (!store -> commit()) {
+    ESP_LOGE("Unit", "Failed to save Runtime Variables.");
+    return; // Still unsaved, so retried after the interval.
   }
 
+  // Changes made while saving have newer versions, and are saved next time.
+  if (save_scheduler) scheduler -> markSaved(scheduler_version);
+  if (save_unit) unit -> markSaved(unit_version);
+  for (size_t i = 0; i < modules.size(); i++) modules[i] -> markSaved(module_versions[i]);
+
   ESP_LOGI("Unit", "Runtime Variables Saved.");
 
 }
 
+/**
+ * @brief Move the variables saved by earlier firmware, as one file each for the scheduler, unit and modules, into the variable store. Only
+ * runs while the store is empty, and removes the files once their variables are committed.
+ * 
+ */
+void migrate_legacy_variables() {
+  const char* files[] = {"/sched.txt", "/unit.txt", "/mod.txt"};
+  if (store -> size() > 0) return;
+
+  bool found = false;
+  for (auto path : files) found = found || LittleFS.exists(path);
+  if (!found) return;
+
+  ESP_LOGI("App", "Migrating saved variables to the variable store.");
+
+  if (LittleFS.exists("/sched.txt")) {
+    Persistence persistence("/sched.txt", 8192, false);
+    size_t count = 0;
+    for (JsonObject entry : persistence.document.as<JsonArray>()) save_variables(schedule_key(count++), entry);
+  }
+
+  if (LittleFS.exists("/unit.txt")) {
+    Persistence persistence("/unit.txt", 8192, false);
+    if (persistence.document.as<JsonObject>().size() > 0) save_variables(STORE_KEY_UNIT, persistence.document);
+  }
+
+  if (LittleFS.exists("/mod.txt")) {
+    Persistence persistence("/mod.txt", 16384, false);
+    for (JsonObject module : persistence.document.as<JsonArray>()) {
+      if (module.containsKey(JSON_MODULE_UID)) save_variables(STORE_KEY_MODULE + module[JSON_MODULE_UID].as<ps::string>(), module);
+    }
+  }
+
+  if (!store -> commit()) return;
+  for (auto path : files) LittleFS.remove(path);
+}
+
+/**
+ * @brief Load a record of the variable store into a document.
+ * 
+ * @param key 
+ * @param document 
+ * @return true - If the record exists and was deserialized.
+ */
+bool load_variables(const ps::string& key, JsonDocument& document) {
+  ps::string variables;
+  if (!store -> get(key, variables)) return false;
+
+  auto result = deserializeJson(document, variables.c_str(), variables.size());
+  if (result.code() != 0) {
+    ESP_LOGE("Persistence", "Failed to deserialize %s: %s", key.c_str(), result.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Stage a record of the variable store, to be written by the next commit.
+ * 
+ * @param key 
+ * @param variables 
+ */
+void save_variables(const ps::string& key, JsonVariantConst variables) {
+  ps::ostringstream output;
+  if (serializeJson(variables, output) == 0) {
+    ESP_LOGE("Persistence", "Failed to serialize %s.", key.c_str());
+    return;
+  }
+
+  store -> put(key, output.str());
+}
+
+ps::string schedule_key(size_t index) {
+  char key[16];
+  snprintf(key, sizeof(key), STORE_KEY_SCHEDULE "%u", index);
+  return ps::string(key);
+}
+
 /**
  * @brief Checks whether the RESET_PIN is held low for at least `RESET_HOLD_LOW_TIME` seconds before formatting the Filesystem.
  */
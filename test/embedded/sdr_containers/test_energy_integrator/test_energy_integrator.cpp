@@ -0,0 +1,71 @@
+#include <Arduino.h>
+
+#define UNITY_INCLUDE_DOUBLE
+#include <unity.h>
+
+#include "../../../../src/App/Module/EnergyIntegrator.h"
+
+#define SECOND_US 1000000ULL
+
+void test_trapezoidal_integration() {
+    EnergyIntegrator integrator(7200 * SECOND_US);
+
+    integrator.addSample(0, 1000, 1);
+    integrator.addSample(3600 * SECOND_US, 3000, 1); // Ramp from 1kW to 3kW over an hour.
+
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, integrator.totalEnergy());
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, integrator.todayEnergy());
+    TEST_ASSERT_EQUAL_DOUBLE(2.0, integrator.takePeriodEnergy());
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, integrator.takePeriodEnergy());
+}
+
+void test_missed_polls_are_bridged() {
+    EnergyIntegrator integrator;
+
+    integrator.addSample(0, 3600, 1);
+    integrator.addSample(10 * SECOND_US, 3600, 1); // Nine missed one second polls.
+
+    TEST_ASSERT_EQUAL_DOUBLE(0.01, integrator.totalEnergy());
+    TEST_ASSERT_EQUAL_UINT32(0, integrator.takePeriodGap());
+}
+
+void test_gap_is_not_integrated() {
+    EnergyIntegrator integrator(60 * SECOND_US);
+
+    integrator.addSample(0, 1000, 1);
+    integrator.addSample(600 * SECOND_US, 1000, 1);
+
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, integrator.totalEnergy());
+    TEST_ASSERT_EQUAL_UINT32(600, integrator.takePeriodGap());
+
+    integrator.addSample(636 * SECOND_US, 1000, 1);
+    TEST_ASSERT_EQUAL_DOUBLE(0.01, integrator.totalEnergy());
+}
+
+void test_day_rollover_and_restore() {
+    EnergyIntegrator integrator;
+    integrator.restore(10.0, 1.5, 1);
+
+    integrator.addSample(0, 3600, 1);
+    integrator.addSample(10 * SECOND_US, 3600, 1);
+    TEST_ASSERT_EQUAL_DOUBLE(1.51, integrator.todayEnergy());
+
+    integrator.addSample(20 * SECOND_US, 3600, 2);
+    TEST_ASSERT_EQUAL_DOUBLE(0.01, integrator.todayEnergy());
+    TEST_ASSERT_EQUAL_DOUBLE(10.02, integrator.totalEnergy());
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_trapezoidal_integration);
+    RUN_TEST(test_missed_polls_are_bridged);
+    RUN_TEST(test_gap_is_not_integrated);
+    RUN_TEST(test_day_rollover_and_restore);
+
+    UNITY_END();
+}
+
+void loop() {}
@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "json_allocator.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_borrow_and_return() {
+    uint32_t borrows = json_pool::stats(3).borrows;
+    {
+        DynamicPSRAMJsonDocument document(16 * 1024);
+        TEST_ASSERT_EQUAL(1, json_pool::stats(3).in_use);
+        TEST_ASSERT_EQUAL(borrows + 1, json_pool::stats(3).borrows);
+    }
+    TEST_ASSERT_EQUAL(0, json_pool::stats(3).in_use);
+}
+
+void test_smallest_fitting_class() {
+    DynamicPSRAMJsonDocument command(3000);
+    TEST_ASSERT_EQUAL(1, json_pool::stats(1).in_use);
+    TEST_ASSERT_EQUAL(0, json_pool::stats(2).in_use);
+
+    // The 1KB arenas are exhausted, so the next document takes a larger arena.
+    DynamicPSRAMJsonDocument first(1024), second(1024), third(1024);
+    TEST_ASSERT_EQUAL(2, json_pool::stats(0).in_use);
+    TEST_ASSERT_EQUAL(2, json_pool::stats(1).in_use);
+}
+
+void test_exhausted_falls_back_to_heap() {
+    uint32_t misses = json_pool::stats(3).misses;
+    {
+        DynamicPSRAMJsonDocument first(16 * 1024), second(16 * 1024), third(16 * 1024);
+        TEST_ASSERT_EQUAL(16 * 1024, third.capacity());
+        TEST_ASSERT_EQUAL(misses + 1, json_pool::stats(3).misses);
+        TEST_ASSERT_EQUAL(2, json_pool::stats(3).peak_in_use);
+    }
+    TEST_ASSERT_EQUAL(0, json_pool::stats(3).in_use);
+}
+
+void test_usage_high_water_mark() {
+    DynamicPSRAMJsonDocument document(8 * 1024);
+    for (int i = 0; i < 50; i++) document.add(i);
+    json_pool::recordUsage(document.capacity(), document.memoryUsage());
+    TEST_ASSERT_EQUAL(document.memoryUsage(), json_pool::stats(2).peak_usage);
+}
+
+void setup() {
+    if (!json_pool::begin()) ESP_LOGE("JsonPool", "Failed to allocate arenas.");
+
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_borrow_and_return);
+    RUN_TEST(test_smallest_fitting_class);
+    RUN_TEST(test_exhausted_falls_back_to_heap);
+    RUN_TEST(test_usage_high_water_mark);
+    UNITY_END();
+}
+
+void loop() {
+
+}
@@ -0,0 +1,174 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include "KVStore.h"
+
+static ps::string value(int number) {
+    ps::string ret = "{\"rules\":\"";
+    ret.append(200 + number % 50, 'a' + number % 26);
+    return ret + "\"}";
+}
+
+static size_t log_size() {
+    auto file = LittleFS.open(KV_STORE_PATH, FILE_READ);
+    if (!file) return 0;
+    size_t size = file.size();
+    file.close();
+    return size;
+}
+
+void setUp() {
+    KVStore store;
+    store.begin();
+    store.clear();
+}
+
+void tearDown() {}
+
+void test_put_get() {
+    KVStore store;
+    TEST_ASSERT_TRUE(store.begin());
+
+    store.put("mod/a", value(1));
+    store.put("mod/b", value(2));
+    store.put("unit", value(3));
+
+    ps::string result;
+    TEST_ASSERT_TRUE(store.get("mod/a", result)); // Staged changes are visible before the commit.
+    TEST_ASSERT_TRUE(result == value(1));
+    TEST_ASSERT_TRUE(store.commit());
+
+    TEST_ASSERT_EQUAL(3, store.size());
+    TEST_ASSERT_EQUAL(2, store.keys("mod/").size());
+    TEST_ASSERT_TRUE(store.get("unit", result));
+    TEST_ASSERT_TRUE(result == value(3));
+
+    store.remove("mod/b");
+    TEST_ASSERT_TRUE(store.commit());
+    TEST_ASSERT_FALSE(store.contains("mod/b"));
+    TEST_ASSERT_EQUAL(2, store.size());
+}
+
+void test_survives_restart() {
+    {
+        KVStore store;
+        store.begin();
+        for (int i = 0; i < 10; i++) store.put("mod/" + ps::string(1, 'a' + i), value(i));
+        TEST_ASSERT_TRUE(store.commit());
+        store.put("mod/c", value(42));
+        store.remove("mod/d");
+        TEST_ASSERT_TRUE(store.commit());
+    }
+
+    KVStore store;
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_EQUAL(9, store.size());
+
+    ps::string result;
+    TEST_ASSERT_TRUE(store.get("mod/c", result));
+    TEST_ASSERT_TRUE(result == value(42));
+    TEST_ASSERT_FALSE(store.contains("mod/d"));
+}
+
+void test_unchanged_not_written() {
+    KVStore store;
+    store.begin();
+    store.put("unit", value(1));
+    store.put("mod/a", value(2));
+    store.commit();
+
+    size_t before = log_size();
+    store.put("unit", value(1));
+    store.put("mod/a", value(2));
+    TEST_ASSERT_TRUE(store.commit());
+    TEST_ASSERT_EQUAL(before, log_size());
+
+    // Changing one record appends only that record and the commit record.
+    store.put("mod/a", value(3));
+    store.put("unit", value(1));
+    TEST_ASSERT_TRUE(store.commit());
+    TEST_ASSERT_EQUAL(before + 2 * sizeof(KVRecordHeader) + strlen("mod/a") + value(3).size(), log_size());
+}
+
+void test_uncommitted_batch_discarded() {
+    {
+        KVStore store;
+        store.begin();
+        store.put("mod/a", value(1));
+        store.put("mod/b", value(2));
+        TEST_ASSERT_TRUE(store.commit());
+        store.put("mod/a", value(3));
+        store.put("mod/b", value(4));
+        TEST_ASSERT_TRUE(store.commit());
+    }
+
+    { // Cut the last batch short, as a reset during the commit would.
+        auto file = LittleFS.open(KV_STORE_PATH, FILE_READ);
+        ps::string contents(file.size(), '\0');
+        file.read((uint8_t*) &contents[0], contents.size());
+        file.close();
+
+        file = LittleFS.open(KV_STORE_PATH, FILE_WRITE);
+        file.write((const uint8_t*) contents.c_str(), contents.size() - sizeof(KVRecordHeader) - 10);
+        file.close();
+    }
+
+    KVStore store;
+    TEST_ASSERT_TRUE(store.begin());
+
+    // Neither record of the torn batch applies.
+    ps::string result;
+    TEST_ASSERT_TRUE(store.get("mod/a", result));
+    TEST_ASSERT_TRUE(result == value(1));
+    TEST_ASSERT_TRUE(store.get("mod/b", result));
+    TEST_ASSERT_TRUE(result == value(2));
+
+    // The torn tail was compacted away, so new batches are read back.
+    store.put("mod/b", value(5));
+    TEST_ASSERT_TRUE(store.commit());
+
+    KVStore reopened;
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_TRUE(reopened.get("mod/b", result));
+    TEST_ASSERT_TRUE(result == value(5));
+}
+
+void test_compaction() {
+    KVStore store;
+    store.begin();
+
+    for (int i = 0; i < 400; i++) {
+        store.put("mod/" + ps::string(1, 'a' + i % 4), value(i));
+        TEST_ASSERT_TRUE(store.commit());
+    }
+
+    TEST_ASSERT_TRUE(log_size() < KV_STORE_COMPACT_MIN_SIZE + 4 * 512);
+
+    KVStore reopened;
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_EQUAL(4, reopened.size());
+
+    ps::string result;
+    for (int i = 396; i < 400; i++) {
+        TEST_ASSERT_TRUE(reopened.get("mod/" + ps::string(1, 'a' + i % 4), result));
+        TEST_ASSERT_TRUE(result == value(i));
+    }
+}
+
+void setup() {
+    if (!LittleFS.begin(true)) ESP_LOGE("FS", "Failed to start.");
+
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_put_get);
+    RUN_TEST(test_survives_restart);
+    RUN_TEST(test_unchanged_not_written);
+    RUN_TEST(test_uncommitted_batch_discarded);
+    RUN_TEST(test_compaction);
+    UNITY_END();
+}
+
+void loop() {
+
+}
@@ -0,0 +1,67 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "LinkHealth.h"
+
+void test_initial_timeout() {
+    LinkHealth link;
+    TEST_ASSERT_EQUAL_UINT32(RTO_INITIAL_MS, link.timeout_ms());
+    TEST_ASSERT_TRUE(link.probeDue(0));
+}
+
+void test_timeout_tracks_round_trip() {
+    LinkHealth link;
+    for (int i = 0; i < 50; i++) link.onSuccess(4000); // Steady 4ms round trip.
+
+    TEST_ASSERT_EQUAL_UINT32(4000, link.srtt());
+    TEST_ASSERT_EQUAL_UINT32(RTO_MIN_MS, link.timeout_ms()); // Clamped to the floor once the variance settles.
+}
+
+void test_quarantine_and_backoff() {
+    LinkHealth link;
+    link.onFailure(0);
+    link.onFailure(0);
+    TEST_ASSERT_FALSE(link.quarantined());
+
+    link.onFailure(1000);
+    TEST_ASSERT_TRUE(link.quarantined());
+    TEST_ASSERT_FALSE(link.probeDue(1000 + QUARANTINE_BASE_MS - 1));
+    TEST_ASSERT_TRUE(link.probeDue(1000 + QUARANTINE_BASE_MS));
+
+    link.onFailure(5000); // Failed probe doubles the backoff.
+    TEST_ASSERT_FALSE(link.probeDue(5000 + 2 * QUARANTINE_BASE_MS - 1));
+    TEST_ASSERT_TRUE(link.probeDue(5000 + 2 * QUARANTINE_BASE_MS));
+
+    link.onSuccess(5000);
+    TEST_ASSERT_FALSE(link.quarantined());
+    TEST_ASSERT_TRUE(link.probeDue(0));
+}
+
+void test_latency_buckets() {
+    LinkStats stats;
+    stats.recordLatency(100);
+    stats.recordLatency(300);
+    stats.recordLatency(3000);
+    stats.recordLatency(10000000);
+
+    TEST_ASSERT_EQUAL_UINT32(1, stats.latency[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.latency[1]); // 256us - 511us
+    TEST_ASSERT_EQUAL_UINT32(1, stats.latency[4]); // 2048us - 4095us
+    TEST_ASSERT_EQUAL_UINT32(1, stats.latency[LATENCY_BUCKETS - 1]);
+    TEST_ASSERT_EQUAL_UINT32(2048, LinkStats::bucketFloor(4));
+}
+
+void setup() {
+    delay(2000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_initial_timeout);
+    RUN_TEST(test_timeout_tracks_round_trip);
+    RUN_TEST(test_quarantine_and_backoff);
+    RUN_TEST(test_latency_buckets);
+    UNITY_END();
+}
+
+void loop() {
+
+}
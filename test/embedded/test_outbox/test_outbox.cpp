@@ -0,0 +1,144 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include "Outbox.h"
+
+static ps::string message(int number) {
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%08d", number);
+    ps::string ret(prefix);
+    ret.append(3000 + (number * 37) % 2000, 'a' + number % 26);
+    return ret;
+}
+
+static int message_number(const ps::string& payload) {
+    return atoi(payload.substr(0, 8).c_str());
+}
+
+void setUp() {
+    Outbox outbox;
+    outbox.begin();
+    outbox.clear();
+}
+
+void tearDown() {}
+
+void test_fifo() {
+    Outbox outbox;
+    TEST_ASSERT_TRUE(outbox.begin());
+    TEST_ASSERT_TRUE(outbox.empty());
+
+    for (int i = 0; i < 20; i++) TEST_ASSERT_TRUE(outbox.push(i % 3, message(i).c_str(), message(i).size()));
+    TEST_ASSERT_EQUAL(20, outbox.size());
+
+    uint8_t topic;
+    ps::string payload;
+    uint32_t token;
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(outbox.front(topic, payload, token));
+        TEST_ASSERT_EQUAL(i % 3, topic);
+        TEST_ASSERT_TRUE(payload == message(i));
+        TEST_ASSERT_TRUE(outbox.pop(token));
+    }
+
+    TEST_ASSERT_FALSE(outbox.front(topic, payload, token));
+    TEST_ASSERT_TRUE(outbox.empty());
+}
+
+void test_survives_restart() {
+    {
+        Outbox outbox;
+        outbox.begin();
+        for (int i = 0; i < 10; i++) outbox.push(0, message(i).c_str(), message(i).size());
+        TEST_ASSERT_TRUE(outbox.flush(true));
+    }
+
+    Outbox outbox;
+    TEST_ASSERT_TRUE(outbox.begin());
+    TEST_ASSERT_EQUAL(10, outbox.size());
+
+    uint8_t topic;
+    ps::string payload;
+    uint32_t token;
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(outbox.front(topic, payload, token));
+        TEST_ASSERT_TRUE(payload == message(i));
+        TEST_ASSERT_TRUE(outbox.pop(token));
+    }
+    TEST_ASSERT_TRUE(outbox.empty());
+}
+
+void test_bounded() {
+    Outbox outbox;
+    outbox.begin();
+
+    const int count = 400; // Several times what the segments hold.
+    for (int i = 0; i < count; i++) outbox.push(0, message(i).c_str(), message(i).size());
+    outbox.flush(true);
+    TEST_ASSERT_TRUE(outbox.size() < count);
+
+    // The oldest messages were dropped, the newest kept, in order.
+    uint8_t topic;
+    ps::string payload;
+    uint32_t token;
+    int last = -1;
+    size_t drained = 0;
+    while (outbox.front(topic, payload, token)) {
+        TEST_ASSERT_TRUE(message_number(payload) > last);
+        last = message_number(payload);
+        TEST_ASSERT_TRUE(outbox.pop(token));
+        drained++;
+    }
+
+    TEST_ASSERT_EQUAL(count - 1, last);
+    TEST_ASSERT_TRUE(drained > 0);
+}
+
+void test_flush_between_front_and_pop() {
+    Outbox outbox;
+    outbox.begin();
+
+    uint8_t topic;
+    ps::string payload;
+    uint32_t token;
+    outbox.push(0, message(0).c_str(), message(0).size());
+    TEST_ASSERT_TRUE(outbox.front(topic, payload, token));
+
+    // Pushed from another task while the front message is published, moving the buffer to flash.
+    for (int i = 1; i < 10; i++) outbox.push(0, message(i).c_str(), message(i).size());
+    TEST_ASSERT_TRUE(outbox.pop(token));
+    TEST_ASSERT_FALSE(outbox.pop(token)); // Already removed.
+    TEST_ASSERT_EQUAL(9, outbox.size());
+
+    for (int i = 1; i < 10; i++) {
+        TEST_ASSERT_TRUE(outbox.front(topic, payload, token));
+        TEST_ASSERT_TRUE(payload == message(i));
+        TEST_ASSERT_TRUE(outbox.pop(token));
+    }
+    TEST_ASSERT_TRUE(outbox.empty());
+
+    // A clear between the two leaves messages pushed after it alone.
+    outbox.push(0, message(0).c_str(), message(0).size());
+    TEST_ASSERT_TRUE(outbox.front(topic, payload, token));
+    outbox.clear();
+    outbox.push(0, message(1).c_str(), message(1).size());
+    TEST_ASSERT_FALSE(outbox.pop(token));
+    TEST_ASSERT_EQUAL(1, outbox.size());
+}
+
+void setup() {
+    if (!LittleFS.begin(true)) ESP_LOGE("FS", "Failed to start.");
+
+    delay(2000);
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo);
+    RUN_TEST(test_survives_restart);
+    RUN_TEST(test_bounded);
+    RUN_TEST(test_flush_between_front_and_pop);
+    UNITY_END();
+}
+
+void loop() {
+
+}
@@ -24,6 +24,54 @@ void test_read() {
     TEST_ASSERT_EQUAL_STRING("Hello World!!!", result.c_str());
 }
 
+/**
+ * @brief Write a document the size of a full TOU schedule, then time loading it as before, reading the whole file into a string, logging it
+ * and deserializing the copy, against loading it through Persistence, which deserializes from the file as it is read.
+ * 
+ */
+void test_load_benchmark() {
+    {
+        Persistence nvs("/bench.txt", 49152, true);
+        auto periods = nvs.document.createNestedArray("periods");
+        for (int i = 0; measureJson(nvs.document) < 16 * 1024; i++) {
+            auto period = periods.createNestedObject();
+            period["start"] = i * 900;
+            period["end"] = (i + 1) * 900;
+            period["price"] = 0.5 + i / 1000.0;
+            period["season"] = (i % 2) ? "high" : "low";
+        }
+    }
+
+    uint32_t start_us = micros();
+    size_t whole_periods;
+    {
+        DynamicPSRAMJsonDocument document(49152);
+        auto file = LittleFS.open("/bench.txt", FILE_READ, true);
+        ps::string data = file.readString().c_str();
+        ESP_LOGI("Persistence" , "File: %s", data.c_str());
+        TEST_ASSERT_EQUAL(0, deserializeJson(document, data.c_str()).code());
+        whole_periods = document["periods"].size();
+        file.close();
+    }
+    uint32_t whole_us = micros() - start_us;
+
+    start_us = micros();
+    size_t periods;
+    {
+        Persistence nvs("/bench.txt", 49152);
+        periods = nvs.document["periods"].size();
+    }
+    uint32_t streamed_us = micros() - start_us;
+
+    LittleFS.remove("/bench.txt");
+    TEST_ASSERT_TRUE(periods > 0);
+    TEST_ASSERT_EQUAL(whole_periods, periods);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%u periods: whole file %u us, streamed %u us.", periods, whole_us, streamed_us);
+    TEST_MESSAGE(message);
+}
+
 void setup() {
     if (!LittleFS.begin(true)) ESP_LOGE("FS", "Failed to start.");
     auto file = LittleFS.open("/test1.txt", FILE_READ, true);
@@ -34,6 +82,7 @@ void setup() {
     UNITY_BEGIN();
     RUN_TEST(test_write);
     RUN_TEST(test_read);
+    RUN_TEST(test_load_benchmark);
     UNITY_END();
 }
 
@@ -0,0 +1,116 @@
+#pragma once
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * @brief Minimal host stand-in for the Arduino core and FreeRTOS, enough to build the bus code for the native test environment.
+ *
+ * Time is virtual. It only advances when the code under test waits (delays, task notifications and UART flushes), which makes bus
+ * timings deterministic and lets a full polling cycle of many modules run in microseconds of real time.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "Stream.h"
+#include "esp_heap_caps.h"
+
+using std::min;
+using std::max;
+
+#define PROGMEM
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define OUTPUT 0x03
+#define INPUT 0x01
+
+namespace host {
+    inline uint64_t now_us = 0;
+
+    // Earliest virtual time at which the waiting task would be notified, e.g. the next received byte.
+    inline std::function<uint64_t()> next_wakeup;
+    // Called on every digitalWrite, so simulated hardware can follow the control lines.
+    inline std::function<void(uint8_t pin, uint8_t value)> pin_hook;
+
+    inline void advance(uint64_t us) { now_us += us; }
+}
+
+inline uint32_t millis() { return host::now_us / 1000; }
+inline uint32_t micros() { return host::now_us; }
+inline void delay(uint32_t ms) { host::advance((uint64_t) ms * 1000); }
+inline void delayMicroseconds(uint32_t us) { host::advance(us); }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) { if (host::pin_hook) host::pin_hook(pin, value); }
+
+/* Logging, errors only unless HOST_LOG_LEVEL is raised. */
+#ifndef HOST_LOG_LEVEL
+#define HOST_LOG_LEVEL 1
+#endif
+
+#define HOST_LOG(level, letter, tag, format, ...) do { if (HOST_LOG_LEVEL >= level) fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, format, ...) HOST_LOG(1, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(2, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(3, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(4, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(5, "V", tag, format, ##__VA_ARGS__)
+
+/* FreeRTOS, for a single task. */
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef int BaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY std::numeric_limits<TickType_t>::max()
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return (SemaphoreHandle_t) 1; }
+inline void vSemaphoreDelete(SemaphoreHandle_t) {}
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return (TaskHandle_t) 1; }
+inline void xTaskNotifyGive(TaskHandle_t) {}
+inline void vTaskDelay(TickType_t ticks) { host::advance((uint64_t) ticks * portTICK_PERIOD_MS * 1000); }
+
+/**
+ * @brief Sleep until the next wakeup, or until the ticks elapse.
+ *
+ * @return uint32_t 1 if woken before the timeout.
+ */
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t ticks) {
+    uint64_t deadline = (ticks == portMAX_DELAY) ? std::numeric_limits<uint64_t>::max() : host::now_us + (uint64_t) ticks * portTICK_PERIOD_MS * 1000;
+    uint64_t wakeup = host::next_wakeup ? host::next_wakeup() : std::numeric_limits<uint64_t>::max();
+
+    if (wakeup <= deadline) {
+        if (wakeup > host::now_us) host::now_us = wakeup;
+        return 1;
+    }
+
+    host::now_us = deadline;
+    return 0;
+}
+
+/**
+ * @brief UART with a receive callback. The simulated bus derives from this.
+ */
+class HardwareSerial : public Stream {
+    protected:
+        std::function<void()> receive_callback;
+    public:
+        void onReceive(std::function<void()> callback) { receive_callback = callback; }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The subset of the Arduino Stream interface used by the bus code.
+ */
+class Stream {
+    public:
+        virtual ~Stream() {}
+
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual size_t write(uint8_t data) = 0;
+        virtual size_t write(const uint8_t* buffer, size_t size) {
+            for (size_t i = 0; i < size; i++) write(buffer[i]);
+            return size;
+        }
+        virtual void flush() {}
+};
+
+#endif
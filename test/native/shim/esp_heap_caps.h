@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+/**
+ * @brief Host stand-in for the ESP-IDF heap capabilities, backed by the standard allocator. Plain C, as esp-brotli's platform layer
+ * includes it too.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+static inline void* heap_caps_malloc(size_t size, uint32_t caps) { (void) caps; return malloc(size); }
+static inline void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) { (void) caps; return calloc(n, size); }
+static inline void* heap_caps_realloc(void* ptr, size_t size, uint32_t caps) { (void) caps; return realloc(ptr, size); }
+static inline void heap_caps_free(void* ptr) { free(ptr); }
+static inline size_t heap_caps_get_largest_free_block(uint32_t caps) { (void) caps; return SIZE_MAX; }
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#ifndef HOST_PS_STL_H
+#define HOST_PS_STL_H
+
+/**
+ * @brief Host stand-in for the PSRAM containers, backed by the standard allocator.
+ */
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ps {
+    template <typename T> using vector = std::vector<T>;
+    template <typename T> using deque = std::deque<T>;
+    template <typename K, typename V> using unordered_map = std::unordered_map<K, V>;
+    using string = std::string;
+
+    template <typename T, typename... Args>
+    std::shared_ptr<T> make_shared(Args&&... args) { return std::make_shared<T>(std::forward<Args>(args)...); }
+}
+
+#endif
@@ -0,0 +1,358 @@
+#include "BusSimulator.h"
+#include <algorithm>
+
+/**
+ * @brief Construct a new Bus Simulator, and attach it to the host shim's clock and pins.
+ *
+ * @param control_pin The addressing control line of the bus.
+ * @param baud Sets the wire time of each byte (ten bits).
+ * @param seed Seeds the latency, drop and corruption draws, so runs are repeatable.
+ */
+BusSimulator::BusSimulator(uint8_t control_pin, uint32_t baud, uint32_t seed) :
+    ctrl_pin(control_pin),
+    byte_us((10 * 1000000 + baud - 1) / baud),
+    rng(seed)
+{
+    host::next_wakeup = [this]() {
+        for (auto& pending : to_host) {
+            if (pending.first > host::now_us) return pending.first;
+        }
+        return std::numeric_limits<uint64_t>::max();
+    };
+
+    host::pin_hook = [this](uint8_t pin, uint8_t value) {
+        if (pin != ctrl_pin) return;
+
+        addressing = (value == LOW);
+        announcing = nullptr;
+        if (addressing) announce_next(host::now_us);
+    };
+}
+
+BusSimulator::~BusSimulator() {
+    host::next_wakeup = nullptr;
+    host::pin_hook = nullptr;
+}
+
+/**
+ * @brief Connect a new, unaddressed module to the end of the daisy chain.
+ *
+ * @param config
+ * @return VirtualModule&
+ */
+VirtualModule& BusSimulator::addModule(const VirtualModuleConfig& config) {
+    modules.emplace_back();
+    VirtualModule& module = modules.back();
+
+    module.config = config;
+    memset(&module.announce, 0, sizeof(module.announce));
+    snprintf(module.announce.id, sizeof(module.announce.id), "sim-module-%03u", (unsigned) modules.size());
+    module.announce.firmware_version = config.firmware_version;
+    module.announce.hardware_version = 1;
+
+    memset(&module.meter, 0, sizeof(module.meter));
+    module.meter.frequency = 50;
+    module.meter.power_factor = 0.95;
+
+    return module;
+}
+
+VirtualModule* BusSimulator::module(uint8_t address) {
+    for (auto& module : modules) {
+        if (module.address == address) return &module;
+    }
+    return nullptr;
+}
+
+int BusSimulator::available() {
+    int count = 0;
+    for (auto& pending : to_host) {
+        if (pending.first > host::now_us) break;
+        count++;
+    }
+    return count;
+}
+
+int BusSimulator::read() {
+    if (to_host.empty() || to_host.front().first > host::now_us) return -1;
+
+    uint8_t data = to_host.front().second;
+    to_host.pop_front();
+    return data;
+}
+
+size_t BusSimulator::write(uint8_t data) {
+    from_host.push_back(data);
+    return 1;
+}
+
+/**
+ * @brief Put the bytes written since the last flush on the wire, then let the modules act on any complete frames.
+ *
+ */
+void BusSimulator::flush() {
+    host::advance((uint64_t) from_host.size() * byte_us);
+    uint64_t at = host::now_us;
+
+    size_t i = 0;
+    while (i < from_host.size()) {
+        if (from_host[i] != 0x06 || i + EASYTRANSFER_HEADER_SIZE > from_host.size()) {
+            i++; // ACKs from the host, or line noise.
+            continue;
+        }
+
+        uint8_t id = from_host[i + 1];
+        uint8_t length = from_host[i + 2];
+        bool crc = from_host[i + 3] == EASYTRANSFER_MARKER_CRC;
+        size_t check_size = crc ? 2 : 1;
+        const uint8_t* payload = &from_host[i + EASYTRANSFER_HEADER_SIZE];
+
+        if (i + EASYTRANSFER_HEADER_SIZE + length + check_size > from_host.size()) break;
+
+        bool valid;
+        if (crc) {
+            uint16_t calc = easytransfer_crc16(easytransfer_crc16(0xFFFF, id), length);
+            for (uint8_t j = 0; j < length; j++) calc = easytransfer_crc16(calc, payload[j]);
+            valid = calc == (uint16_t) (payload[length] | (payload[length + 1] << 8));
+        } else {
+            uint8_t calc = length;
+            for (uint8_t j = 0; j < length; j++) calc ^= payload[j];
+            valid = calc == payload[length];
+        }
+
+        if (valid) handle_frame(id, payload, length, at);
+        i += EASYTRANSFER_HEADER_SIZE + length + check_size;
+    }
+
+    from_host.clear();
+}
+
+/**
+ * @brief Act on a frame from the host, as the modules on the bus would.
+ *
+ * @param id Target address.
+ * @param payload
+ * @param length
+ * @param at Time the frame finished arriving.
+ */
+void BusSimulator::handle_frame(uint8_t id, const uint8_t* payload, uint8_t length, uint64_t at) {
+    if (id == 0) { // Address for the announcing module.
+        if (!addressing || announcing == nullptr || length != sizeof(AddressPacket)) return;
+
+        AddressPacket packet;
+        memcpy(&packet, payload, sizeof(packet));
+        announcing -> address = packet.address;
+        announcing -> meter.voltage = 230 + 0.1f * packet.address;
+        announcing -> last_sample_us = at;
+
+        uint64_t done = send_ack(reply_time(*announcing, at));
+        announcing = nullptr;
+        announce_next(done); // Passes the control line to the next module.
+        return;
+    }
+
+    if (length != sizeof(OperationPacket)) return;
+
+    OperationPacket packet;
+    memcpy(&packet, payload, sizeof(packet));
+
+    if (id == EASYTRANSFER_BROADCAST_ID) {
+        for (auto& module : modules) {
+            if (module.address == 0) continue;
+            handle_operation(module, packet.operation, at);
+        }
+        return;
+    }
+
+    VirtualModule* target = module(id);
+    if (target != nullptr) handle_operation(*target, packet.operation, at);
+}
+
+/**
+ * @brief Act on an operation addressed to a module.
+ *
+ * @param module
+ * @param operation
+ * @param at
+ */
+void BusSimulator::handle_operation(VirtualModule& module, uint16_t operation, uint64_t at) {
+    module.requests++;
+    if (chance(module.config.drop_rate)) {
+        module.dropped++;
+        return;
+    }
+
+    bool latch_capable = module.config.firmware_version >= LATCH_MIN_FIRMWARE_VERSION;
+
+    switch (operation) {
+        case OPERATION_RELAY_SET:
+        case OPERATION_RELAY_RESET:
+            send_ack(reply_time(module, at));
+            break;
+
+        case OPERATION_READ_METER: {
+            update_meter(module);
+            module.served = module.meter;
+            uint64_t acked = send_ack(reply_time(module, at));
+            send_frame((uint8_t*) &module.served, sizeof(module.served), module.crc, acked, &module);
+            break;
+        }
+
+        case OPERATION_LATCH_READING:
+            if (!latch_capable) break;
+            update_meter(module);
+            module.latched = module.meter;
+            break;
+
+        case OPERATION_READ_LATCHED:
+            if (!latch_capable) break;
+            module.served = module.latched;
+            send_frame((uint8_t*) &module.served, sizeof(module.served), module.crc, reply_time(module, at), &module);
+            break;
+
+        case OPERATION_READ_BATCH:
+            if (module.config.firmware_version < BATCH_MIN_FIRMWARE_VERSION) break;
+            send_batch(module, reply_time(module, at));
+            break;
+
+        case OPERATION_ENABLE_CRC:
+            if (module.config.firmware_version < CRC_MIN_FIRMWARE_VERSION) break;
+            send_ack(reply_time(module, at));
+            module.crc = true; // The ACK itself is not framed.
+            break;
+    }
+}
+
+/**
+ * @brief While addressing, the first unaddressed module in the chain announces itself.
+ *
+ * @param at
+ */
+void BusSimulator::announce_next(uint64_t at) {
+    if (!addressing) return;
+
+    for (auto& module : modules) {
+        if (module.address != 0) continue;
+
+        announcing = &module;
+        send_frame((uint8_t*) &module.announce, sizeof(module.announce), false, reply_time(module, at));
+        return;
+    }
+}
+
+uint64_t BusSimulator::reply_time(VirtualModule& module, uint64_t at) {
+    int64_t latency = module.config.latency_us;
+    if (module.config.jitter_us > 0) {
+        std::uniform_int_distribution<int64_t> jitter(-(int64_t) module.config.jitter_us, module.config.jitter_us);
+        latency += jitter(rng);
+    }
+    return at + std::max<int64_t>(latency, 0);
+}
+
+/**
+ * @brief Queue bytes for the host, one byte time apart.
+ *
+ * @return uint64_t Time the last byte has arrived.
+ */
+uint64_t BusSimulator::schedule(const uint8_t* bytes, size_t length, uint64_t at) {
+    for (size_t i = 0; i < length; i++) {
+        at += byte_us;
+        to_host.emplace_back(at, bytes[i]);
+    }
+
+    std::stable_sort(to_host.begin(), to_host.end(), [](const std::pair<uint64_t, uint8_t>& a, const std::pair<uint64_t, uint8_t>& b) {
+        return a.first < b.first;
+    });
+    return at;
+}
+
+uint64_t BusSimulator::send_ack(uint64_t at) {
+    const uint8_t ack = 0xFE;
+    return schedule(&ack, 1, at);
+}
+
+/**
+ * @brief Frame a payload for the host, optionally corrupting it on the wire.
+ *
+ * @param payload
+ * @param length
+ * @param crc Use a CRC-16 rather than the XOR checksum.
+ * @param at
+ * @param corrupt_for The sending module, whose corruption rate applies.
+ * @return uint64_t Time the frame has arrived.
+ */
+uint64_t BusSimulator::send_frame(const uint8_t* payload, uint8_t length, bool crc, uint64_t at, VirtualModule* corrupt_for) {
+    ps::vector<uint8_t> frame = {0x06, 0, length, (uint8_t) (crc ? EASYTRANSFER_MARKER_CRC : EASYTRANSFER_MARKER_XOR)};
+    frame.insert(frame.end(), payload, payload + length);
+
+    if (crc) {
+        uint16_t calc = easytransfer_crc16(easytransfer_crc16(0xFFFF, 0), length);
+        for (uint8_t i = 0; i < length; i++) calc = easytransfer_crc16(calc, payload[i]);
+        frame.push_back(calc & 0xFF);
+        frame.push_back(calc >> 8);
+    } else {
+        uint8_t calc = length;
+        for (uint8_t i = 0; i < length; i++) calc ^= payload[i];
+        frame.push_back(calc);
+    }
+
+    if (corrupt_for != nullptr && chance(corrupt_for -> config.corrupt_rate)) {
+        corrupt_for -> corrupted++;
+        std::uniform_int_distribution<size_t> bit(0, length * 8 - 1);
+        for (uint8_t flip = 0; flip < 2; flip++) {
+            size_t position = bit(rng);
+            frame[EASYTRANSFER_HEADER_SIZE + position / 8] ^= 1 << (position % 8);
+        }
+    }
+
+    return schedule(frame.data(), frame.size(), at);
+}
+
+/**
+ * @brief Buffer the samples taken since the last batch, then send the oldest as a batch frame.
+ *
+ * @param module
+ * @param at Time the batch is sent.
+ */
+void BusSimulator::send_batch(VirtualModule& module, uint64_t at) {
+    while (module.last_sample_us + module.config.sample_interval_us <= at) {
+        module.last_sample_us += module.config.sample_interval_us;
+        update_meter(module);
+        module.buffered.emplace_back(module.last_sample_us, module.meter);
+        if (module.buffered.size() > BATCH_BUFFER_READINGS) {
+            module.buffered.pop_front();
+            module.overflowed++;
+        }
+    }
+
+    BatchReadingPacket packet;
+    packet.count = std::min<size_t>(module.buffered.size(), BATCH_MAX_READINGS);
+    packet.pending = module.buffered.size() - packet.count;
+
+    for (uint8_t i = 0; i < packet.count; i++) {
+        packet.entries[i].age_ms = (at - module.buffered.front().first) / 1000;
+        packet.entries[i].reading = module.buffered.front().second;
+        module.buffered.pop_front();
+    }
+
+    if (packet.count > 0) module.served = packet.entries[packet.count - 1].reading;
+    send_frame((uint8_t*) &packet, BATCH_HEADER_SIZE + packet.count * sizeof(BatchEntry), module.crc, at, &module);
+}
+
+/**
+ * @brief Step the meter, so that consecutive readings differ.
+ *
+ * @param module
+ */
+void BusSimulator::update_meter(VirtualModule& module) {
+    std::uniform_int_distribution<int> noise(-50, 50);
+    module.meter.current = 1 + module.address * 0.25f + noise(rng) / 1000.0f;
+    module.meter.apparent_power = module.meter.voltage * module.meter.current;
+    module.meter.energy_usage += module.meter.apparent_power * module.meter.power_factor / 3600000.0f;
+    module.meter.status = 1;
+}
+
+bool BusSimulator::chance(double probability) {
+    if (probability <= 0) return false;
+    return std::uniform_real_distribution<double>(0, 1)(rng) < probability;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef BUS_SIMULATOR_H
+#define BUS_SIMULATOR_H
+
+#include <Arduino.h>
+#include <deque>
+#include <random>
+#include <ps_stl.h>
+
+#include "ModuleInterface.h"
+
+/**
+ * @brief Behaviour of a simulated module on the bus.
+ */
+struct VirtualModuleConfig {
+    uint32_t latency_us = 1000; // Time from the end of a request to the start of the reply.
+    uint32_t jitter_us = 0; // Latency varies uniformly by up to this much either way.
+    double drop_rate = 0; // Probability that a request is not heard, so there is no reply.
+    double corrupt_rate = 0; // Probability that a reading frame has two of its payload bits flipped on the wire.
+    uint16_t firmware_version = CRC_MIN_FIRMWARE_VERSION; // Selects latching, CRC frame and batch support.
+    uint32_t sample_interval_us = 1000000 / BATCH_SAMPLE_HZ; // How often a batch capable module buffers a reading.
+};
+
+/**
+ * @brief A simulated meter module.
+ */
+struct VirtualModule {
+    AnnouncePacket announce;
+    VirtualModuleConfig config;
+    uint8_t address = 0; // 0 until addressed.
+    bool crc = false; // Replies with CRC-16 frames.
+
+    ReadingDataPacket meter; // What the meter currently reads.
+    ReadingDataPacket latched; // Snapshot taken by the last latch broadcast.
+    ReadingDataPacket served; // The last reading put on the wire, before any corruption.
+    std::deque<std::pair<uint64_t, ReadingDataPacket>> buffered; // Sample time and reading, for batch reads.
+    uint64_t last_sample_us = 0;
+
+    uint32_t requests = 0;
+    uint32_t dropped = 0;
+    uint32_t corrupted = 0;
+    uint32_t overflowed = 0; // Buffered readings discarded before they were read.
+};
+
+/**
+ * @brief A simulated RS-485 bus of virtual meter modules, which the bus code talks to as if it were the UART. Speaks the EasyTransfer framing
+ * (0x06 / id / length / marker / payload / checksum, and the 0xFE ACK), the daisy chain addressing on the control line, and the module operations.
+ *
+ * Bytes take their wire time at the configured baud rate, and replies arrive after each module's latency, all in the virtual time of the host
+ * shim. Only one simulator may exist at a time, as it installs the shim's wakeup and pin hooks.
+ */
+class BusSimulator : public HardwareSerial {
+    private:
+        uint8_t ctrl_pin;
+        uint32_t byte_us;
+        std::mt19937 rng;
+
+        std::deque<VirtualModule> modules;
+        std::deque<std::pair<uint64_t, uint8_t>> to_host; // Due time and byte, in due time order.
+        ps::vector<uint8_t> from_host;
+
+        bool addressing = false;
+        VirtualModule* announcing = nullptr;
+
+        void handle_frame(uint8_t id, const uint8_t* payload, uint8_t length, uint64_t at);
+        void handle_operation(VirtualModule& module, uint16_t operation, uint64_t at);
+        void announce_next(uint64_t at);
+
+        uint64_t reply_time(VirtualModule& module, uint64_t at);
+        uint64_t schedule(const uint8_t* bytes, size_t length, uint64_t at);
+        uint64_t send_ack(uint64_t at);
+        uint64_t send_frame(const uint8_t* payload, uint8_t length, bool crc, uint64_t at, VirtualModule* corrupt_for = nullptr);
+        void update_meter(VirtualModule& module);
+        void send_batch(VirtualModule& module, uint64_t at);
+        bool chance(double probability);
+
+    public:
+        BusSimulator(uint8_t control_pin, uint32_t baud = 115200, uint32_t seed = 1);
+        ~BusSimulator();
+
+        VirtualModule& addModule(const VirtualModuleConfig& config = VirtualModuleConfig());
+        VirtualModule* module(uint8_t address);
+        size_t moduleCount() { return modules.size(); }
+        uint32_t byteTimeUs() { return byte_us; }
+
+        int available() override;
+        int read() override;
+        size_t write(uint8_t data) override;
+        void flush() override;
+};
+
+#endif
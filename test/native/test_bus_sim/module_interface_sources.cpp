@@ -0,0 +1,6 @@
+/*
+ * The native environment does not build the firmware libraries, so the bus sources under test are compiled here against the host shim.
+ */
+#include "EasyTransfer.cpp"
+#include "LinkHealth.cpp"
+#include "ModuleInterface.cpp"
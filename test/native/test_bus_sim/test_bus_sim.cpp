@@ -0,0 +1,312 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <ps_stl.h>
+
+#include "ModuleInterface.h"
+#include "BusSimulator.h"
+
+#define SIM_CTRL_PIN 9
+#define SIM_DIR_PIN 11
+
+void setUp() {}
+void tearDown() {}
+
+static bool same_reading(const ReadingDataPacket& a, const ReadingDataPacket& b) {
+    return memcmp(&a, &b, sizeof(ReadingDataPacket)) == 0;
+}
+
+void test_addressing() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    for (int i = 0; i < 5; i++) bus.addModule();
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    auto found = interface.begin();
+
+    TEST_ASSERT_EQUAL(5, found.size());
+    for (uint8_t i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(i + 1, found[i].second);
+        TEST_ASSERT_EQUAL_STRING(bus.module(i + 1) -> announce.id, found[i].first.id);
+    }
+}
+
+void test_readings() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    for (int i = 0; i < 3; i++) bus.addModule();
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    interface.begin();
+
+    for (uint8_t address = 1; address <= 3; address++) {
+        auto reading = interface.getReading(address);
+        TEST_ASSERT_TRUE(same_reading(bus.module(address) -> served, reading));
+    }
+
+    TEST_ASSERT_TRUE(interface.latchReadings());
+    for (uint8_t address = 1; address <= 3; address++) {
+        auto reading = interface.getLatchedReading(address);
+        TEST_ASSERT_TRUE(same_reading(bus.module(address) -> latched, reading));
+    }
+}
+
+void test_frame_negotiation() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    VirtualModuleConfig legacy;
+    legacy.firmware_version = 1;
+
+    bus.addModule(legacy);
+    bus.addModule();
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    interface.begin();
+
+    TEST_ASSERT_FALSE(interface.usesCRC(1));
+    TEST_ASSERT_FALSE(interface.supportsLatch(1));
+    TEST_ASSERT_TRUE(interface.usesCRC(2));
+    TEST_ASSERT_TRUE(interface.supportsLatch(2));
+
+    TEST_ASSERT_TRUE(same_reading(bus.module(1) -> served, interface.getReading(1)));
+    TEST_ASSERT_TRUE(same_reading(bus.module(2) -> served, interface.getReading(2)));
+}
+
+void test_crc_rejects_corruption() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    VirtualModuleConfig noisy;
+    noisy.corrupt_rate = 0.2;
+    bus.addModule(noisy);
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    interface.begin();
+
+    uint32_t silent_errors = 0;
+    for (int i = 0; i < 200; i++) {
+        auto reading = interface.getReading(1);
+        if (reading.voltage != -1 && !same_reading(bus.module(1) -> served, reading)) silent_errors++;
+    }
+
+    TEST_ASSERT_TRUE(bus.module(1) -> corrupted > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, silent_errors);
+
+    auto stats = interface.takeLinkStats(1);
+    TEST_ASSERT_TRUE(stats.check_failures > 0);
+    TEST_ASSERT_TRUE(stats.retries > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, interface.takeLinkStats(1).frames_sent); // Reset once taken.
+}
+
+void test_unresponsive_module_quarantined() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    bus.addModule();
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    interface.begin();
+    bus.module(1) -> config.drop_rate = 1;
+
+    for (int i = 0; i < QUARANTINE_FAILURES; i++) TEST_ASSERT_EQUAL_FLOAT(-1, interface.getReading(1).voltage);
+    TEST_ASSERT_TRUE(interface.linkHealth(1).quarantined());
+
+    uint32_t start_us = micros();
+    TEST_ASSERT_EQUAL_FLOAT(-1, interface.getReading(1).voltage);
+    TEST_ASSERT_TRUE(micros() - start_us < 1000); // Skipped without touching the bus.
+}
+
+void test_hot_plug() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    bus.addModule();
+    bus.addModule();
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    TEST_ASSERT_EQUAL(2, interface.begin().size());
+    TEST_ASSERT_EQUAL(0, interface.discover(3).size());
+
+    bus.addModule();
+    auto found = interface.discover(3);
+    TEST_ASSERT_EQUAL(1, found.size());
+    TEST_ASSERT_EQUAL(3, found[0].second);
+    TEST_ASSERT_TRUE(same_reading(bus.module(3) -> served, interface.getReading(3)));
+}
+
+void test_batch_readings() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    VirtualModuleConfig buffering;
+    buffering.firmware_version = BATCH_MIN_FIRMWARE_VERSION;
+    bus.addModule(buffering);
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    interface.begin();
+    TEST_ASSERT_TRUE(interface.supportsBatch(1));
+
+    ps::vector<BatchEntry> batch;
+    TEST_ASSERT_TRUE(interface.getBatch(1, batch)); // Drain what was buffered while addressing.
+
+    delay(1000); // Ten samples at 10Hz, more than fit in one batch.
+    TEST_ASSERT_TRUE(interface.getBatch(1, batch));
+    TEST_ASSERT_EQUAL(10, batch.size());
+    TEST_ASSERT_TRUE(same_reading(bus.module(1) -> served, batch.back().reading));
+
+    for (size_t i = 1; i < batch.size(); i++) {
+        TEST_ASSERT_TRUE(batch[i - 1].age_ms > batch[i].age_ms); // Oldest first.
+        TEST_ASSERT_UINT_WITHIN(5, 100, batch[i - 1].age_ms - batch[i].age_ms);
+    }
+}
+
+void test_batch_module_limit() {
+    BusSimulator bus(SIM_CTRL_PIN);
+    VirtualModuleConfig buffering;
+    buffering.firmware_version = BATCH_MIN_FIRMWARE_VERSION;
+    for (int i = 0; i <= BATCH_MAX_MODULES; i++) bus.addModule(buffering);
+
+    ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+    TEST_ASSERT_EQUAL(BATCH_MAX_MODULES + 1, interface.begin().size());
+    TEST_ASSERT_TRUE(interface.supportsBatch(BATCH_MAX_MODULES));
+    TEST_ASSERT_FALSE(interface.supportsBatch(BATCH_MAX_MODULES + 1)); // Read once per cycle instead.
+    TEST_ASSERT_TRUE(same_reading(bus.module(BATCH_MAX_MODULES + 1) -> served, interface.getReading(BATCH_MAX_MODULES + 1)));
+}
+
+/**
+ * @brief Poll every module once, latching first if they support it, or fetching their buffered batch.
+ *
+ * @param batched Incremented by the readings fetched in batches.
+ * @return uint32_t The number of successful readings.
+ */
+static uint32_t poll_cycle(ModuleInterface& interface, uint8_t modules, uint32_t& batched) {
+    uint32_t readings = 0;
+    bool latched = !interface.supportsBatch(1) && interface.supportsLatch(1) && interface.latchReadings();
+    ps::vector<BatchEntry> batch;
+
+    for (uint8_t address = 1; address <= modules; address++) {
+        if (interface.supportsBatch(address)) {
+            if (interface.getBatch(address, batch)) {
+                readings += batch.size();
+                batched += batch.size();
+            }
+            continue;
+        }
+
+        auto reading = latched ? interface.getLatchedReading(address) : interface.getReading(address);
+        if (reading.voltage != -1) readings++;
+    }
+
+    return readings;
+}
+
+static void benchmark(const char* name, VirtualModuleConfig config) {
+    const uint8_t module_counts[] = {1, 2, 4, 8, 16, 32, 64};
+    const int cycles = 20;
+
+    printf("\n%s\n", name);
+    printf("%8s %12s %12s %14s %10s\n", "modules", "cycle (ms)", "max (ms)", "readings/s", "missed");
+
+    for (auto count : module_counts) {
+        BusSimulator bus(SIM_CTRL_PIN);
+        for (uint8_t i = 0; i < count; i++) bus.addModule(config);
+
+        ModuleInterface interface(&bus, SIM_CTRL_PIN, SIM_DIR_PIN);
+        TEST_ASSERT_EQUAL(count, interface.begin().size());
+
+        uint64_t total_us = 0;
+        uint64_t max_us = 0;
+        uint32_t readings = 0;
+        uint32_t batched = 0;
+
+        for (int cycle = 0; cycle < cycles; cycle++) {
+            uint64_t start_us = host::now_us;
+            readings += poll_cycle(interface, count, batched);
+            uint64_t cycle_us = host::now_us - start_us;
+
+            total_us += cycle_us;
+            if (cycle_us > max_us) max_us = cycle_us;
+            delay(1000); // Sample period.
+        }
+
+        // Batch reads only miss readings that overflowed the module's buffer, other reads miss one per failed read.
+        uint32_t unbatched = 0;
+        uint32_t missed = 0;
+        for (uint8_t address = 1; address <= count; address++) {
+            if (interface.supportsBatch(address)) missed += bus.module(address) -> overflowed;
+            else unbatched++;
+        }
+        missed += unbatched * cycles - (readings - batched);
+
+        printf("%8u %12.2f %12.2f %14.1f %10u\n", count, total_us / 1000.0 / cycles, max_us / 1000.0, readings * 1000000.0 / total_us, missed);
+    }
+}
+
+/**
+ * @brief Bytes queued for the receiver, with anything it writes back discarded.
+ */
+class ByteStream : public Stream {
+    public:
+        std::deque<uint8_t> bytes;
+
+        int available() override { return bytes.size(); }
+        int read() override {
+            if (bytes.empty()) return -1;
+            uint8_t data = bytes.front();
+            bytes.pop_front();
+            return data;
+        }
+        size_t write(uint8_t) override { return 1; }
+};
+
+void test_reset_receive() {
+    uint8_t received[8] = {};
+    uint8_t frame[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    ByteStream stream;
+    EasyTransfer transfer;
+    transfer.begin(details(received), &stream, 0, SIM_DIR_PIN);
+
+    // A reply cut off part way through its payload, as at a timeout.
+    stream.bytes = {0x06, 0, sizeof(frame), EASYTRANSFER_MARKER_XOR, 9, 9, 9};
+    TEST_ASSERT_FALSE(transfer.receiveData());
+    TEST_ASSERT_TRUE(transfer.receiving());
+
+    transfer.resetReceive();
+    TEST_ASSERT_FALSE(transfer.receiving());
+
+    // The next reply is read whole, rather than into the rest of the stale frame.
+    uint8_t checksum = sizeof(frame);
+    stream.bytes = {0x06, 0, sizeof(frame), EASYTRANSFER_MARKER_XOR};
+    for (uint8_t data : frame) {
+        stream.bytes.push_back(data);
+        checksum ^= data;
+    }
+    stream.bytes.push_back(checksum);
+
+    TEST_ASSERT_TRUE(transfer.receiveData());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, received, sizeof(frame));
+}
+
+void test_benchmark() {
+    VirtualModuleConfig legacy;
+    legacy.firmware_version = 1;
+    legacy.latency_us = 1000;
+    legacy.jitter_us = 200;
+    benchmark("Read with ACK, XOR frames (firmware 1), 1ms +/- 0.2ms latency", legacy);
+
+    VirtualModuleConfig latched = legacy;
+    latched.firmware_version = CRC_MIN_FIRMWARE_VERSION;
+    benchmark("Latch broadcast then read, CRC frames (firmware 3), 1ms +/- 0.2ms latency", latched);
+
+    VirtualModuleConfig lossy = latched;
+    lossy.drop_rate = 0.01;
+    lossy.corrupt_rate = 0.01;
+    benchmark("As above, 1% dropped requests and 1% corrupted replies", lossy);
+
+    VirtualModuleConfig batched = latched;
+    batched.firmware_version = BATCH_MIN_FIRMWARE_VERSION;
+    benchmark("Batch read of readings buffered at 10Hz (firmware 4), CRC frames, 1ms +/- 0.2ms latency", batched);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_addressing);
+    RUN_TEST(test_readings);
+    RUN_TEST(test_frame_negotiation);
+    RUN_TEST(test_crc_rejects_corruption);
+    RUN_TEST(test_unresponsive_module_quarantined);
+    RUN_TEST(test_hot_plug);
+    RUN_TEST(test_batch_readings);
+    RUN_TEST(test_batch_module_limit);
+    RUN_TEST(test_reset_receive);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,209 @@
+/**
+ * @brief Host benchmark of the shared brotli dictionary: compresses recorded traffic, one decompressed message per line, through the
+ * firmware's BrotliWriter with and without the dictionary, checks each payload decodes back through codec::decode, and reports the payload
+ * size and the time taken for readings, bus health reports and commands, at the compression level given (0 best, 1 balanced, 2 fast,
+ * 3 stored; best by default). Allocations are counted through the wrapped malloc and free, to report the peak heap of one encoder. The
+ * shared dictionary is prepared once and kept, so it is counted separately. The traffic is then compressed again through the encoder arena
+ * the firmware reserves at boot, to check every message fits it.
+ *
+ * Build from the repository root against the vendored brotli and the native test shim (BROTLI_WRITER_QUALITY and BROTLI_WRITER_LGWIN may
+ * be set with -D):
+ *
+ *     B=.pio/libdeps/esp32-s3-devkitc-1/esp-brotli/src
+ *     mkdir -p /tmp/brotli && (cd /tmp/brotli && gcc -O2 -c -I $OLDPWD/test/native/shim -I $OLDPWD/$B -I $OLDPWD/$B/brotli/include \
+ *         $OLDPWD/$B/brotli/common/*.c $OLDPWD/$B/brotli/enc/*.c $OLDPWD/$B/brotli/dec/*.c)
+ *     g++ -O2 -std=gnu++17 -I test/native/shim -I lib/Serialization -I $B tools/brotli_dictionary/benchmark.cpp \
+ *         lib/Serialization/BrotliWriter.cpp lib/Serialization/MessageCodec.cpp /tmp/brotli/*.o \
+ *         -Wl,--wrap=malloc,--wrap=free -o /tmp/brotli_benchmark
+ *     python3 tools/brotli_dictionary/synthetic_traffic.py --seed 2 > /tmp/traffic.jsonl && /tmp/brotli_benchmark /tmp/traffic.jsonl [level]
+ *
+ * Benchmark on traffic the dictionary was not built from.
+ */
+
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <malloc.h>
+#include <string>
+#include <vector>
+
+#include "BrotliWriter.h"
+#include "MessageCodec.h"
+
+#define BENCHMARK_REPEATS 5
+
+struct Totals {
+    size_t messages = 0;
+    size_t input = 0;
+    size_t payload[2] = {0, 0};
+    double encode_us[2] = {0, 0};
+    double decode_us[2] = {0, 0};
+    size_t peak_heap[2] = {0, 0};
+};
+
+static size_t heap_used = 0;
+static size_t heap_peak = 0;
+
+extern "C" {
+    void* __real_malloc(size_t size);
+    void __real_free(void* ptr);
+
+    void* __wrap_malloc(size_t size) {
+        void* ptr = __real_malloc(size);
+        if (ptr != nullptr) {
+            heap_used += malloc_usable_size(ptr);
+            heap_peak = std::max(heap_peak, heap_used);
+        }
+        return ptr;
+    }
+
+    void __wrap_free(void* ptr) {
+        if (ptr != nullptr) heap_used -= malloc_usable_size(ptr);
+        __real_free(ptr);
+    }
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Compress and decode one message with the given dictionary, adding the payload size and mean times to the totals.
+ *
+ * @return true - If the payload decoded back to the message.
+ */
+static bool measure(const std::string& message, MessageCompression level, uint8_t dictionary, int column, Totals& totals) {
+    char* payload = nullptr;
+    size_t length = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_REPEATS; i++) {
+        free(payload);
+        size_t heap_before = heap_peak = heap_used;
+        {
+            BrotliWriter writer(BROTLI_MODE_TEXT, level, dictionary);
+            writer.write((const uint8_t*) message.data(), message.size());
+            if (!writer.finish()) return false;
+            payload = writer.release(length);
+        }
+        totals.peak_heap[column] = std::max(totals.peak_heap[column], heap_peak - heap_before);
+    }
+    totals.encode_us[column] += elapsed_us(start) / BENCHMARK_REPEATS;
+
+    ps::string encoded(payload, length);
+    free(payload);
+
+    // Decoding overwrites the payload, so each pass decodes a fresh copy of it.
+    ps::string scratch;
+    char* decoded = nullptr;
+    size_t decoded_length = 0;
+    double decode_us = 0;
+    for (int i = 0; i < BENCHMARK_REPEATS; i++) {
+        free(decoded);
+        scratch = encoded;
+        start = std::chrono::steady_clock::now();
+        decoded = codec::decode(&scratch[0], scratch.size(), decoded_length);
+        decode_us += elapsed_us(start);
+    }
+    totals.decode_us[column] += decode_us / BENCHMARK_REPEATS;
+    totals.payload[column] += length;
+
+    bool same = decoded != nullptr && message.compare(0, std::string::npos, decoded, decoded_length) == 0;
+    free(decoded);
+    return same;
+}
+
+static void report(const char* name, const Totals& totals) {
+    if (totals.messages == 0) return;
+
+    double n = totals.messages;
+    printf("%-12s %6zu %9.0f", name, totals.messages, totals.input / n);
+    for (int column = 0; column < 2; column++) {
+        printf(" | %9.0f %6.2f %9.1f %9.1f", totals.payload[column] / n, (double) totals.input / totals.payload[column],
+               totals.encode_us[column] / n, totals.decode_us[column] / n);
+    }
+    printf(" | %+6.1f%%\n", 100.0 * ((double) totals.payload[1] - totals.payload[0]) / totals.payload[0]);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s traffic.jsonl [level]\n", argv[0]);
+        return 2;
+    }
+
+    MessageCompression level = (MessageCompression) ((argc == 3) ? atoi(argv[2]) & MESSAGE_HEADER_LEVEL_MASK : COMPRESSION_BEST);
+
+    size_t heap_before = heap_used;
+    codec::preparedDictionary(MESSAGE_DICTIONARY_VERSION);
+    size_t dictionary_heap = heap_used - heap_before;
+
+    std::ifstream traffic(argv[1]);
+    if (!traffic) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 2;
+    }
+
+    const char* names[] = {"readings", "bus health", "commands", "all"};
+    Totals totals[4];
+    std::string message;
+    std::vector<std::string> messages;
+
+    while (std::getline(traffic, message)) {
+        if (message.empty()) continue;
+
+        int kind = (message.find("\"readings\"") != std::string::npos) ? 0 : (message.find("\"bus_health\"") != std::string::npos) ? 1 : 2;
+        for (int column = 0; column < 2; column++) {
+            uint8_t dictionary = (column == 0) ? MESSAGE_DICTIONARY_NONE : MESSAGE_DICTIONARY_VERSION;
+            if (!measure(message, level, dictionary, column, totals[kind])) {
+                fprintf(stderr, "round trip failed with dictionary v%u: %.60s...\n", dictionary, message.c_str());
+                return 1;
+            }
+        }
+
+        totals[kind].messages++;
+        totals[kind].input += message.size();
+        messages.push_back(message);
+    }
+
+    for (int kind = 0; kind < 3; kind++) {
+        totals[3].messages += totals[kind].messages;
+        totals[3].input += totals[kind].input;
+        for (int column = 0; column < 2; column++) {
+            totals[3].payload[column] += totals[kind].payload[column];
+            totals[3].encode_us[column] += totals[kind].encode_us[column];
+            totals[3].decode_us[column] += totals[kind].decode_us[column];
+            totals[3].peak_heap[column] = std::max(totals[3].peak_heap[column], totals[kind].peak_heap[column]);
+        }
+    }
+
+    const uint8_t* data;
+    size_t size;
+    codec::dictionary(MESSAGE_DICTIONARY_VERSION, data, size);
+    const int qualities[] = {BROTLI_WRITER_QUALITY, BROTLI_WRITER_QUALITY_BALANCED, BROTLI_WRITER_QUALITY_FAST, -1};
+    printf("Level %u (quality %d), window 2^%d, dictionary v%d (%zu bytes). Means per message, payload is base64 with the codec header.\n\n",
+           level, qualities[level], BROTLI_WRITER_LGWIN, MESSAGE_DICTIONARY_VERSION, size);
+    printf("%-12s %6s %9s | %-37s | %-37s | %7s\n", "", "", "", "without dictionary", "with dictionary", "");
+    printf("%-12s %6s %9s", "", "count", "input");
+    for (int column = 0; column < 2; column++) printf(" | %9s %6s %9s %9s", "payload", "ratio", "enc (us)", "dec (us)");
+    printf(" | %7s\n", "size");
+
+    for (int kind = 0; kind < 4; kind++) report(names[kind], totals[kind]);
+    printf("\nPeak heap of one encoder: %zu bytes without dictionary, %zu with, plus %zu for the prepared dictionary.\n",
+           totals[3].peak_heap[0], totals[3].peak_heap[1], dictionary_heap);
+
+    if (!BrotliWriter::begin()) {
+        fprintf(stderr, "cannot reserve the encoder arena\n");
+        return 1;
+    }
+
+    Totals arena_totals;
+    for (auto& arena_message : messages) {
+        if (!measure(arena_message, level, MESSAGE_DICTIONARY_VERSION, 1, arena_totals)) {
+            fprintf(stderr, "round trip failed in the %u byte encoder arena: %.60s...\n", BROTLI_WRITER_ARENA_SIZE, arena_message.c_str());
+            return 1;
+        }
+    }
+    printf("Every message compressed in the %u byte encoder arena.\n", BROTLI_WRITER_ARENA_SIZE);
+    return 0;
+}
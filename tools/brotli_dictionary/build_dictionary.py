@@ -0,0 +1,131 @@
+"""
+Build the raw shared brotli dictionary from recorded MQTT traffic, and write it as the firmware header.
+
+The input is decompressed messages, one per line. The dictionary is assembled from fixed length pieces of the messages, as in zstd's COVER
+algorithm: each piece is scored by how many messages contain each of its 8 byte substrings, and the best piece is picked repeatedly, with
+the substrings it covers no longer scoring, until the dictionary is full. So keys, message structure and common values are each included
+once. The best pieces are placed last, where brotli reaches them with the shortest distances.
+
+UUIDs and long numbers (measurements, timestamps) are masked before counting. They recur between the messages of one unit, but differ
+between units, so they would only waste space in a dictionary shared by every unit.
+
+    python build_dictionary.py traffic.jsonl --version 2 --output ../../lib/Serialization/brotli_dictionary.h --binary dictionary_v2.bin
+
+The server must decompress with the same dictionary, so give every new dictionary a new version, and keep the old versions there.
+"""
+
+import argparse
+import collections
+import heapq
+import re
+
+UUID = re.compile(rb"[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}")
+NUMBER = re.compile(rb"-?[0-9][0-9.eE+-]{2,}")
+MASK = b"\x00"
+KMER = 8 # Length of the substrings whose recurrence is counted.
+
+
+def load_messages(paths):
+    messages = []
+    for path in paths:
+        with open(path, "rb") as file:
+            messages.extend(line.strip() for line in file if line.strip())
+    return messages
+
+
+def kmer_frequencies(messages):
+    frequencies = collections.Counter()
+    for message in messages:
+        frequencies.update({message[i:i + KMER] for i in range(len(message) - KMER + 1)})
+    return {kmer: count for kmer, count in frequencies.items() if count > 1 and MASK not in kmer}
+
+
+def segment_score(segment, frequencies):
+    return sum(frequencies.get(segment[i:i + KMER], 0) for i in range(len(segment) - KMER + 1)) if segment else 0
+
+
+def build(messages, size, segment_length, sample_stride):
+    messages = [NUMBER.sub(MASK, UUID.sub(MASK, message)) for message in messages]
+    frequencies = kmer_frequencies(messages)
+
+    # Every distinct segment of the sampled messages is a candidate, and so is each shorter run between masked values.
+    candidates = set()
+    for message in messages[::sample_stride]:
+        for run in message.split(MASK):
+            if len(run) < KMER:
+                continue
+            for start in range(0, max(len(run) - segment_length, 0) + 1):
+                candidates.add(run[start:start + segment_length])
+
+    # Lazy greedy: scores only fall as k-mers are covered, so a popped segment whose rescore still beats the next one is the best.
+    heap = [(-segment_score(segment, frequencies), segment) for segment in candidates]
+    heapq.heapify(heap)
+    picked = []
+    total = 0
+    while heap and total + KMER <= size:
+        _, segment = heapq.heappop(heap)
+        score = segment_score(segment, frequencies)
+        if score <= 0:
+            continue
+        if heap and score < -heap[0][0]:
+            heapq.heappush(heap, (-score, segment))
+            continue
+
+        if total + len(segment) > size:
+            continue
+        picked.append(segment)
+        total += len(segment)
+        for i in range(len(segment) - KMER + 1):
+            frequencies.pop(segment[i:i + KMER], None)  # Covered.
+
+    return b"".join(reversed(picked))  # Best last.
+
+
+def write_header(path, dictionary, version, source):
+    lines = [
+        "#pragma once",
+        "",
+        "#ifndef BROTLI_DICTIONARY_DATA_H",
+        "#define BROTLI_DICTIONARY_DATA_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "// Generated by tools/brotli_dictionary/build_dictionary.py from %s. Do not edit." % source,
+        "#define BROTLI_DICTIONARY_LATEST %d" % version,
+        "",
+        "const uint8_t brotli_dictionary_v%d[] PROGMEM = {" % version,
+    ]
+    for offset in range(0, len(dictionary), 16):
+        lines.append("\t" + " ".join("0x%02x," % byte for byte in dictionary[offset:offset + 16]))
+    lines += ["};", "", "#endif", ""]
+    with open(path, "w", newline="\n") as file:
+        file.write("\n".join(lines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("traffic", nargs="+", help="Files of decompressed messages, one per line.")
+    parser.add_argument("--version", type=int, required=True, help="Dictionary version, 1 to 31, carried in each message's codec header.")
+    parser.add_argument("--size", type=int, default=2048, help="Dictionary size in bytes, held in flash.")
+    parser.add_argument("--segment", type=int, default=32, help="Length of the pieces the dictionary is assembled from.")
+    parser.add_argument("--stride", type=int, default=1, help="Take candidate pieces from every nth message, to speed up large inputs.")
+    parser.add_argument("--output", help="Header to write.")
+    parser.add_argument("--binary", help="Raw dictionary to write, for the server.")
+    args = parser.parse_args()
+
+    if not 1 <= args.version <= 31:
+        parser.error("version must be 1 to 31, 0 means no dictionary")
+
+    messages = load_messages(args.traffic)
+    dictionary = build(messages, args.size, args.segment, args.stride)
+    print("%d messages, %d byte dictionary" % (len(messages), len(dictionary)))
+
+    if args.output:
+        write_header(args.output, dictionary, args.version, "%d messages" % len(messages))
+    if args.binary:
+        with open(args.binary, "wb") as file:
+            file.write(dictionary)
+
+
+if __name__ == "__main__":
+    main()
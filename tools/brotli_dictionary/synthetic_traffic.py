@@ -0,0 +1,104 @@
+"""
+Generate MQTT traffic in the shape the unit sends and receives, one decompressed message per line, for building and benchmarking the
+shared brotli dictionary when no recorded traffic is at hand. Field names follow include/JSONFields.h.
+
+    python synthetic_traffic.py --units 4 --periods 30 --modules 40 > traffic.jsonl
+"""
+
+import argparse
+import json
+import random
+import struct
+import uuid
+
+
+def f64(value):
+    """Digits as ArduinoJson prints a double: at most 10 significant figures and 9 decimal places."""
+    return float("%.10g" % round(value, 9))
+
+
+def f32(value):
+    """Features are rounded to float precision before serialization, then printed as doubles."""
+    return f64(struct.unpack("f", struct.pack("f", value))[0])
+
+
+def module_reading(rng, module):
+    power = module["power"] * (1 + 0.05 * rng.gauss(0, 1))
+    usage = power * 0.9 / 60000
+    module["today"] += usage
+    module["total"] += usage
+    reading = {
+        "module_id": module["id"],
+        "sample_count": 60,
+        "kwh_usage": f64(usage),
+        "kwh_today": f64(module["today"]),
+        "kwh_total": f64(module["total"]),
+        "mean_voltage": f32(230 + rng.gauss(0, 1)),
+        "mean_frequency": f32(50 + 0.01 * rng.gauss(0, 1)),
+        "apparent_power": [f32(power + rng.gauss(0, 1)), f32(power * 1.1 + rng.gauss(0, 1)), f32(5 + rng.gauss(0, 1)), f32(3 + rng.gauss(0, 1))],
+        "power_factor": [f32(0.9 + 0.01 * rng.gauss(0, 1)), f32(0.95 + 0.01 * rng.gauss(0, 1)), f32(0.01 + 0.001 * rng.gauss(0, 1)), f32(3 + rng.gauss(0, 1))],
+        "state_changes": [],
+    }
+    if rng.random() < 0.05:
+        reading["state_changes"].append({"state": rng.random() < 0.5, "timestamp": 1760000000 + rng.randrange(60)})
+    return reading
+
+
+def bus_health(rng, modules, start, end):
+    entries = []
+    for index, module_id in enumerate(modules):
+        sent = 900 + rng.randrange(20)
+        entries.append({
+            "module_id": module_id, "bus": 1 + index % 2, "addr": 1 + index // 2, "srtt": 1800 + rng.randrange(400),
+            "cnt": [sent, sent, rng.randrange(2), 0, rng.randrange(2), rng.randrange(2)],
+            "lat": [0, 0, 0, 0, 0, sent - 3, 3, 0, 0, 0, 0, 0],
+        })
+    return {"type": 1, "data": {"period_start": start, "period_end": end, "bus_health": entries}}
+
+
+def command(rng, modules):
+    kind = rng.randrange(4)
+    if kind == 0:
+        rules = [{"priority": rng.randrange(10), "expression": "(power_factor < 0.8) && (switch_status == true)", "command": "set_relay(false)"}]
+        return {"type": 0, "data": {"unit_rules": {"action": 0, "rules": []},
+                                    "module_rules": [{"module_id": rng.choice(modules), "action": 1, "rules": rules}]}}
+    if kind == 1:
+        items = [{"module_id": rng.choice(modules), "state": False, "timestamp": 1760003600, "period": 86400, "count": -1}]
+        return {"type": 1, "data": {"action": 0, "schedule": items}}
+    if kind == 2:
+        return {"type": 2, "data": {"sample_period": 1, "serialization_period": 60, "mode": 0, "encoding": 0}}
+    seasons = [{"name": "high", "start_date": {"month": 5, "day": 1}, "end_date": {"month": 7, "day": 31}},
+               {"name": "low", "start_date": {"month": 8, "day": 1}, "end_date": {"month": 4, "day": 30}}]
+    tou = [{"season": season["name"], "days": [1, 2, 3, 4, 5], "times": [{"start": 6, "end": 9}, {"start": 17, "end": 19}],
+            "price": round(1 + rng.random(), 4)} for season in seasons]
+    base = [{"season": season["name"], "price": round(0.5 + rng.random(), 4)} for season in seasons]
+    holidays = [{"day": 1, "month": 0, "year": 2026, "treat_as": 0}, {"day": 27, "month": 3, "year": 2026, "treat_as": 0}]
+    return {"type": 3, "data": {"seasons": seasons, "public_holidays": holidays, "tou_prices": tou, "base_prices": base}}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--units", type=int, default=4)
+    parser.add_argument("--periods", type=int, default=30, help="Reading periods per unit.")
+    parser.add_argument("--modules", type=int, default=40, help="Modules per unit.")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    for unit in range(args.units):
+        modules = [{"id": str(uuid.UUID(int=rng.getrandbits(128), version=4)), "power": rng.uniform(20, 3000),
+                    "today": rng.uniform(0, 20), "total": rng.uniform(100, 50000)} for _ in range(args.modules)]
+        module_ids = [module["id"] for module in modules]
+        start = 1760000000
+        for period in range(args.periods):
+            readings = [module_reading(rng, module) for module in modules]
+            print(json.dumps({"type": 0, "data": {"period_start": start, "period_end": start + 60, "readings": readings}}, separators=(",", ":")))
+            if period % 15 == 14:
+                print(json.dumps(bus_health(rng, module_ids, start - 840, start + 60), separators=(",", ":")))
+            if rng.random() < 0.2:
+                print(json.dumps(command(rng, module_ids), separators=(",", ":")))
+            start += 60
+
+
+if __name__ == "__main__":
+    main()